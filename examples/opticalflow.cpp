@@ -33,7 +33,6 @@ int main(int argc, char **argv)
     addImage(prefix, 4, suffix, stream);
     addImage(prefix, 5, suffix, stream);
     
-    int streamIndex = 0;
     int streamCount = stream.size();
     
     
@@ -42,29 +41,20 @@ int main(int argc, char **argv)
     }
     
     
-    Mat prev, prev_c;
-    Mat im, im_c;
-
-    prev = stream[streamIndex++];
-    resize(prev, prev_c, prev.w / div, prev.h / div);
-
-    im = stream[streamIndex++];
-    resize(im, im_c, im.w / div, im.h / div);
-
+    // the tracker keeps the previous frame, each frame is converted once
     LucasKanade lk;
+    Mat small;
     Mat v;
 
-    while (streamIndex < streamCount) {
-        lk.opticalflow(im_c, prev_c, smooth, stride, v);
-        drawFlow(im, v, smooth * div);
-        
-        saveImage("flow_" + to_str8(streamIndex), im);
+    for (int streamIndex = 0; streamIndex < streamCount; ++streamIndex) {
+        Mat& im = stream[streamIndex];
+        resize(im, small, im.w / div, im.h / div);
 
-        std::swap(prev, im);
-        std::swap(prev_c, im_c);
+        if (!lk.push(small, smooth, stride, v))
+            continue;
 
-        im = stream[streamIndex++];
-        resize(im, im_c, im.w / div, im.h / div);
+        drawFlow(im, v, smooth * div);
+        saveImage("flow_" + to_str8(streamIndex), im);
     }
     return 0;
 }
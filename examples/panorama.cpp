@@ -63,24 +63,35 @@ static Mat combine_images(Mat const &a, Mat const &b, Matd const &H) {
     c.copy(a, -dx, -dy);
 
     // Paste in image b as well.
-    // You should loop over some points in the new image (which? all?)
-    // and see if their projection from a coordinates to b coordinates falls
-    // inside of the bounds of image b. If so, use bilinear interpolation to
-    // estimate the value of b at that projection, then fill in image c.
-    for (int k = 0; k < b.c; ++k)
-        for (int y = topleft.y(); y < int(botright.y()); ++y)
-            for (int x = topleft.x(); x < int(botright.x()); ++x) {
-                Vector2F p = projectPoint(H, Vector2F(x, y));
-                if (p.x() >= 0.0f && p.x() < b.w && p.y() >= 0.0f && p.y() < b.h) {
-
-                    // this is because of the cylinder black borders
-                    if (equivalent(getMin(b, p.x(), p.y(), k, 3), 0.0f))
-                        continue;
-
-                    float value = interpolateBL(b, p.x(), p.y(), k);
-                    c.set(x - dx, y - dy, k, value);
-                }
+    // The b coordinates of the covered region are mapped once, black cylinder border
+    // points are dropped from the map and the remaining ones are sampled for all channels.
+    int x0 = int(topleft.x());
+    int y0 = int(topleft.y());
+    int rw = int(botright.x()) - x0;
+    int rh = int(botright.y()) - y0;
+    if (rw <= 0 || rh <= 0)
+        return c;
+
+    Mat mapx, mapy;
+    perspectiveMap(H, rw, rh, mapx, mapy, x0, y0);
+    for (int i = 0; i != mapx.size(); ++i) {
+        float px = mapx.data[i];
+        float py = mapy.data[i];
+        if (!(px >= 0.0f && px < b.w && py >= 0.0f && py < b.h))
+            continue;
+
+        // this is because of the cylinder black borders
+        for (int k = 0; k < b.c; ++k)
+            if (equivalent(getMin(b, px, py, k, 3), 0.0f)) {
+                mapx.data[i] = -1.0f;
+                break;
             }
+    }
+
+    Mat region(rw, rh, c.c);
+    region.copy(c, x0 - dx, y0 - dy, rw, rh, 0, 0);
+    remap(b, region, mapx, mapy, Bilinear);
+    c.copy(region, x0 - dx, y0 - dy);
 
     return c;
 }
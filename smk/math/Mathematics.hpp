@@ -18,6 +18,8 @@ namespace smk
 
     template<typename T> constexpr inline T round(T const value) { return ( (value >= T(0.0)) ? floor(value + T(0.5)) : ceil(value - T(0.5)) ); }
 
+    template<typename T> constexpr inline int floorToInt(T const value) { int i = int(value); return (T(i) > value) ? i - 1 : i; } // no libm call, for values in int range
+
     template<typename T> constexpr inline T sign(T const value) { return ((value < T(0.0)) ? T(-1.0) : ((value == T(0.0)) ? T(0.0) : T(1.0)) ); }
     template<typename T> constexpr inline T signedSquare(T const value) { return ((value < T(0.0)) ? -value * value : value * value); }
     template<typename T> constexpr inline T square(T const value) { return value * value; }
@@ -31,7 +33,7 @@ namespace smk
 
 
     template<typename T> constexpr inline T sinc(T const& value) {
-        if (absolute(value) < epsilon)
+        if (absolute(value) < epsilon<T>())
             return T(1.0) + value * value * ( T(-1.0) / T(6.0) + value * value * T(1.0) / T(120.0));
         else
             return sin(value) / value;
@@ -86,6 +88,21 @@ namespace smk
         return degrees;
     }
 
+    // atan2 with a minimax polynomial for atan on [0, 1], max error around 1e-5 radians
+    template<typename T> constexpr inline T fastAtan2(T const y, T const x) {
+        const T ax = absolute(x);
+        const T ay = absolute(y);
+        const T high = maximum(ax, ay);
+        if (high == T(0.0)) return T(0.0);
+
+        const T a = minimum(ax, ay) / high;
+        const T s = a * a;
+        T r = a * (((((T(-0.01172120) * s + T(0.05265332)) * s - T(0.11643287)) * s + T(0.19354346)) * s - T(0.33262347)) * s + T(0.99997726));
+        if (ay > ax) r = piDiv2<T>() - r;
+        if (x < T(0.0)) r = piAngle<T>() - r;
+        return (y < T(0.0)) ? -r : r;
+    }
+
 
     //
     // random number between 0.0 and 1.0
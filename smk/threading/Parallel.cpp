@@ -0,0 +1,214 @@
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace smk {
+
+    static int hardwareThreads() {
+        unsigned int threads = std::thread::hardware_concurrency();
+        return threads == 0 ? 1 : int(threads);
+    }
+
+    static std::atomic<int> s_threads(hardwareThreads());
+    static thread_local bool s_inside_parallel = false;
+    static thread_local bool s_pool_worker = false;
+
+    // marks the thread as running a parallel range, nested calls run inline, cleared on throw
+    class InsideParallel {
+    public:
+        InsideParallel() : m_previous(s_inside_parallel) { s_inside_parallel = true; }
+        ~InsideParallel() { s_inside_parallel = m_previous; }
+
+        InsideParallel(const InsideParallel&) = delete;
+        InsideParallel& operator=(const InsideParallel&) = delete;
+    private:
+        bool m_previous;
+    };
+
+    //
+    // Persistent workers shared by parallelFor and parallelSubmit.
+    // Created on first use and resized to parallelThreads() when the next job arrives,
+    // so per frame calls never pay thread creation.
+    //
+    class ThreadPool {
+    public:
+        static ThreadPool& instance() {
+            // never destroyed, workers may still be referenced by static destructors elsewhere
+            static ThreadPool* pool = new ThreadPool();
+            return *pool;
+        }
+
+        void submit(std::function<void()> task) {
+            // a worker can't join itself, resizing waits for a call from outside the pool
+            int const threads = parallelThreads();
+            if (m_size.load() != threads && !s_pool_worker)
+                resize(threads);
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_tasks.push_back(std::move(task));
+            }
+            m_condition.notify_one();
+        }
+
+    private:
+        ThreadPool() = default;
+
+        void resize(int threads) {
+            std::unique_lock<std::mutex> resize_lock(m_resize_mutex);
+            if (m_size.load() == threads)
+                return;
+
+            // the extra workers leave after their current task, queued tasks stay for the others
+            std::vector<std::thread> leaving;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_target = threads;
+                while (int(m_threads.size()) > threads) {
+                    leaving.push_back(std::move(m_threads.back()));
+                    m_threads.pop_back();
+                }
+            }
+            m_condition.notify_all();
+
+            for (std::thread& thread : leaving)
+                thread.join();
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (int(m_threads.size()) < threads) {
+                int const index = int(m_threads.size());
+                m_threads.emplace_back([this, index] { run(index); });
+            }
+            m_size.store(threads);
+        }
+
+        void run(int index) {
+            s_pool_worker = true;
+            for (;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_condition.wait(lock, [this, index] { return index >= m_target || !m_tasks.empty(); });
+                    if (index >= m_target)
+                        return;
+
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::mutex m_resize_mutex;
+        std::atomic<int> m_size{0};
+
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        std::deque<std::function<void()>> m_tasks;
+        std::vector<std::thread> m_threads;
+        int m_target = 0;
+    };
+
+    //
+    // One parallelForChunks call. Workers and the calling thread claim chunks from a counter, the caller
+    // keeps claiming while it waits, so a busy pool never blocks a call and a worker that starts late finds nothing left.
+    // The state is shared with the queued tasks, the function is only touched for claimed chunks, those end before the call returns.
+    //
+    struct ChunkBatch {
+        std::function<void(int, int, int)> const* function = nullptr;
+        int begin = 0;
+        int count = 0;
+        int chunks = 0;
+
+        std::atomic<int> next{0};
+        std::mutex mutex;
+        std::condition_variable condition;
+        int finished = 0;
+        std::exception_ptr error;
+
+        int rangeBegin(int chunk) const { return begin + int((long long)(count) * chunk / chunks); }
+
+        void work() {
+            for (int chunk = next++; chunk < chunks; chunk = next++) {
+                std::exception_ptr chunk_error;
+                try {
+                    InsideParallel inside;
+                    (*function)(chunk, rangeBegin(chunk), rangeBegin(chunk + 1));
+                } catch (...) {
+                    chunk_error = std::current_exception();
+                }
+
+                std::unique_lock<std::mutex> lock(mutex);
+                if (chunk_error && !error)
+                    error = chunk_error;
+                if (++finished == chunks)
+                    condition.notify_all();
+            }
+        }
+    };
+
+    int parallelThreads() {
+        return s_threads.load();
+    }
+
+    void setParallelThreads(int threads) {
+        s_threads.store(threads < 1 ? 1 : threads);
+    }
+
+    int parallelChunks(int begin, int end, int grain) {
+        int const count = end - begin;
+        if (count <= 0)
+            return 0;
+
+        if (s_inside_parallel)
+            return 1;
+
+        grain = std::max(grain, 1);
+        int const chunks = std::min(parallelThreads(), (count + grain - 1) / grain);
+        return std::max(chunks, 1);
+    }
+
+    void parallelForChunks(int begin, int end, std::function<void(int, int, int)> const& function, int grain) {
+        int const chunks = parallelChunks(begin, end, grain);
+        if (chunks == 0)
+            return;
+
+        if (chunks == 1) {
+            function(0, begin, end);
+            return;
+        }
+
+        auto batch = std::make_shared<ChunkBatch>();
+        batch->function = &function;
+        batch->begin = begin;
+        batch->count = end - begin;
+        batch->chunks = chunks;
+
+        ThreadPool& pool = ThreadPool::instance();
+        for (int chunk = 1; chunk < chunks; ++chunk)
+            pool.submit([batch] { batch->work(); });
+
+        batch->work();
+
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->condition.wait(lock, [&] { return batch->finished == chunks; });
+        if (batch->error)
+            std::rethrow_exception(batch->error);
+    }
+
+    void parallelFor(int begin, int end, std::function<void(int, int)> const& function, int grain) {
+        parallelForChunks(begin, end, [&](int, int b, int e) { function(b, e); }, grain);
+    }
+
+    void parallelSubmit(std::function<void()> task) {
+        ThreadPool::instance().submit(std::move(task));
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <functional>
+
+namespace smk {
+
+    // Number of threads used by parallelFor, defaults to the hardware concurrency.
+    int parallelThreads();
+
+    // Sets the number of threads used by parallelFor, 1 runs everything on the calling thread.
+    void setParallelThreads(int threads);
+
+    // Number of chunks parallelForChunks splits [begin, end) into.
+    // ranges smaller than grain are not split.
+    int parallelChunks(int begin, int end, int grain = 1);
+
+    // Splits [begin, end) in parallelChunks contiguous ranges and runs function(chunk, range_begin, range_end)
+    // for each one on a persistent pool of threads. The calling thread takes ranges too and waits for the others.
+    // An exception thrown by function is rethrown on the calling thread once every range is done.
+    // chunk goes from 0 to parallelChunks - 1, use it to index per thread partial results.
+    // Calls made from inside a parallel function run inline on the calling thread.
+    void parallelForChunks(int begin, int end, std::function<void(int, int, int)> const& function, int grain = 1);
+
+    // Same as parallelForChunks, function(range_begin, range_end).
+    void parallelFor(int begin, int end, std::function<void(int, int)> const& function, int grain = 1);
+
+    // Runs task on one of the parallelFor threads and returns right away, tasks start in submission order.
+    // The threads are created once and kept, parallelThreads() of them.
+    void parallelSubmit(std::function<void()> task);
+}
@@ -0,0 +1,218 @@
+#include "Components.hpp"
+#include "UnionFind.hpp"
+#include "../math/Mathematics.hpp"
+#include "../threading/Parallel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace smk
+{
+    // rows per band when labelling in parallel
+    static const int components_band_rows = 64;
+
+    // joins pixel i of row y with its foreground neighbours on the row above
+    static inline void componentUnionAbove(int* parent, int w, int x, int i, bool eight) {
+        const int above = i - w;
+        if (parent[above] >= 0)
+            unionFindJoin(parent, i, above);
+
+        if (eight) {
+            if (x > 0 && parent[above - 1] >= 0)
+                unionFindJoin(parent, i, above - 1);
+            if (x < w - 1 && parent[above + 1] >= 0)
+                unionFindJoin(parent, i, above + 1);
+        }
+    }
+
+    static int connectedComponents(Mat const& mask, Mati& labels, ComponentsStats* stats, int connectivity) {
+        assert(mask.c == 1);
+        assert(connectivity == 4 || connectivity == 8);
+
+        const int w = mask.w;
+        const int h = mask.h;
+        const bool eight = connectivity == 8;
+
+        labels.reshape(w, h, 1);
+        if (stats)
+            stats->clear();
+        if (w == 0 || h == 0)
+            return 0;
+
+        // labels holds the union find parents until the final pass, -1 for background
+        int* parent = labels.data;
+
+        const int bands = parallelChunks(0, h, components_band_rows);
+        std::vector<int> seams(static_cast<size_t>(bands), 0);
+
+        parallelForChunks(0, h, [&](int chunk, int begin, int end) {
+            seams[size_t(chunk)] = begin;
+
+            for (int y = begin; y != end; ++y) {
+                const float* m = mask.data + y * w;
+                int* p = parent + y * w;
+
+                for (int x = 0; x != w; ++x)
+                    p[x] = (m[x] > 0.0f) ? y * w + x : -1;
+
+                for (int x = 0; x != w; ++x) {
+                    if (p[x] < 0)
+                        continue;
+
+                    const int i = y * w + x;
+                    if (x > 0 && p[x - 1] >= 0)
+                        unionFindJoin(parent, i, i - 1);
+
+                    if (y != begin)
+                        componentUnionAbove(parent, w, x, i, eight);
+                }
+            }
+        }, components_band_rows);
+
+        // merge the first row of every band with the last row of the band above
+        for (int b = 1; b < bands; ++b) {
+            const int y = seams[size_t(b)];
+            for (int x = 0; x != w; ++x) {
+                const int i = y * w + x;
+                if (parent[i] >= 0)
+                    componentUnionAbove(parent, w, x, i, eight);
+            }
+        }
+
+        // number the roots in raster order, the root is the first pixel of its component.
+        // A root index is replaced by -(label + 2), every other pixel points to an index before it,
+        // so a raster scan always finds the label of its parent already resolved.
+        // first_label[b] is the first label numbered in band b, the labels a band starts are contiguous.
+        int count = 0;
+        std::vector<int> first_label(static_cast<size_t>(bands), 0);
+        for (int b = 0; b != bands; ++b) {
+            first_label[size_t(b)] = count + 1;
+
+            const int end = (b + 1 < bands) ? seams[size_t(b + 1)] * w : w * h;
+            for (int i = seams[size_t(b)] * w; i != end; ++i) {
+                const int p = parent[i];
+                if (p < 0)
+                    continue;
+
+                if (p == i) {
+                    parent[i] = -(count + 2);
+                    count++;
+                } else {
+                    parent[i] = parent[p];
+                }
+            }
+        }
+
+        // every pixel now holds -(label + 2), or -1 for background
+        struct Partial {
+            int area = 0;
+            int x0 = std::numeric_limits<int>::max();
+            int y0 = std::numeric_limits<int>::max();
+            int x1 = -1;
+            int y1 = -1;
+            double sx = 0.0;
+            double sy = 0.0;
+        };
+
+        // The partial stats of a band only cover the labels it touches: the ones it started, plus the ones
+        // started above it. A path from an earlier band crosses the first row of this one, so those
+        // carried labels all show on that row, at most w of them.
+        // The partial holds the carried labels (sorted) followed by the started ones.
+        struct Band {
+            std::vector<int> carried;
+            std::vector<Partial> partial;
+        };
+        std::vector<Band> partials(stats ? static_cast<size_t>(bands) : 0);
+
+        parallelForChunks(0, h, [&](int chunk, int begin, int end) {
+            assert(begin == seams[size_t(chunk)]);
+
+            for (int y = begin; y != end; ++y) {
+                int* l = labels.data + y * w;
+                for (int x = 0; x != w; ++x)
+                    l[x] = -l[x] - 1;
+            }
+
+            if (!stats)
+                return;
+
+            const int first = first_label[size_t(chunk)];
+            const int last = (chunk + 1 < bands) ? first_label[size_t(chunk + 1)] : count + 1;
+
+            Band& band = partials[size_t(chunk)];
+            const int* top = labels.data + begin * w;
+            for (int x = 0; x != w; ++x)
+                if (top[x] > 0 && top[x] < first)
+                    band.carried.push_back(top[x]);
+            std::sort(band.carried.begin(), band.carried.end());
+            band.carried.erase(std::unique(band.carried.begin(), band.carried.end()), band.carried.end());
+
+            const int carried = int(band.carried.size());
+            band.partial.resize(size_t(carried + last - first));
+            Partial* partial = band.partial.data();
+
+            for (int y = begin; y != end; ++y) {
+                const int* l = labels.data + y * w;
+                for (int x = 0; x != w; ++x) {
+                    const int label = l[x];
+                    if (label <= 0)
+                        continue;
+
+                    const int k = (label >= first) ? carried + label - first :
+                        int(std::lower_bound(band.carried.begin(), band.carried.end(), label) - band.carried.begin());
+                    Partial& c = partial[k];
+                    c.area++;
+                    c.x0 = minimum(c.x0, x);
+                    c.y0 = minimum(c.y0, y);
+                    c.x1 = maximum(c.x1, x);
+                    c.y1 = maximum(c.y1, y);
+                    c.sx += x;
+                    c.sy += y;
+                }
+            }
+        }, components_band_rows);
+
+        if (stats) {
+            std::vector<Partial> total(static_cast<size_t>(count));
+            for (int b = 0; b != bands; ++b) {
+                Band const& band = partials[size_t(b)];
+                const int carried = int(band.carried.size());
+                for (int k = 0; k != int(band.partial.size()); ++k) {
+                    const int label = (k < carried) ? band.carried[size_t(k)] : first_label[size_t(b)] + k - carried;
+                    Partial const& p = band.partial[size_t(k)];
+                    Partial& c = total[size_t(label - 1)];
+                    c.area += p.area;
+                    c.x0 = minimum(c.x0, p.x0);
+                    c.y0 = minimum(c.y0, p.y0);
+                    c.x1 = maximum(c.x1, p.x1);
+                    c.y1 = maximum(c.y1, p.y1);
+                    c.sx += p.sx;
+                    c.sy += p.sy;
+                }
+            }
+
+            stats->resize(size_t(count));
+            for (int k = 0; k != count; ++k) {
+                Partial const& c = total[size_t(k)];
+                ComponentStats& s = (*stats)[size_t(k)];
+                s.area = c.area;
+                s.x = c.x0;
+                s.y = c.y0;
+                s.w = c.x1 - c.x0 + 1;
+                s.h = c.y1 - c.y0 + 1;
+                s.centroid = Vector2<float>(float(c.sx / c.area), float(c.sy / c.area));
+            }
+        }
+
+        return count;
+    }
+
+    int connectedComponents(Mat const& mask, Mati& labels, int connectivity) {
+        return connectedComponents(mask, labels, nullptr, connectivity);
+    }
+
+    int connectedComponents(Mat const& mask, Mati& labels, ComponentsStats& stats, int connectivity) {
+        return connectedComponents(mask, labels, &stats, connectivity);
+    }
+}
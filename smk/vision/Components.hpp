@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Mat.hpp"
+#include "../math/Vector.hpp"
+
+#include <vector>
+
+namespace smk
+{
+    //
+    // Connected component labelling of binary masks, like the output of threshold.
+    // Union find over row bands labelled in parallel, the band seams are merged afterwards.
+    // Components are numbered in raster order of their first pixel, so the labels
+    // don't depend on the number of threads.
+    //
+
+    // Region statistics of a component
+    // int area: number of pixels.
+    // int x, y, w, h: bounding box.
+    // point centroid: mean of the pixel coordinates.
+    struct ComponentStats
+    {
+        int area = 0;
+        int x = 0;
+        int y = 0;
+        int w = 0;
+        int h = 0;
+        Vector2<float> centroid;
+    };
+    using ComponentsStats = std::vector<ComponentStats>;
+
+    // Label the connected components of a mask.
+    // image mask: 1 channel image, pixels > 0 are foreground.
+    // labels - output: 0 for background, k + 1 for the pixels of component k.
+    // int connectivity: 4 or 8 neighbours.
+    // returns: number of components.
+    int connectedComponents(Mat const& mask, Mati& labels, int connectivity = 8);
+
+    // Same as above, also computes the statistics of every component in the labelling pass.
+    // stats - output: stats[k] for component k.
+    int connectedComponents(Mat const& mask, Mati& labels, ComponentsStats& stats, int connectivity = 8);
+}
@@ -0,0 +1,530 @@
+#include "Decomposition.hpp"
+#include "../math/Mathematics.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace smk
+{
+    // x = b, unless x already is b
+    template <typename T>
+    static void copyRightHandSide(MatT<T> const& b, MatT<T>& x)
+    {
+        if (&x == &b || x.data == b.data)
+            return;
+
+        x.reshape(b.w, b.h, 1);
+        memcpy(x.data, b.data, size_t(b.size()) * sizeof(T));
+    }
+
+    //
+    // LU
+    //
+    template <typename T>
+    LUDecompositionT<T>::LUDecompositionT(MatT<T> const& a)
+    {
+        compute(a);
+    }
+
+    template <typename T>
+    bool LUDecompositionT<T>::compute(MatT<T> const& a)
+    {
+        MatT<T> lu = a.clone();
+        return computeInPlace(lu);
+    }
+
+    template <typename T>
+    bool LUDecompositionT<T>::computeInPlace(MatT<T>& a)
+    {
+        m_lu = a;
+        m_valid = false;
+        m_sign = 1;
+
+        if (a.w != a.h || a.c != 1 || a.w == 0)
+            return false;
+
+        const int n = a.w;
+        m_pivots.resize(size_t(n));
+
+        for (int k = 0; k != n; ++k)
+        {
+            T p = 0;
+            int index = -1;
+            for (int i = k; i != n; ++i)
+            {
+                T val = absolute(a.data[i * n + k]);
+                if (val > p)
+                {
+                    p = val;
+                    index = i;
+                }
+            }
+
+            if (index == -1)
+                return false;
+
+            m_pivots[size_t(k)] = index;
+            if (index != k)
+            {
+                T* r0 = a.data + k * n;
+                T* r1 = a.data + index * n;
+                for (int j = 0; j != n; ++j)
+                    std::swap(r0[j], r1[j]);
+                m_sign = -m_sign;
+            }
+
+            const T* rk = a.data + k * n;
+            const T pivot = rk[k];
+            for (int i = k + 1; i != n; ++i)
+            {
+                T* ri = a.data + i * n;
+                const T l = ri[k] / pivot;
+                ri[k] = l;
+                for (int j = k + 1; j != n; ++j)
+                    ri[j] -= l * rk[j];
+            }
+        }
+
+        m_valid = true;
+        return true;
+    }
+
+    template <typename T>
+    bool LUDecompositionT<T>::valid() const { return m_valid; }
+
+    template <typename T>
+    int LUDecompositionT<T>::size() const { return m_lu.w; }
+
+    template <typename T>
+    T LUDecompositionT<T>::determinant() const
+    {
+        if (!m_valid)
+            return T(0);
+
+        T det = T(m_sign);
+        for (int i = 0; i != m_lu.w; ++i)
+            det *= m_lu.data[i * m_lu.w + i];
+        return det;
+    }
+
+    template <typename T>
+    void LUDecompositionT<T>::solve(MatT<T> const& b, MatT<T>& x) const
+    {
+        if (!m_valid)
+        {
+            x = MatT<T>();
+            return;
+        }
+
+        const int n = m_lu.w;
+        assert(b.h == n && b.c == 1);
+
+        copyRightHandSide(b, x);
+        const int k = x.w;
+        const T* lu = m_lu.data;
+
+        for (int i = 0; i != n; ++i)
+        {
+            const int p = m_pivots[size_t(i)];
+            if (p != i)
+            {
+                T* r0 = x.data + i * k;
+                T* r1 = x.data + p * k;
+                for (int j = 0; j != k; ++j)
+                    std::swap(r0[j], r1[j]);
+            }
+        }
+
+        // L y = P b
+        for (int i = 1; i != n; ++i)
+        {
+            T* xi = x.data + i * k;
+            for (int m = 0; m != i; ++m)
+            {
+                const T l = lu[i * n + m];
+                const T* xm = x.data + m * k;
+                for (int j = 0; j != k; ++j)
+                    xi[j] -= l * xm[j];
+            }
+        }
+
+        // U x = y
+        for (int i = n - 1; i >= 0; --i)
+        {
+            T* xi = x.data + i * k;
+            for (int m = i + 1; m != n; ++m)
+            {
+                const T u = lu[i * n + m];
+                const T* xm = x.data + m * k;
+                for (int j = 0; j != k; ++j)
+                    xi[j] -= u * xm[j];
+            }
+
+            const T d = lu[i * n + i];
+            for (int j = 0; j != k; ++j)
+                xi[j] /= d;
+        }
+    }
+
+    template <typename T>
+    MatT<T> LUDecompositionT<T>::solve(MatT<T> const& b) const
+    {
+        MatT<T> x;
+        solve(b, x);
+        return x;
+    }
+
+    template <typename T>
+    MatT<T> LUDecompositionT<T>::inverse() const
+    {
+        if (!m_valid)
+            return MatT<T>();
+
+        MatT<T> inv = MatT<T>::makeIdentity(m_lu.w, m_lu.w);
+        solve(inv, inv);
+        return inv;
+    }
+
+    template <typename T>
+    MatT<T> const& LUDecompositionT<T>::factors() const { return m_lu; }
+
+    //
+    // Cholesky
+    //
+    template <typename T>
+    CholeskyDecompositionT<T>::CholeskyDecompositionT(MatT<T> const& a)
+    {
+        compute(a);
+    }
+
+    template <typename T>
+    bool CholeskyDecompositionT<T>::compute(MatT<T> const& a)
+    {
+        MatT<T> l = a.clone();
+        return computeInPlace(l);
+    }
+
+    template <typename T>
+    bool CholeskyDecompositionT<T>::computeInPlace(MatT<T>& a)
+    {
+        m_l = a;
+        m_valid = false;
+
+        if (a.w != a.h || a.c != 1 || a.w == 0)
+            return false;
+
+        const int n = a.w;
+        for (int j = 0; j != n; ++j)
+        {
+            T* rj = a.data + j * n;
+
+            T d = rj[j];
+            for (int k = 0; k != j; ++k)
+                d -= rj[k] * rj[k];
+
+            if (!(d > T(0)))
+                return false;
+
+            const T ljj = std::sqrt(d);
+            rj[j] = ljj;
+
+            for (int i = j + 1; i != n; ++i)
+            {
+                T* ri = a.data + i * n;
+                T s = ri[j];
+                for (int k = 0; k != j; ++k)
+                    s -= ri[k] * rj[k];
+                ri[j] = s / ljj;
+            }
+        }
+
+        m_valid = true;
+        return true;
+    }
+
+    template <typename T>
+    bool CholeskyDecompositionT<T>::valid() const { return m_valid; }
+
+    template <typename T>
+    int CholeskyDecompositionT<T>::size() const { return m_l.w; }
+
+    template <typename T>
+    void CholeskyDecompositionT<T>::solve(MatT<T> const& b, MatT<T>& x) const
+    {
+        if (!m_valid)
+        {
+            x = MatT<T>();
+            return;
+        }
+
+        const int n = m_l.w;
+        assert(b.h == n && b.c == 1);
+
+        copyRightHandSide(b, x);
+        const int k = x.w;
+        const T* l = m_l.data;
+
+        // L y = b
+        for (int i = 0; i != n; ++i)
+        {
+            T* xi = x.data + i * k;
+            for (int m = 0; m != i; ++m)
+            {
+                const T v = l[i * n + m];
+                const T* xm = x.data + m * k;
+                for (int j = 0; j != k; ++j)
+                    xi[j] -= v * xm[j];
+            }
+
+            const T d = l[i * n + i];
+            for (int j = 0; j != k; ++j)
+                xi[j] /= d;
+        }
+
+        // L^T x = y
+        for (int i = n - 1; i >= 0; --i)
+        {
+            T* xi = x.data + i * k;
+            for (int m = i + 1; m != n; ++m)
+            {
+                const T v = l[m * n + i];
+                const T* xm = x.data + m * k;
+                for (int j = 0; j != k; ++j)
+                    xi[j] -= v * xm[j];
+            }
+
+            const T d = l[i * n + i];
+            for (int j = 0; j != k; ++j)
+                xi[j] /= d;
+        }
+    }
+
+    template <typename T>
+    MatT<T> CholeskyDecompositionT<T>::solve(MatT<T> const& b) const
+    {
+        MatT<T> x;
+        solve(b, x);
+        return x;
+    }
+
+    template <typename T>
+    MatT<T> CholeskyDecompositionT<T>::inverse() const
+    {
+        if (!m_valid)
+            return MatT<T>();
+
+        MatT<T> inv = MatT<T>::makeIdentity(m_l.w, m_l.w);
+        solve(inv, inv);
+        return inv;
+    }
+
+    template <typename T>
+    MatT<T> const& CholeskyDecompositionT<T>::factors() const { return m_l; }
+
+    //
+    // QR
+    //
+    template <typename T>
+    QRDecompositionT<T>::QRDecompositionT(MatT<T> const& a)
+    {
+        compute(a);
+    }
+
+    template <typename T>
+    bool QRDecompositionT<T>::compute(MatT<T> const& a)
+    {
+        MatT<T> qr = a.clone();
+        return computeInPlace(qr);
+    }
+
+    template <typename T>
+    bool QRDecompositionT<T>::computeInPlace(MatT<T>& a)
+    {
+        m_qr = a;
+        m_valid = false;
+
+        const int m = a.h;
+        const int n = a.w;
+        if (m < n || a.c != 1 || n == 0)
+            return false;
+
+        m_tau.assign(size_t(n), T(0));
+        std::vector<T> s(static_cast<size_t>(n));
+
+        for (int k = 0; k != n; ++k)
+        {
+            T norm = 0;
+            for (int i = k; i != m; ++i)
+                norm += a.data[i * n + k] * a.data[i * n + k];
+            norm = std::sqrt(norm);
+
+            if (norm == T(0))
+                continue;
+
+            // H = I - tau v v^T, v(k) = 1, H x = alpha e1
+            const T x0 = a.data[k * n + k];
+            const T alpha = (x0 >= T(0)) ? -norm : norm;
+            const T v0 = x0 - alpha;
+            const T tau = (alpha - x0) / alpha;
+
+            a.data[k * n + k] = alpha;
+            for (int i = k + 1; i != m; ++i)
+                a.data[i * n + k] /= v0;
+            m_tau[size_t(k)] = tau;
+
+            // apply H to the remaining columns, row by row
+            const T* rk = a.data + k * n;
+            for (int j = k + 1; j != n; ++j)
+                s[size_t(j)] = rk[j];
+            for (int i = k + 1; i != m; ++i)
+            {
+                const T* ri = a.data + i * n;
+                const T v = ri[k];
+                for (int j = k + 1; j != n; ++j)
+                    s[size_t(j)] += v * ri[j];
+            }
+            for (int j = k + 1; j != n; ++j)
+                s[size_t(j)] *= tau;
+
+            T* wk = a.data + k * n;
+            for (int j = k + 1; j != n; ++j)
+                wk[j] -= s[size_t(j)];
+            for (int i = k + 1; i != m; ++i)
+            {
+                T* ri = a.data + i * n;
+                const T v = ri[k];
+                for (int j = k + 1; j != n; ++j)
+                    ri[j] -= s[size_t(j)] * v;
+            }
+        }
+
+        // rank check on the diagonal of R
+        T largest = 0;
+        for (int k = 0; k != n; ++k)
+            largest = maximum(largest, absolute(a.data[k * n + k]));
+
+        const T tolerance = largest * std::numeric_limits<T>::epsilon() * T(m);
+        for (int k = 0; k != n; ++k)
+            if (!(absolute(a.data[k * n + k]) > tolerance))
+                return false;
+
+        m_valid = true;
+        return true;
+    }
+
+    template <typename T>
+    bool QRDecompositionT<T>::valid() const { return m_valid; }
+
+    template <typename T>
+    int QRDecompositionT<T>::rows() const { return m_qr.h; }
+
+    template <typename T>
+    int QRDecompositionT<T>::cols() const { return m_qr.w; }
+
+    template <typename T>
+    void QRDecompositionT<T>::solve(MatT<T> const& b, MatT<T>& x) const
+    {
+        if (!m_valid)
+        {
+            x = MatT<T>();
+            return;
+        }
+
+        const int m = m_qr.h;
+        const int n = m_qr.w;
+        assert(b.h == m && b.c == 1);
+
+        // y = Q^T b
+        MatT<T> y = b.clone();
+        const int k = y.w;
+        const T* qr = m_qr.data;
+        std::vector<T> s(static_cast<size_t>(k));
+
+        for (int c = 0; c != n; ++c)
+        {
+            const T tau = m_tau[size_t(c)];
+            if (tau == T(0))
+                continue;
+
+            const T* yc = y.data + c * k;
+            for (int j = 0; j != k; ++j)
+                s[size_t(j)] = yc[j];
+            for (int i = c + 1; i != m; ++i)
+            {
+                const T v = qr[i * n + c];
+                const T* yi = y.data + i * k;
+                for (int j = 0; j != k; ++j)
+                    s[size_t(j)] += v * yi[j];
+            }
+            for (int j = 0; j != k; ++j)
+                s[size_t(j)] *= tau;
+
+            T* wc = y.data + c * k;
+            for (int j = 0; j != k; ++j)
+                wc[j] -= s[size_t(j)];
+            for (int i = c + 1; i != m; ++i)
+            {
+                const T v = qr[i * n + c];
+                T* yi = y.data + i * k;
+                for (int j = 0; j != k; ++j)
+                    yi[j] -= s[size_t(j)] * v;
+            }
+        }
+
+        // R x = y
+        x.reshape(k, n, 1);
+        for (int i = n - 1; i >= 0; --i)
+        {
+            T* xi = x.data + i * k;
+            const T* yi = y.data + i * k;
+            for (int j = 0; j != k; ++j)
+                xi[j] = yi[j];
+
+            for (int c = i + 1; c != n; ++c)
+            {
+                const T r = qr[i * n + c];
+                const T* xc = x.data + c * k;
+                for (int j = 0; j != k; ++j)
+                    xi[j] -= r * xc[j];
+            }
+
+            const T d = qr[i * n + i];
+            for (int j = 0; j != k; ++j)
+                xi[j] /= d;
+        }
+    }
+
+    template <typename T>
+    MatT<T> QRDecompositionT<T>::solve(MatT<T> const& b) const
+    {
+        MatT<T> x;
+        solve(b, x);
+        return x;
+    }
+
+    template <typename T>
+    MatT<T> QRDecompositionT<T>::r() const
+    {
+        const int n = m_qr.w;
+        MatT<T> r(n, n);
+        for (int i = 0; i != n; ++i)
+            for (int j = i; j != n; ++j)
+                r.data[i * n + j] = m_qr.data[i * n + j];
+        return r;
+    }
+
+    template <typename T>
+    MatT<T> const& QRDecompositionT<T>::factors() const { return m_qr; }
+
+    //
+    // force template instantiation
+    //
+    template class LUDecompositionT<float>;
+    template class LUDecompositionT<double>;
+    template class CholeskyDecompositionT<float>;
+    template class CholeskyDecompositionT<double>;
+    template class QRDecompositionT<float>;
+    template class QRDecompositionT<double>;
+}
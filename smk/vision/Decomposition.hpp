@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Mat.hpp"
+
+#include <vector>
+
+namespace smk
+{
+    //
+    // Matrix factorizations, factor once and solve many times.
+    // Right hand sides are n x k matrices (k columns), solving many systems with one call.
+    // compute() copies the input, computeInPlace() factors the given matrix in place, it becomes
+    // the factorization storage (MatT copies are shallow, the caller sees the factors).
+    // A failed factorization leaves valid() false and solves return an empty Mat.
+    //
+
+    // LU decomposition with partial pivoting, P A = L U.
+    // L (unit diagonal) and U are stored in one n x n matrix.
+    template <typename T>
+    class LUDecompositionT
+    {
+    public:
+        LUDecompositionT() = default;
+        explicit LUDecompositionT(MatT<T> const& a);
+
+        // returns: false when a is not square or is singular.
+        bool compute(MatT<T> const& a);
+        bool computeInPlace(MatT<T>& a);
+
+        bool valid() const;
+        int size() const;
+        T determinant() const;
+
+        // Solves A x = b.
+        // matrix b: n x k right hand sides.
+        // x - output: n x k solutions, may be b itself.
+        void solve(MatT<T> const& b, MatT<T>& x) const;
+        MatT<T> solve(MatT<T> const& b) const;
+
+        MatT<T> inverse() const;
+
+        MatT<T> const& factors() const;
+
+    private:
+        MatT<T> m_lu;
+        std::vector<int> m_pivots;
+        int m_sign = 1;
+        bool m_valid = false;
+    };
+    using LUDecomposition = LUDecompositionT<float>;
+    using LUDecompositiond = LUDecompositionT<double>;
+
+    // Cholesky decomposition of a symmetric positive definite matrix, A = L L^T.
+    // Only the lower triangle of A is read, L is stored in the lower triangle.
+    template <typename T>
+    class CholeskyDecompositionT
+    {
+    public:
+        CholeskyDecompositionT() = default;
+        explicit CholeskyDecompositionT(MatT<T> const& a);
+
+        // returns: false when a is not square or not positive definite.
+        bool compute(MatT<T> const& a);
+        bool computeInPlace(MatT<T>& a);
+
+        bool valid() const;
+        int size() const;
+
+        // Solves A x = b, x may be b itself.
+        void solve(MatT<T> const& b, MatT<T>& x) const;
+        MatT<T> solve(MatT<T> const& b) const;
+
+        MatT<T> inverse() const;
+
+        MatT<T> const& factors() const;
+
+    private:
+        MatT<T> m_l;
+        bool m_valid = false;
+    };
+    using CholeskyDecomposition = CholeskyDecompositionT<float>;
+    using CholeskyDecompositiond = CholeskyDecompositionT<double>;
+
+    // Householder QR decomposition of a m x n matrix (m >= n), A = Q R.
+    // R is stored in the upper triangle, the householder vectors below the diagonal.
+    // Least squares solves never form A^T A, the conditioning is the one of A.
+    template <typename T>
+    class QRDecompositionT
+    {
+    public:
+        QRDecompositionT() = default;
+        explicit QRDecompositionT(MatT<T> const& a);
+
+        // returns: false when a has less rows than columns or is rank deficient.
+        bool compute(MatT<T> const& a);
+        bool computeInPlace(MatT<T>& a);
+
+        bool valid() const;
+        int rows() const;
+        int cols() const;
+
+        // Least squares solution of A x = b.
+        // matrix b: m x k right hand sides.
+        // x - output: n x k solutions.
+        void solve(MatT<T> const& b, MatT<T>& x) const;
+        MatT<T> solve(MatT<T> const& b) const;
+
+        // the n x n upper triangular factor
+        MatT<T> r() const;
+
+        MatT<T> const& factors() const;
+
+    private:
+        MatT<T> m_qr;
+        std::vector<T> m_tau;
+        bool m_valid = false;
+    };
+    using QRDecomposition = QRDecompositionT<float>;
+    using QRDecompositiond = QRDecompositionT<double>;
+}
@@ -5,6 +5,8 @@
 #include <cassert>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace smk
 {
@@ -141,51 +143,35 @@ namespace smk
         return filtered;
     }
 
-    template<typename T>
-    static Vector2<float> project(const MatT<T> &H, const Vector2<float> &p) {
-        assert(H.w == 3 && H.h == 3 && H.c == 1);
-
-        MatT<T> pm(1, 3);
-        pm(0,0) = T(p.x());
-        pm(1,0) = T(p.y());
-        pm(2,0) = 1;
-
-        MatT<T> projected = MatT<T>::mmult(H, pm);
-        return Vector2<T>(projected(0,0) / projected(2,0),
-                          projected(1,0) / projected(2,0));
-    }
-
     Vector2<float> projectPoint(const Mat &H, const Vector2<float> &p) {
-        return project(H, p);
+        return Homography3x3T<float>(H).project(p);
     }
 
     Vector2<float> projectPoint(const Matd &H, const Vector2<float> &p) {
-        return project(H, p);
+        return Homography3x3(H).project(p);
+    }
+
+    void projectPoints(Homography3x3 const &H, Vector2<float> const *in, Vector2<float> *out, int n) {
+        for (int i = 0; i < n; ++i)
+            out[i] = H.project(in[i]);
     }
 
     int modelInliers(const Matd &H, Matches &m, float thresh)
+    {
+        return modelInliers(Homography3x3(H), m, thresh);
+    }
+
+    int modelInliers(Homography3x3 const &H, Matches &m, float thresh)
     {
         // count number of matches that are inliers
         // i.e. distance(H*p, q) < thresh
         // Also, sort the matches m so the inliers are the first 'count' elements.
+        auto inliers = std::stable_partition(m.begin(), m.end(), [&H, thresh](Match const &current) {
+            Vector2<float> projected = H.project(current.p);
+            return smk::distance(current.q, projected) < thresh;
+        });
 
-        Matches inliers;
-        Matches outliers;
-
-        for (Match const &current : m)
-        {
-            Vector2<float> projected = projectPoint(H, current.p);
-            float distance = smk::distance(current.q, projected);
-            if (distance < thresh)
-                inliers.push_back(current);
-            else
-                outliers.push_back(current);
-        }
-
-        m.assign(inliers.begin(), inliers.end());
-        std::copy(outliers.begin(), outliers.end(), std::back_inserter(m));
-
-        return int(inliers.size());
+        return int(inliers - m.begin());
     }
 
     void randomizeMatches(Matches& m) {
@@ -196,67 +182,310 @@ namespace smk
         }
     }
 
-    //https://math.stackexchange.com/questions/494238/how-to-compute-homography-matrix-h-from-corresponding-points-2d-2d-planar-homog
+    // three points are collinear when the triangle area is tiny compared to its edges
+    template <typename Point>
+    static bool collinear(Point const &a, Point const &b, Point const &c)
+    {
+        const double ux = double(b.x()) - double(a.x()), uy = double(b.y()) - double(a.y());
+        const double vx = double(c.x()) - double(a.x()), vy = double(c.y()) - double(a.y());
+        const double cross = ux * vy - uy * vx;
+        return !(std::fabs(cross) > 1e-9 * std::sqrt((ux * ux + uy * uy) * (vx * vx + vy * vy)));
+    }
+
+    template <typename Point>
+    static bool collinearQuad(Point const &p0, Point const &p1, Point const &p2, Point const &p3)
+    {
+        return collinear(p0, p1, p2) || collinear(p0, p1, p3) || collinear(p0, p2, p3) || collinear(p1, p2, p3);
+    }
+
+    // Projective map from the unit square (0,0) (1,0) (1,1) (0,1) to the quad of 4 points.
+    // Heckbert, Fundamentals of Texture Mapping and Image Warping, 1989
+    // returns: false when p1, p2, p3 are collinear, the map doesn't exist.
+    template <typename Point>
+    static bool squareToQuad(Point const &p0, Point const &p1, Point const &p2, Point const &p3, double *q)
+    {
+        const double x0 = p0.x(), y0 = p0.y();
+        const double x1 = p1.x(), y1 = p1.y();
+        const double x2 = p2.x(), y2 = p2.y();
+        const double x3 = p3.x(), y3 = p3.y();
+
+        const double sx = x0 - x1 + x2 - x3;
+        const double sy = y0 - y1 + y2 - y3;
+        const double dx1 = x1 - x2, dx2 = x3 - x2;
+        const double dy1 = y1 - y2, dy2 = y3 - y2;
+        const double den = dx1 * dy2 - dx2 * dy1;
+        if (!(std::fabs(den) > 1e-9 * std::sqrt((dx1 * dx1 + dy1 * dy1) * (dx2 * dx2 + dy2 * dy2))))
+            return false;
+
+        const double g = (sx * dy2 - dx2 * sy) / den;
+        const double h = (dx1 * sy - sx * dy1) / den;
+
+        q[0] = x1 - x0 + g * x1; q[1] = x3 - x0 + h * x3; q[2] = x0;
+        q[3] = y1 - y0 + g * y1; q[4] = y3 - y0 + h * y3; q[5] = y0;
+        q[6] = g;                q[7] = h;                q[8] = 1.0;
+        return true;
+    }
+
+    // a 3x3 map is degenerate when its determinant is tiny compared to its columns
+    static bool degenerate3x3(double const *q, double &det)
+    {
+        det = q[0] * (q[4] * q[8] - q[5] * q[7]) -
+              q[1] * (q[3] * q[8] - q[5] * q[6]) +
+              q[2] * (q[3] * q[7] - q[4] * q[6]);
+
+        double scale = 1.0;
+        for (int c = 0; c != 3; ++c)
+            scale *= std::sqrt(q[c] * q[c] + q[c + 3] * q[c + 3] + q[c + 6] * q[c + 6]);
+
+        return !(std::fabs(det) > 1e-9 * scale);
+    }
+
+    // scales H so that H(2,2) is 1, fails when H(2,2) vanishes
+    static bool normalizeHomography(double *h)
+    {
+        double norm = 0.0;
+        for (int i = 0; i != 9; ++i)
+            norm += h[i] * h[i];
+
+        if (!(std::fabs(h[8]) > 1e-12 * std::sqrt(norm)))
+            return false;
+
+        const double scale = 1.0 / h[8];
+        for (int i = 0; i != 9; ++i)
+            h[i] *= scale;
+        h[8] = 1.0;
+        return true;
+    }
+
+    bool computeHomography4(Match const *m, Homography3x3 &H)
+    {
+        // square -> p and square -> q, H = Q * P^-1 with the adjugate standing for the inverse
+        if (collinearQuad(m[0].p, m[1].p, m[2].p, m[3].p) || collinearQuad(m[0].q, m[1].q, m[2].q, m[3].q))
+            return false;
+
+        double P[9], Q[9];
+        if (!squareToQuad(m[0].p, m[1].p, m[2].p, m[3].p, P) || !squareToQuad(m[0].q, m[1].q, m[2].q, m[3].q, Q))
+            return false;
+
+        double det;
+        if (degenerate3x3(P, det) || degenerate3x3(Q, det))
+            return false;
+
+        const double A[9] = {
+            P[4] * P[8] - P[5] * P[7], P[2] * P[7] - P[1] * P[8], P[1] * P[5] - P[2] * P[4],
+            P[5] * P[6] - P[3] * P[8], P[0] * P[8] - P[2] * P[6], P[2] * P[3] - P[0] * P[5],
+            P[3] * P[7] - P[4] * P[6], P[1] * P[6] - P[0] * P[7], P[0] * P[4] - P[1] * P[3]};
+
+        double h[9];
+        for (int r = 0; r != 3; ++r)
+            for (int c = 0; c != 3; ++c)
+                h[r * 3 + c] = Q[r * 3 + 0] * A[0 * 3 + c] + Q[r * 3 + 1] * A[1 * 3 + c] + Q[r * 3 + 2] * A[2 * 3 + c];
+
+        if (!normalizeHomography(h))
+            return false;
+
+        for (int i = 0; i != 9; ++i)
+            H.m[i] = h[i];
+        return true;
+    }
+
+    // Hartley normalization, centroid at the origin and mean distance sqrt(2)
+    // x' = s * (x - cx)
+    struct HomographyNormalization
+    {
+        double cx = 0.0;
+        double cy = 0.0;
+        double s = 1.0;
+    };
+
+    template <typename Getter>
+    static HomographyNormalization homographyNormalization(Match const *matches, int n, Getter get)
+    {
+        HomographyNormalization t;
+        for (int i = 0; i != n; ++i)
+        {
+            t.cx += double(get(matches[i]).x());
+            t.cy += double(get(matches[i]).y());
+        }
+        t.cx /= n;
+        t.cy /= n;
+
+        double mean = 0.0;
+        for (int i = 0; i != n; ++i)
+        {
+            const double dx = double(get(matches[i]).x()) - t.cx;
+            const double dy = double(get(matches[i]).y()) - t.cy;
+            mean += std::sqrt(dx * dx + dy * dy);
+        }
+        mean /= n;
+
+        t.s = (mean > 0.0) ? std::sqrt(2.0) / mean : 1.0;
+        return t;
+    }
+
+    // Folds a row into the upper triangular R with Givens rotations, R^T R grows by row^T row
+    // without ever forming the normal equations.
+    static void givensAccumulate(double R[9][9], double *row)
+    {
+        for (int k = 0; k != 9; ++k)
+        {
+            if (row[k] == 0.0)
+                continue;
+
+            const double r = std::hypot(R[k][k], row[k]);
+            const double c = R[k][k] / r;
+            const double s = row[k] / r;
+
+            R[k][k] = r;
+            row[k] = 0.0;
+            for (int j = k + 1; j != 9; ++j)
+            {
+                const double a = R[k][j];
+                const double b = row[j];
+                R[k][j] = c * a + s * b;
+                row[j] = c * b - s * a;
+            }
+        }
+    }
+
+    // Right singular vector of the smallest singular value, one sided Jacobi on the columns of A.
+    static void smallestRightSingularVector(double A[9][9], double *v)
+    {
+        double V[9][9] = {};
+        for (int i = 0; i != 9; ++i)
+            V[i][i] = 1.0;
+
+        for (int sweep = 0; sweep != 60; ++sweep)
+        {
+            bool rotated = false;
+
+            for (int p = 0; p != 8; ++p)
+                for (int q = p + 1; q != 9; ++q)
+                {
+                    double alpha = 0.0, beta = 0.0, gamma = 0.0;
+                    for (int i = 0; i != 9; ++i)
+                    {
+                        alpha += A[i][p] * A[i][p];
+                        beta += A[i][q] * A[i][q];
+                        gamma += A[i][p] * A[i][q];
+                    }
+
+                    if (!(std::fabs(gamma) > 1e-15 * std::sqrt(alpha * beta)))
+                        continue;
+
+                    rotated = true;
+                    const double zeta = (beta - alpha) / (2.0 * gamma);
+                    const double t = (zeta >= 0.0 ? 1.0 : -1.0) / (std::fabs(zeta) + std::sqrt(1.0 + zeta * zeta));
+                    const double c = 1.0 / std::sqrt(1.0 + t * t);
+                    const double s = c * t;
+
+                    for (int i = 0; i != 9; ++i)
+                    {
+                        const double ap = A[i][p];
+                        const double aq = A[i][q];
+                        A[i][p] = c * ap - s * aq;
+                        A[i][q] = s * ap + c * aq;
+
+                        const double vp = V[i][p];
+                        const double vq = V[i][q];
+                        V[i][p] = c * vp - s * vq;
+                        V[i][q] = s * vp + c * vq;
+                    }
+                }
+
+            if (!rotated)
+                break;
+        }
+
+        // singular values are the column norms
+        int smallest = 0;
+        double smallest_norm = std::numeric_limits<double>::max();
+        for (int j = 0; j != 9; ++j)
+        {
+            double norm = 0.0;
+            for (int i = 0; i != 9; ++i)
+                norm += A[i][j] * A[i][j];
+
+            if (norm < smallest_norm)
+            {
+                smallest_norm = norm;
+                smallest = j;
+            }
+        }
+
+        for (int i = 0; i != 9; ++i)
+            v[i] = V[i][smallest];
+    }
+
     Matd computeHomography(Matches const &matches)
     {
-        size_t n = matches.size();
-        Matd M(8, int(n * 2));
-        Matd b(1, int(n * 2));
+        return computeHomography(matches.data(), int(matches.size()));
+    }
 
-        // fill in the matrices M and b.
-        for (size_t i = 0; i < n; ++i)
+    Matd computeHomography(Match const *matches, int n)
+    {
+        Matd none;
+        if (n < 4)
+            return none;
+
+        if (n == 4)
         {
-            double x = double(matches[i].p.x());
-            double xp = double(matches[i].q.x());
-
-            double y = double(matches[i].p.y());
-            double yp = double(matches[i].q.y());
-
-            int r = int(i * 2);
-            M(r, 0) = x;
-            M(r, 1) = y;
-            M(r, 2) = 1;
-            M(r, 3) = 0;
-            M(r, 4) = 0;
-            M(r, 5) = 0;
-            M(r, 6) = -x * xp;
-            M(r, 7) = -y * xp;
-            b(r, 0) = xp;
-
-            r++;
-
-            M(r, 0) = 0;
-            M(r, 1) = 0;
-            M(r, 2) = 0;
-            M(r, 3) = x;
-            M(r, 4) = y;
-            M(r, 5) = 1;
-            M(r, 6) = -x * yp;
-            M(r, 7) = -y * yp;
-            b(r, 0) = yp;
+            Homography3x3 H;
+            if (!computeHomography4(matches, H))
+                return none;
+            return H.mat();
         }
 
-        Matd a = Matd::llsSolve(M, b);
+        const HomographyNormalization tp = homographyNormalization(matches, n, [](Match const &m) { return m.p; });
+        const HomographyNormalization tq = homographyNormalization(matches, n, [](Match const &m) { return m.q; });
 
-        // If a solution can't be found, return empty matrix;
-        if (a.size() == 0)
-            return a;
+        // each match gives two rows of A h = 0
+        // [x y 1 0 0 0 -x*xp -y*xp -xp]
+        // [0 0 0 x y 1 -x*yp -y*yp -yp]
+        double R[9][9] = {};
+        for (int i = 0; i != n; ++i)
+        {
+            const double x = tp.s * (double(matches[i].p.x()) - tp.cx);
+            const double y = tp.s * (double(matches[i].p.y()) - tp.cy);
+            const double xp = tq.s * (double(matches[i].q.x()) - tq.cx);
+            const double yp = tq.s * (double(matches[i].q.y()) - tq.cy);
+
+            double r0[9] = {x, y, 1.0, 0.0, 0.0, 0.0, -x * xp, -y * xp, -xp};
+            double r1[9] = {0.0, 0.0, 0.0, x, y, 1.0, -x * yp, -y * yp, -yp};
+            givensAccumulate(R, r0);
+            givensAccumulate(R, r1);
+        }
 
-        // fill in the homography H based on the result in a.
-        Matd H(3, 3);
+        double hn[9];
+        smallestRightSingularVector(R, hn);
 
-        H(0,0) = a(0,0);
-        H(0,1) = a(1,0);
-        H(0,2) = a(2,0);
-        
-        H(1,0) = a(3,0);
-        H(1,1) = a(4,0);
-        H(1,2) = a(5,0);
+        // H = Tq^-1 * Hn * Tp
+        // Tp = [s 0 -s*cx; 0 s -s*cy; 0 0 1], Tq^-1 = [1/s 0 cx; 0 1/s cy; 0 0 1]
+        double HT[9];
+        for (int r = 0; r != 3; ++r)
+        {
+            const double a = hn[r * 3 + 0];
+            const double b = hn[r * 3 + 1];
+            const double c = hn[r * 3 + 2];
+            HT[r * 3 + 0] = a * tp.s;
+            HT[r * 3 + 1] = b * tp.s;
+            HT[r * 3 + 2] = c - a * tp.s * tp.cx - b * tp.s * tp.cy;
+        }
+
+        double h[9];
+        for (int c = 0; c != 3; ++c)
+        {
+            h[0 * 3 + c] = HT[0 * 3 + c] / tq.s + tq.cx * HT[2 * 3 + c];
+            h[1 * 3 + c] = HT[1 * 3 + c] / tq.s + tq.cy * HT[2 * 3 + c];
+            h[2 * 3 + c] = HT[2 * 3 + c];
+        }
 
-        H(2,0) = a(6,0);
-        H(2,1) = a(7,0);
-        H(2,2) = 1.0;
+        if (!normalizeHomography(h))
+            return none;
 
+        Matd H(3, 3);
+        for (int i = 0; i != 9; ++i)
+            H.data[i] = h[i];
         return H;
     }
 
@@ -275,30 +504,27 @@ namespace smk
         //             return it immediately
         // if we get to the end return the best homography
 
-        //n – minimum number of data points required to estimate model parameters
-        const int n = 4;
+        // the minimal sample goes through the closed form 4 point solver,
+        // only the refit on the inliers builds a Matd
         int best = 0;
         Matd Hb;
-        Matches subset;
+        Homography3x3 sample;
 
         int current_iteration = 0;
         while (current_iteration < k) {
             current_iteration++;
 
             randomizeMatches(m);
-            subset.assign(m.begin(), m.begin() + n);
-            Matd H = computeHomography(subset);
-            if (H.size() == 0) {
+            if (!computeHomography4(m.data(), sample)) {
                 //std::cerr << "Homography is empty" << std::endl;
                 continue;
             }
 
-            int inliers = modelInliers(H, m, thresh);
+            int inliers = modelInliers(sample, m, thresh);
             if (inliers <= best)
                 continue;
 
-            subset.assign(m.begin(), m.begin() + inliers);
-            H = computeHomography(subset);
+            Matd H = computeHomography(m.data(), inliers);
             if (H.size() == 0) {
                 std::cerr << "Homography is empty on full inliers" << std::endl;
                 continue;
@@ -395,7 +621,7 @@ namespace smk
 
     float minEigenValue2x2(float a, float b, float c, float d)
     {
-        float common = powf(((a + d) * (a + d))/4 - (a * d - b * c), 0.5);
+        float common = sqrtf(((a + d) * (a + d))/4 - (a * d - b * c));
         float ev_one = (a + d)/2 + common;
         float ev_two = (a + d)/2 - common;
         return (ev_one >= ev_two) ? ev_two : ev_one;
@@ -406,6 +632,10 @@ namespace smk
         return minEigenValue2x2(m.data[0], m.data[1], m.data[2], m.data[3]);
     }
 
+    float minEigenValue2x2(Mat2 const& m) {
+        return minEigenValue2x2(m[0], m[1], m[2], m[3]);
+    }
+
     void shiTomasiCornernessResponse(Mat const &S, Mat &R)
     {
         float multiplier = 9.0f; // try to match harris values for thresholds
@@ -449,4 +679,148 @@ namespace smk
         return d;
     }
 
+    float harrisScore(Mat const &im, int x, int y, int r)
+    {
+        assert(im.c == 1);
+        assert(x > r && y > r && x < im.w - r - 1 && y < im.h - r - 1);
+
+        float const alpha = 0.06f;
+        float xx = 0.0f;
+        float yy = 0.0f;
+        float xy = 0.0f;
+
+        for (int j = y - r; j <= y + r; ++j)
+        {
+            const float *r0 = im.data + (j - 1) * im.w;
+            const float *r1 = r0 + im.w;
+            const float *r2 = r1 + im.w;
+
+            for (int i = x - r; i <= x + r; ++i)
+            {
+                const float gx = (r0[i + 1] - r0[i - 1]) + 2.0f * (r1[i + 1] - r1[i - 1]) + (r2[i + 1] - r2[i - 1]);
+                const float gy = (r2[i - 1] + 2.0f * r2[i] + r2[i + 1]) - (r0[i - 1] + 2.0f * r0[i] + r0[i + 1]);
+                xx += gx * gx;
+                yy += gy * gy;
+                xy += gx * gy;
+            }
+        }
+
+        const float trace = xx + yy;
+        const float det = xx * yy - xy * xy;
+        return det - (alpha * trace * trace);
+    }
+
+    // true if mask has at least arc contiguous bits set on its 16 bit circle
+    static inline bool fastArc(unsigned mask, int arc)
+    {
+        unsigned circular = mask | (mask << 16);
+        unsigned run = circular;
+        for (int i = 1; i < arc && run; ++i)
+            run &= circular >> i;
+        return (run & 0xFFFF) != 0;
+    }
+
+    Descriptors fastCornerDetector(Mat const &im, float thresh, int nms, int arc)
+    {
+        assert(arc >= 9 && arc <= 12);
+
+        Descriptors d;
+
+        Mat gray = im;
+        if (gray.c > 1)
+            gray = rgb2gray(gray);
+
+        // bresenham circle of radius 3, clockwise starting at the top
+        static const int circle[16][2] = {
+            { 0, -3}, { 1, -3}, { 2, -2}, { 3, -1}, { 3,  0}, { 3,  1}, { 2,  2}, { 1,  3},
+            { 0,  3}, {-1,  3}, {-2,  2}, {-3,  1}, {-3,  0}, {-3, -1}, {-2, -2}, {-1, -3}
+        };
+
+        int offset[16];
+        for (int k = 0; k != 16; ++k)
+            offset[k] = circle[k][1] * gray.w + circle[k][0];
+
+        // any arc of 9 contains 2 of the 4 compass points, an arc of 12 contains 3
+        const int compass = (arc >= 12) ? 3 : 2;
+
+        // the harris window needs 1 pixel more than the circle
+        const int radius = 3;
+        const int border = radius + 1;
+
+        std::vector<int> candidates;
+        std::vector<float> scores;
+
+        for (int y = border; y < gray.h - border; ++y)
+        {
+            const float *row = gray.data + y * gray.w;
+
+            for (int x = border; x < gray.w - border; ++x)
+            {
+                const float *p = row + x;
+                const float hi = *p + thresh;
+                const float lo = *p - thresh;
+
+                // early rejection on the compass points
+                const float v0 = p[offset[0]];
+                const float v8 = p[offset[8]];
+                if (!(v0 > hi || v0 < lo || v8 > hi || v8 < lo))
+                    continue;
+
+                const float v4 = p[offset[4]];
+                const float v12 = p[offset[12]];
+                const int brighter = (v0 > hi) + (v4 > hi) + (v8 > hi) + (v12 > hi);
+                const int darker = (v0 < lo) + (v4 < lo) + (v8 < lo) + (v12 < lo);
+                if (brighter < compass && darker < compass)
+                    continue;
+
+                // full segment test
+                unsigned bright_mask = 0;
+                unsigned dark_mask = 0;
+                for (int k = 0; k != 16; ++k)
+                {
+                    const float v = p[offset[k]];
+                    bright_mask |= unsigned(v > hi) << k;
+                    dark_mask |= unsigned(v < lo) << k;
+                }
+
+                if (!fastArc(bright_mask, arc) && !fastArc(dark_mask, arc))
+                    continue;
+
+                // edges pass the segment test now and then, harris drops them
+                const float score = harrisScore(gray, x, y, radius);
+                if (score <= 0.0f)
+                    continue;
+
+                candidates.push_back(y * gray.w + x);
+                scores.push_back(score);
+            }
+        }
+
+        // Run NMS on the candidates only, they are in raster order so the ones inside the window
+        // on each row are a binary search away, no full resolution response map
+        for (size_t i = 0; i != candidates.size(); ++i)
+        {
+            const int x = candidates[i] % gray.w;
+            const int y = candidates[i] / gray.w;
+            const float value = scores[i];
+
+            bool local_max = true;
+            for (int ky = maximum(y - nms, 0); ky <= minimum(y + nms, gray.h - 1) && local_max; ++ky)
+            {
+                const int first = ky * gray.w + maximum(x - nms, 0);
+                const int last = ky * gray.w + minimum(x + nms, gray.w - 1);
+
+                auto j = std::lower_bound(candidates.begin(), candidates.end(), first);
+                for (; j != candidates.end() && *j <= last && local_max; ++j)
+                    if (scores[size_t(j - candidates.begin())] > value)
+                        local_max = false;
+            }
+
+            if (local_max)
+                d.push_back(Descriptor::describe(gray, candidates[i]));
+        }
+
+        return d;
+    }
+
 } // namespace vs
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "Mat.hpp"
+#include "FixedMat.hpp"
 #include "../math/Vector.hpp"
 
+#include <cassert>
 #include <vector>
 
 
@@ -62,6 +64,42 @@ namespace smk
     //          one other descriptor in b.
     Matches matchDescriptors(Descriptors const& a, Descriptors const& b);
 
+    // A 3x3 homography held by value, projecting points doesn't touch the heap.
+    // Same arithmetic as MatT::mmult with a (x, y, 1) column, projections match the Mat path bit for bit.
+    template<typename T>
+    struct Homography3x3T
+    {
+        T m[9] = { T(1), T(0), T(0), T(0), T(1), T(0), T(0), T(0), T(1) };
+
+        Homography3x3T() = default;
+
+        explicit Homography3x3T(MatT<T> const& H) {
+            assert(H.w == 3 && H.h == 3 && H.c == 1);
+            for (int i = 0; i != 9; ++i)
+                m[i] = H.data[i];
+        }
+
+        MatT<T> mat() const {
+            MatT<T> H(3, 3);
+            for (int i = 0; i != 9; ++i)
+                H.data[i] = m[i];
+            return H;
+        }
+
+        T& operator()(int row, int col) { return m[row * 3 + col]; }
+        T operator()(int row, int col) const { return m[row * 3 + col]; }
+
+        Vector2<float> project(Vector2<float> const& p) const {
+            const T x = T(p.x());
+            const T y = T(p.y());
+            const T X = (m[0] * x + m[1] * y) + m[2];
+            const T Y = (m[3] * x + m[4] * y) + m[5];
+            const T Z = (m[6] * x + m[7] * y) + m[8];
+            return Vector2<float>(float(X / Z), float(Y / Z));
+        }
+    };
+    using Homography3x3 = Homography3x3T<double>;
+
     // Count number of inliers in a set of matches. Should also bring inliers to the front of the array.
     // matrix H: homography between coordinate systems.
     // match *m: matches to compute inlier/outlier.
@@ -70,6 +108,7 @@ namespace smk
     //          their match in the other image. Should also rearrange matches
     //          so that the inliers are first in the array. For drawing.
     int modelInliers(Matd const& H, Matches& m, float thresh);
+    int modelInliers(Homography3x3 const& H, Matches& m, float thresh);
 
     // Randomly shuffle matches for RANSAC.
     // Fisher-Yate
@@ -78,9 +117,19 @@ namespace smk
     void randomizeMatches(Matches& m);
 
     // Computes homography between two images given matching pixels.
+    // 4 matches use computeHomography4, more use a Hartley normalised DLT,
+    // the 2n x 9 system is reduced with Givens rotations to a 9x9 triangle and solved by a Jacobi SVD.
     // match *matches: matching points between images.
-    // returns: matrix representing homography H that maps image a to image b.
+    // returns: matrix representing homography H that maps image a to image b, empty when degenerate.
     Matd computeHomography(Matches const& matches);
+    Matd computeHomography(Match const* matches, int n);
+
+    // Closed form homography from exactly 4 matches, the RANSAC minimal sample.
+    // Composes the unit square to quad maps of both point sets, nothing is allocated.
+    // match *m: 4 matches.
+    // H - output: homography that maps the p points to the q points.
+    // returns: false when the points are degenerate (3 of them collinear).
+    bool computeHomography4(Match const* m, Homography3x3& H);
 
     // Perform RANdom SAmple Consensus to calculate homography for noisy matches.
     // match *m: set of matches.
@@ -97,6 +146,12 @@ namespace smk
     Vector2<float> projectPoint(Mat const& H, Vector2<float> const& p);
     Vector2<float> projectPoint(Matd const& H, Vector2<float> const& p);
 
+    // Apply a projective transformation to n points.
+    // The loop has no branches or calls so the compiler can vectorize it.
+    // point *in: points to project.
+    // point *out - output: projected points, may be the same array as in.
+    void projectPoints(Homography3x3 const& H, Vector2<float> const* in, Vector2<float>* out, int n);
+
     // Perform non-max supression on an image of feature responses.
     // image im: 1-channel image of feature responses.
     // int w: distance to look for larger responses.
@@ -108,6 +163,7 @@ namespace smk
     // [c d]
     float minEigenValue2x2(float a, float b, float c, float d);
     float minEigenValue2x2(Mat const& m);
+    float minEigenValue2x2(Mat2 const& m);
 
     // Calculate the structure matrix of an image.
     // image im: the input image.
@@ -134,4 +190,23 @@ namespace smk
     // returns: array of descriptors of the corners in the image.
     Descriptors harrisCornerDetector(Mat const& im, float sigma, float thresh, int nms, bool shi_tomasi = true);
 
+    // Harris cornerness of a single pixel, sobel gradients summed over a box window.
+    // image im: 1-channel input image.
+    // int x, y: pixel, must be at least r + 1 pixels away from the image border.
+    // int r: window radius, the window is (2r + 1) x (2r + 1).
+    // returns: det(S) - alpha * trace(S)^2, same formulation as harrisCornernessResponse.
+    float harrisScore(Mat const& im, int x, int y, int r);
+
+    // Perform FAST (features from accelerated segment test) corner detection.
+    // https://www.edwardrosten.com/work/rosten_2006_machine.pdf
+    // A pixel is a candidate if arc contiguous pixels on the 16 pixel circle of radius 3
+    // are all brighter than center + thresh or all darker than center - thresh.
+    // Candidates are scored with harrisScore, so only they pay for the gradients.
+    // image im: input image.
+    // float thresh: intensity threshold for the segment test. Typical: 0.05-0.15
+    // int nms: distance to look for local-maxes in the candidate scores.
+    // int arc: contiguous pixels for the segment test, 9 (FAST-9) or 12 (FAST-12).
+    // returns: array of descriptors of the corners in the image.
+    Descriptors fastCornerDetector(Mat const& im, float thresh, int nms, int arc = 9);
+
 } // namespace vs
@@ -1,7 +1,13 @@
 #include "Filter.hpp"
+#include "UnionFind.hpp"
 #include "../math/Mathematics.hpp"
+#include "../threading/Parallel.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
 
 namespace smk
 {
@@ -108,6 +114,11 @@ namespace smk
         //
         // faster convolve with 1d horizontal filter and then with the vertical filter
         //
+        if (sigma > recursive_gaussian_sigma) {
+            recursiveGaussian(src, dst, sigma);
+            return;
+        }
+
         Mat f = makeGaussianFilter1D(sigma);
         convolve(src, tmp, f);
         std::swap(f.w, f.h);
@@ -126,6 +137,282 @@ namespace smk
     }
 
 
+    // Young & van Vliet coefficients, w[n] = B x[n] + a1 w[n - 1] + a2 w[n - 2] + a3 w[n - 3]
+    struct RecursiveGaussianCoefficients {
+        double B, a1, a2, a3;
+
+        // Triggs & Sdika, Boundary conditions for Young - van Vliet recursive filtering, 2006
+        // The anti causal states past the end, y[N + i] - u = sum M[i][j] (w[N - 1 - j] - u)
+        // for an input that repeats its last value u forever.
+        double M[3][3];
+
+        explicit RecursiveGaussianCoefficients(float sigma) {
+            const double s = sigma;
+            const double q = (s >= 2.5) ? 0.98711 * s - 0.96330 : 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * s);
+            const double q2 = q * q;
+            const double q3 = q2 * q;
+
+            const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+            const double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+            const double b2 = -(1.4281 * q2 + 1.26661 * q3);
+            const double b3 = 0.422205 * q3;
+
+            a1 = b1 / b0;
+            a2 = b2 / b0;
+            a3 = b3 / b0;
+            B = 1.0 - (a1 + a2 + a3);
+
+            // M is linear in the causal states, run the tail of both filters once per basis state.
+            // The tail decays below double precision well inside 64 + 32q samples.
+            const int tail = 64 + int(32.0 * q);
+            std::vector<double> w(static_cast<size_t>(tail) + 3);
+            for (int j = 0; j != 3; ++j) {
+                double p1 = (j == 0) ? 1.0 : 0.0;
+                double p2 = (j == 1) ? 1.0 : 0.0;
+                double p3 = (j == 2) ? 1.0 : 0.0;
+                for (int n = 0; n != tail; ++n) {
+                    const double v = a1 * p1 + a2 * p2 + a3 * p3;
+                    w[size_t(n)] = v;
+                    p3 = p2; p2 = p1; p1 = v;
+                }
+
+                p1 = p2 = p3 = 0.0;
+                for (int n = tail - 1; n >= 0; --n) {
+                    const double v = B * w[size_t(n)] + a1 * p1 + a2 * p2 + a3 * p3;
+                    p3 = p2; p2 = p1; p1 = v;
+                }
+
+                M[0][j] = p1;
+                M[1][j] = p2;
+                M[2][j] = p3;
+            }
+        }
+
+        // anti causal initial states from the last 3 causal outputs w1 = w[N - 1], w2, w3 and the border value u
+        void border(double u, double w1, double w2, double w3, double& y1, double& y2, double& y3) const {
+            w1 -= u;
+            w2 -= u;
+            w3 -= u;
+            y1 = u + M[0][0] * w1 + M[0][1] * w2 + M[0][2] * w3;
+            y2 = u + M[1][0] * w1 + M[1][1] * w2 + M[1][2] * w3;
+            y3 = u + M[2][0] * w1 + M[2][1] * w2 + M[2][2] * w3;
+        }
+    };
+
+    void recursiveGaussian(Mat const& src, Mat& dst, float sigma) {
+        assert(sigma >= 0.5f);
+
+        const RecursiveGaussianCoefficients k(sigma);
+        const int w = src.w;
+        const int h = src.h;
+
+        dst.reshape(w, h, src.c);
+
+        // horizontal, one row at a time
+        parallelFor(0, src.c * h, [&](int begin, int end) {
+            std::vector<double> forward(static_cast<size_t>(w));
+
+            for (int row = begin; row != end; ++row) {
+                const float* s = src.data + size_t(row) * size_t(w);
+                float* d = dst.data + size_t(row) * size_t(w);
+                const double u = s[w - 1];
+
+                double p1 = s[0], p2 = s[0], p3 = s[0];
+                for (int x = 0; x != w; ++x) {
+                    const double v = k.B * s[x] + k.a1 * p1 + k.a2 * p2 + k.a3 * p3;
+                    forward[size_t(x)] = v;
+                    p3 = p2; p2 = p1; p1 = v;
+                }
+
+                k.border(u, p1, p2, p3, p1, p2, p3);
+                for (int x = w - 1; x >= 0; --x) {
+                    const double v = k.B * forward[size_t(x)] + k.a1 * p1 + k.a2 * p2 + k.a3 * p3;
+                    d[x] = float(v);
+                    p3 = p2; p2 = p1; p1 = v;
+                }
+            }
+        }, 16);
+
+        // vertical in place, whole rows at a time over a band of columns
+        for (int c = 0; c != dst.c; ++c) {
+            float* channel = dst.data + c * dst.channelSize();
+
+            parallelFor(0, w, [&](int begin, int end) {
+                const int band = end - begin;
+                std::vector<double> state(static_cast<size_t>(band * 4));
+                double* p1 = state.data();
+                double* p2 = p1 + band;
+                double* p3 = p2 + band;
+                double* u = p3 + band;
+
+                const float* first = channel + begin;
+                const float* last = channel + (h - 1) * w + begin;
+                for (int i = 0; i != band; ++i) {
+                    p1[i] = p2[i] = p3[i] = first[i];
+                    u[i] = last[i];
+                }
+
+                for (int y = 0; y != h; ++y) {
+                    float* d = channel + y * w + begin;
+                    for (int i = 0; i != band; ++i) {
+                        const double v = k.B * d[i] + k.a1 * p1[i] + k.a2 * p2[i] + k.a3 * p3[i];
+                        d[i] = float(v);
+                        p3[i] = p2[i]; p2[i] = p1[i]; p1[i] = v;
+                    }
+                }
+
+                for (int i = 0; i != band; ++i)
+                    k.border(u[i], p1[i], p2[i], p3[i], p1[i], p2[i], p3[i]);
+
+                for (int y = h - 1; y >= 0; --y) {
+                    float* d = channel + y * w + begin;
+                    for (int i = 0; i != band; ++i) {
+                        const double v = k.B * d[i] + k.a1 * p1[i] + k.a2 * p2[i] + k.a3 * p3[i];
+                        d[i] = float(v);
+                        p3[i] = p2[i]; p2[i] = p1[i]; p1[i] = v;
+                    }
+                }
+            }, 64);
+        }
+    }
+
+    Mat recursiveGaussian(Mat const& src, float sigma) {
+        Mat output;
+        recursiveGaussian(src, output, sigma);
+        return output;
+    }
+
+    void boxGaussian(Mat const& src, Mat& dst, Mat& tmp, float sigma, int passes) {
+        assert(sigma > 0.0f && passes > 0);
+
+        // n boxes of width wl or wu = wl + 2, with m of them wl, add up to variance sigma^2
+        const double s2 = double(sigma) * double(sigma);
+        const double ideal = std::sqrt(12.0 * s2 / passes + 1.0);
+        int wl = int(std::floor(ideal));
+        if (wl % 2 == 0)
+            wl--;
+        wl = maximum(wl, 1);
+        const int wu = wl + 2;
+        const int m = int(std::lround((12.0 * s2 - passes * wl * wl - 4.0 * passes * wl - 3.0 * passes) / (-4.0 * wl - 4.0)));
+
+        boxfilter(src, dst, tmp, m > 0 ? wl : wu);
+        for (int i = 1; i < passes; ++i)
+            boxfilter(dst, dst, tmp, i < m ? wl : wu);
+    }
+
+    Mat boxGaussian(Mat const& src, float sigma, int passes) {
+        Mat output, tmp;
+        boxGaussian(src, output, tmp, sigma, passes);
+        return output;
+    }
+
+
+    void boxfilter(Mat const& src, Mat& dst, Mat& tmp, int size) {
+        assert(size > 0);
+
+        const int w = src.w;
+        const int h = src.h;
+        const int r = size / 2;
+
+        // ring of the last r + 1 horizontal rows, plus one row for the horizontal input
+        const int ring = minimum(r + 1, h);
+        const int scratch = (ring + 1) * w;
+        const int chunks = parallelChunks(0, src.c);
+
+        dst.reshape(w, h, src.c);
+        tmp.reshape(scratch, chunks, 1);
+
+        // 1 / number of window pixels inside the image, for each column
+        std::vector<double> inv_x(static_cast<size_t>(w));
+        for (int x = 0; x != w; ++x)
+            inv_x[size_t(x)] = 1.0 / double(minimum(x + r, w - 1) - maximum(x - r, 0) + 1);
+
+        // columns where the window doesn't need clipping on the left / right
+        const int inner_begin = minimum(r + 1, w);
+        const int inner_end = maximum(inner_begin, w - r);
+
+        parallelForChunks(0, src.c, [&](int chunk, int begin, int end) {
+            float* row = tmp.data + chunk * scratch;
+            float* rows = row + w;
+            std::vector<double> column(static_cast<size_t>(w));
+
+            for (int k = begin; k != end; ++k) {
+                const float* s = src.data + k * src.channelSize();
+                float* d = dst.data + k * dst.channelSize();
+
+                // horizontal pass, row means written to dst
+                for (int y = 0; y != h; ++y) {
+                    memcpy(row, s + y * w, sizeof(float) * size_t(w));
+                    float* o = d + y * w;
+
+                    double sum = 0.0;
+                    for (int x = 0; x < minimum(r, w); ++x)
+                        sum += row[x];
+
+                    int x = 0;
+                    for (; x < inner_begin; ++x) {
+                        if (x + r < w)
+                            sum += row[x + r];
+                        o[x] = float(sum * inv_x[size_t(x)]);
+                    }
+
+                    for (; x < inner_end; ++x) {
+                        sum += double(row[x + r]) - double(row[x - r - 1]);
+                        o[x] = float(sum * inv_x[size_t(x)]);
+                    }
+
+                    for (; x < w; ++x) {
+                        if (x + r < w)
+                            sum += row[x + r];
+                        sum -= row[x - r - 1];
+                        o[x] = float(sum * inv_x[size_t(x)]);
+                    }
+                }
+
+                // vertical pass in place, rows still needed for the subtraction are kept in the ring
+                std::fill(column.begin(), column.end(), 0.0);
+                for (int y = 0; y < minimum(r, h); ++y) {
+                    const float* i = d + y * w;
+                    for (int x = 0; x != w; ++x)
+                        column[size_t(x)] += i[x];
+                }
+
+                for (int y = 0; y != h; ++y) {
+                    if (y + r < h) {
+                        const float* i = d + (y + r) * w;
+                        for (int x = 0; x != w; ++x)
+                            column[size_t(x)] += i[x];
+                    }
+
+                    if (y - r - 1 >= 0) {
+                        const float* i = rows + ((y - r - 1) % ring) * w;
+                        for (int x = 0; x != w; ++x)
+                            column[size_t(x)] -= i[x];
+                    }
+
+                    float* o = d + y * w;
+                    memcpy(rows + (y % ring) * w, o, sizeof(float) * size_t(w));
+
+                    const double inv = 1.0 / double(minimum(y + r, h - 1) - maximum(y - r, 0) + 1);
+                    for (int x = 0; x != w; ++x)
+                        o[x] = float(column[size_t(x)] * inv);
+                }
+            }
+        });
+    }
+
+    void boxfilter(Mat const& src, Mat& dst, int size) {
+        Mat tmp;
+        boxfilter(src, dst, tmp, size);
+    }
+
+    Mat boxfilter(Mat const& src, int size) {
+        Mat output;
+        boxfilter(src, output, size);
+        return output;
+    }
+
+
     Mat makeSobelFilter(bool horizontal)
     {
         Mat filter(3, 3, 1);
@@ -185,25 +472,124 @@ namespace smk
         convolve(src, gy, makeSobelFilter(false), false);
     }
 
-    void gradientMagnitudeAngle(const Mat &src, Mat &mag, Mat &theta)
-    {
-        Mat gx, gy;
+    // Fused 3x3 sobel, rows run in parallel.
+    // Each chunk keeps the horizontal [-1 0 1] and [1 2 1] passes of the last 3 source rows in a ring,
+    // so a source row is read once per chunk. The arithmetic is the same as gradientSingleChannel.
+    // row(y, gx, gy) is called with the gradients of every output row.
+    template<typename RowFunction>
+    static void sobelRows(Mat const& src, RowFunction const& row) {
+        const int w = src.w;
+        const int h = src.h;
+        const int last_x = w - 1;
+        const int last_y = h - 1;
+        const size_t stride = size_t(w);
+
+        parallelFor(0, h, [&](int begin, int end) {
+            // per channel and slot a diff row and a smooth row, then gx and gy
+            std::vector<float> scratch(stride * size_t(6 * src.c + 2));
+            float* gx = scratch.data() + stride * size_t(6 * src.c);
+            float* gy = gx + stride;
+            int held[3] = { -1, -1, -1 };
+
+            auto horizontal = [&](int sy) {
+                const int slot = sy % 3;
+                if (held[slot] == sy)
+                    return;
+                held[slot] = sy;
+
+                for (int k = 0; k != src.c; ++k) {
+                    const float* r = src.data + k * src.channelSize() + sy * w;
+                    float* d = scratch.data() + stride * size_t((k * 3 + slot) * 2);
+                    float* m = d + stride;
+
+                    for (int x = 0; x != w; ++x) {
+                        const float l = r[x > 0 ? x - 1 : 0];
+                        const float c = r[x];
+                        const float rr = r[x < last_x ? x + 1 : last_x];
+                        d[x] = rr - l;
+                        m[x] = (l + 2.0f * c) + rr;
+                    }
+                }
+            };
+
+            for (int y = begin; y != end; ++y) {
+                const int y0 = y > 0 ? y - 1 : 0;
+                const int y2 = y < last_y ? y + 1 : last_y;
+                horizontal(y0);
+                horizontal(y);
+                horizontal(y2);
+
+                for (int k = 0; k != src.c; ++k) {
+                    const float* d0 = scratch.data() + stride * size_t((k * 3 + y0 % 3) * 2);
+                    const float* d1 = scratch.data() + stride * size_t((k * 3 + y % 3) * 2);
+                    const float* d2 = scratch.data() + stride * size_t((k * 3 + y2 % 3) * 2);
+                    const float* m0 = d0 + stride;
+                    const float* m2 = d2 + stride;
+
+                    if (k == 0) {
+                        for (int x = 0; x != w; ++x) {
+                            gx[x] = (d0[x] + 2.0f * d1[x]) + d2[x];
+                            gy[x] = m2[x] - m0[x];
+                        }
+                    } else {
+                        for (int x = 0; x != w; ++x) {
+                            gx[x] += (d0[x] + 2.0f * d1[x]) + d2[x];
+                            gy[x] += m2[x] - m0[x];
+                        }
+                    }
+                }
 
-        if (src.c == 1) {
-            gradientSingleChannel(src, gx, gy);
-        } else {
-            gradient(src, gx, gy);
-        }
+                row(y, gx, gy);
+            }
+        }, 16);
+    }
 
+    void gradientMagnitudeAngle(const Mat &src, Mat &mag, Mat &theta, GradientAngle mode)
+    {
         mag.reshape(src.w, src.h, 1);
         theta.reshape(src.w, src.h, 1);
 
-        for (int i = 0; i != gx.w * gx.h; ++i)
-        {
-            float gx_v = gx.data[i];
-            float gy_v = gy.data[i];
-            mag.data[i] = std ::hypotf(gx_v, gy_v);
-            theta.data[i] = atan2(gy_v, gx_v);
+        const int w = src.w;
+
+        if (mode == GradientAngle::Exact) {
+            sobelRows(src, [&](int y, const float* gx, const float* gy) {
+                float* m = mag.data + y * w;
+                float* t = theta.data + y * w;
+                for (int x = 0; x != w; ++x) {
+                    m[x] = std::hypotf(gx[x], gy[x]);
+                    t[x] = atan2(gy[x], gx[x]);
+                }
+            });
+        } else if (mode == GradientAngle::Fast) {
+            sobelRows(src, [&](int y, const float* gx, const float* gy) {
+                float* m = mag.data + y * w;
+                float* t = theta.data + y * w;
+                for (int x = 0; x != w; ++x) {
+                    m[x] = sqrtf(gx[x] * gx[x] + gy[x] * gy[x]);
+                    t[x] = fastAtan2(gy[x], gx[x]);
+                }
+            });
+        } else {
+            // fold the direction into [0, 180) and compare against tan(22.5) and tan(67.5), no atan
+            const float tan22 = 0.41421356f;
+            const float tan67 = 2.41421356f;
+            sobelRows(src, [&](int y, const float* gx, const float* gy) {
+                float* m = mag.data + y * w;
+                float* t = theta.data + y * w;
+                for (int x = 0; x != w; ++x) {
+                    const float vx = gy[x] < 0.0f ? -gx[x] : gx[x];
+                    const float vy = absolute(gy[x]);
+                    const float ax = absolute(vx);
+
+                    m[x] = sqrtf(gx[x] * gx[x] + gy[x] * gy[x]);
+                    if (vy <= tan22 * ax)
+                        t[x] = 0.0f;
+                    else if (vy > tan67 * ax)
+                        t[x] = 2.0f;
+                    else
+                        t[x] = vx > 0.0f ? 1.0f : 3.0f;
+                }
+            });
         }
     }
 
@@ -264,6 +650,11 @@ namespace smk
         return dst;
     }
 
+    // joins two candidates, a set is strong when any of its pixels is
+    static inline void cannyUnion(std::vector<int>& parent, std::vector<unsigned char>& strong, int a, int b) {
+        unionFindJoin(parent.data(), a, b, [&](int root, int absorbed) { strong[size_t(root)] |= strong[size_t(absorbed)]; });
+    }
+
     //http://www.rosettacode.org/wiki/Canny_edge_detector
     //http://justin-liang.com/tutorials/canny/
     void canny(const Mat &src, Mat &dst, const float tmin, const float tmax, const float sigma)
@@ -273,88 +664,90 @@ namespace smk
 
         smoothImage(src, dst, sigma);
 
-        Mat mag, angle;
-        gradientMagnitudeAngle(dst, mag, angle);
-
-        // Non-maximum suppression, straightforward implementation.
-        const float pi = piAngle<float>();
-        Mat nms;
-        nms.reshape(src.w, src.h, 1);
-        for (int x = 1; x < src.w - 1; x++)
-            for (int y = 1; y < src.h - 1; y++) {
-                const int c = x + src.w * y;
-                const int nn = c - src.w;
-                const int ss = c + src.w;
-                const int ww = c + 1;
-                const int ee = c - 1;
-                const int nw = nn + 1;
-                const int ne = nn - 1;
-                const int sw = ss + 1;
-                const int se = ss - 1;
-
-                const float dir = (fmodf(angle.data[c] + pi, pi) / pi) * 8;
-
-                if (
-                        ((dir <= 1 || dir > 7) && mag.data[c] > mag.data[ee] &&
-                         mag.data[c] > mag.data[ww]) || // 0 deg
-
-                        ((dir > 1 && dir <= 3) && mag.data[c] > mag.data[nw] &&
-                         mag.data[c] > mag.data[se]) || // 45 deg
-
-                        ((dir > 3 && dir <= 5) && mag.data[c] > mag.data[nn] &&
-                         mag.data[c] > mag.data[ss]) || // 90 deg
-
-                        ((dir > 5 && dir <= 7) && mag.data[c] > mag.data[ne] &&
-                         mag.data[c] > mag.data[sw]) // 135 deg
-                        )
-                    nms.data[c] = mag.data[c];
-                else
-                    nms.data[c] = 0;
-            }
+        Mat mag, sector;
+        gradientMagnitudeAngle(dst, mag, sector, GradientAngle::Sector);
 
-        // Reuse memory, used as a stack. nx*ny/2 elements should be enough.
-        Mat edges = mag;
-        edges.zero();
+        const int w = src.w;
+        const int h = src.h;
         dst.zero();
+        if (w < 3 || h < 3)
+            return;
+
+        // Non-maximum suppression on the precomputed sectors, the 2 neighbours to compare per sector
+        // (0 deg, 45 deg, 90 deg, 135 deg).
+        // Pixels that survive with mag >= tmin are edge candidates, candidates with mag >= tmax are strong.
+        const int before[4] = { -1, -w + 1, -w, -w - 1 };
+        const int after[4] = { 1, w - 1, w, w + 1 };
+
+        std::vector<int> parent(size_t(w) * size_t(h), -1);
+        std::vector<unsigned char> strong(parent.size(), 0);
+
+        // Hysteresis as connected components: a candidate is an edge if its 8 connected
+        // candidate component holds a strong pixel.
+        // Bands of rows are labelled in parallel, the band seams are merged afterwards.
+        const int bands = parallelChunks(1, h - 1, 64);
+        std::vector<int> seams(size_t(bands), 0);
+
+        parallelForChunks(1, h - 1, [&](int chunk, int begin, int end) {
+            seams[size_t(chunk)] = begin;
+
+            for (int y = begin; y != end; ++y) {
+                const float* m = mag.data + y * w;
+                const float* t = sector.data + y * w;
+                int* p = parent.data() + y * w;
+                unsigned char* st = strong.data() + y * w;
+
+                for (int x = 1; x < w - 1; ++x) {
+                    const int k = int(t[x]);
+                    const float v = (m[x] > m[x + before[k]] && m[x] > m[x + after[k]]) ? m[x] : 0.0f;
+                    p[x] = (v >= tmin) ? y * w + x : -1;
+                    st[x] = (v >= tmin && v >= tmax) ? 1 : 0;
+                }
 
-        // Tracing edges with hysteresis . Non-recursive implementation.
-        const float max_brightness = 1.0f;
-        size_t c = 1;
-        for (int y = 1; y < dst.h - 1; y++)
-            for (int x = 1; x < dst.w - 1; x++)
-            {
-                if (nms.data[c] >= tmax && equivalent(dst.data[c], 0.0f))
-                { // trace edges
-
-                    dst.data[c] = max_brightness;
-                    int nedges = 1;
-                    edges.data[0] = c;
-
-                    do
-                    {
-                        nedges--;
-                        const int t = int(edges.data[nedges]);
-
-                        int nbs[8];          // neighbours
-                        nbs[0] = t - src.w;  // nn
-                        nbs[1] = t + src.w;  // ss
-                        nbs[2] = t + 1;      // ww
-                        nbs[3] = t - 1;      // ee
-                        nbs[4] = nbs[0] + 1; // nw
-                        nbs[5] = nbs[0] - 1; // ne
-                        nbs[6] = nbs[1] + 1; // sw
-                        nbs[7] = nbs[1] - 1; // se
-
-                        for (int k = 0; k < 8; k++)
-                            if (nms.data[nbs[k]] >= tmin && equivalent(dst.data[nbs[k]], 0.0f)) {
-                                dst.data[nbs[k]] = max_brightness;
-                                edges.data[nedges] = nbs[k];
-                                nedges++;
-                            }
-                    } while (nedges > 0);
+                // join with the already labelled neighbours, W, NW, N, NE
+                for (int x = 1; x < w - 1; ++x) {
+                    if (p[x] < 0)
+                        continue;
+
+                    const int i = y * w + x;
+                    if (p[x - 1] >= 0)
+                        cannyUnion(parent, strong, i, i - 1);
+
+                    if (y == begin)
+                        continue;
+
+                    for (int n = i - w - 1; n <= i - w + 1; ++n)
+                        if (parent[size_t(n)] >= 0)
+                            cannyUnion(parent, strong, i, n);
                 }
-                c++;
             }
+        }, 64);
+
+        // merge the first row of every band with the last row of the band above
+        for (int b = 1; b < bands; ++b) {
+            const int y = seams[size_t(b)];
+            for (int x = 1; x < w - 1; ++x) {
+                const int i = y * w + x;
+                if (parent[size_t(i)] < 0)
+                    continue;
+
+                for (int n = i - w - 1; n <= i - w + 1; ++n)
+                    if (parent[size_t(n)] >= 0)
+                        cannyUnion(parent, strong, i, n);
+            }
+        }
+
+        const float max_brightness = 1.0f;
+        parallelFor(1, h - 1, [&](int begin, int end) {
+            for (int y = begin; y != end; ++y) {
+                float* d = dst.data + y * w;
+                const int* p = parent.data() + y * w;
+
+                for (int x = 1; x < w - 1; ++x)
+                    if (p[x] >= 0 && strong[size_t(unionFindRootConst(parent.data(), y * w + x))])
+                        d[x] = max_brightness;
+            }
+        }, 64);
     }
 
 
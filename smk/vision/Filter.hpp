@@ -11,15 +11,53 @@ namespace smk
     Mat makeBoxFilter(int w);
     Mat makeGaussianFilter(float sigma);
     Mat makeGaussianFilter1D(float sigma);
+
+    // gaussian smoothing, separable convolution with makeGaussianFilter1D
+    // above recursive_gaussian_sigma it switches to recursiveGaussian, the kernel gets too wide
+    const float recursive_gaussian_sigma = 4.0f;
     void smoothImage(Mat const& src, Mat& dst, Mat& tmp, float sigma);
     void smoothImage(Mat const& src, Mat& dst, float sigma);
     Mat smoothImage(Mat const& src, float sigma);
 
+    // Recursive (IIR) gaussian, Young & van Vliet, Recursive implementation of the Gaussian filter, 1995
+    // A causal and an anti causal 3rd order filter per direction, the cost doesn't depend on sigma.
+    // Accurate for sigma >= 1, borders are extended with the edge pixel. src and dst can be the same mat.
+    void recursiveGaussian(Mat const& src, Mat& dst, float sigma);
+    Mat recursiveGaussian(Mat const& src, float sigma);
+
+    // Gaussian approximated by repeated box filters (Kovesi, Fast almost-Gaussian filtering)
+    // The box sizes are chosen so the passes add up to the variance of sigma. 3 passes are already close.
+    // tmp - scratch rows, reused across calls
+    void boxGaussian(Mat const& src, Mat& dst, Mat& tmp, float sigma, int passes = 3);
+    Mat boxGaussian(Mat const& src, float sigma, int passes = 3);
+
+    // box filter with running sums, a horizontal and a vertical pass, O(1) per pixel for any size.
+    // Each pixel is the mean of the window pixels inside the image, same as boxfilterIntegralImage.
+    // int size: window size, the radius is size / 2
+    // tmp - scratch rows, reused across calls
+    // src and dst can be the same mat, the filter runs in place
+    void boxfilter(Mat const& src, Mat& dst, Mat& tmp, int size);
+    void boxfilter(Mat const& src, Mat& dst, int size);
+    Mat boxfilter(Mat const& src, int size);
+
     // sobel gradient
     Mat makeSobelFilter(bool horizontal);
     void gradientSingleChannel(Mat const& src, Mat& gx, Mat& gy);
     void gradient(Mat const& src, Mat& gx, Mat& gy);
-    void gradientMagnitudeAngle(Mat const& src, Mat& mag, Mat& theta);
+
+    // what gradientMagnitudeAngle writes in theta
+    enum class GradientAngle {
+        Exact,  // atan2(gy, gx) in radians, magnitude with hypot
+        Fast,   // fastAtan2, magnitude with sqrt
+        Sector  // direction modulo 180 quantised to the 4 canny sectors, magnitude with sqrt
+                // 0: [0, 22.5] or (157.5, 180), 1: (22.5, 67.5], 2: (67.5, 112.5], 3: (112.5, 157.5]
+    };
+
+    // Sobel magnitude and direction in a single fused pass, borders are clamped.
+    // Multi channel images sum the gradients of all channels, same as gradient.
+    // image src: input image.
+    // mag, theta - output: 1 channel images.
+    void gradientMagnitudeAngle(Mat const& src, Mat& mag, Mat& theta, GradientAngle mode = GradientAngle::Exact);
 
     // convolution
     void convolve(Mat const& src, Mat& dst, Mat const& filter, bool const preserve = true);
@@ -0,0 +1,330 @@
+#pragma once
+
+#include "Mat.hpp"
+
+#include <cassert>
+#include <cmath>
+
+namespace smk
+{
+    //
+    // Small matrices with compile time dimensions and stack storage, for per pixel math.
+    // Row major like MatT, m(row, col). Loops run over constexpr bounds so the compiler unrolls them.
+    // Inverse, determinant and eigenvalues are closed form for the 2x2, 3x3 (and 4x4 inverse / determinant) cases.
+    //
+    template <typename T, int R, int C>
+    struct FixedMat
+    {
+        static constexpr int rows = R;
+        static constexpr int cols = C;
+        static constexpr int elements = R * C;
+
+        T data[R * C] = {};
+
+        constexpr T& operator()(int row, int col) { return data[row * C + col]; }
+        constexpr T operator()(int row, int col) const { return data[row * C + col]; }
+
+        constexpr T& operator[](int i) { return data[i]; }
+        constexpr T operator[](int i) const { return data[i]; }
+
+        static constexpr FixedMat zero() { return FixedMat(); }
+
+        static constexpr FixedMat identity()
+        {
+            static_assert(R == C, "identity of a non square matrix");
+            FixedMat m;
+            for (int i = 0; i != R; ++i)
+                m(i, i) = T(1);
+            return m;
+        }
+
+        static FixedMat from(MatT<T> const& m)
+        {
+            assert(m.w == C && m.h == R && m.c == 1);
+            FixedMat f;
+            for (int i = 0; i != R * C; ++i)
+                f.data[i] = m.data[i];
+            return f;
+        }
+
+        MatT<T> mat() const
+        {
+            MatT<T> m(C, R);
+            for (int i = 0; i != R * C; ++i)
+                m.data[i] = data[i];
+            return m;
+        }
+    };
+
+    template <typename T> using FixedMat2 = FixedMat<T, 2, 2>;
+    template <typename T> using FixedMat3 = FixedMat<T, 3, 3>;
+    template <typename T> using FixedMat4 = FixedMat<T, 4, 4>;
+    template <typename T, int N> using FixedVec = FixedMat<T, N, 1>;
+
+    using Mat2 = FixedMat2<float>;
+    using Mat3 = FixedMat3<float>;
+    using Mat4 = FixedMat4<float>;
+    using Mat2d = FixedMat2<double>;
+    using Mat3d = FixedMat3<double>;
+    using Mat4d = FixedMat4<double>;
+
+    template <typename T, int R, int K, int C>
+    constexpr FixedMat<T, R, C> operator*(FixedMat<T, R, K> const& a, FixedMat<T, K, C> const& b)
+    {
+        FixedMat<T, R, C> p;
+        for (int i = 0; i != R; ++i)
+            for (int k = 0; k != K; ++k)
+                for (int j = 0; j != C; ++j)
+                    p(i, j) += a(i, k) * b(k, j);
+        return p;
+    }
+
+    template <typename T, int R, int C>
+    constexpr FixedMat<T, R, C> operator*(FixedMat<T, R, C> const& a, T s)
+    {
+        FixedMat<T, R, C> p;
+        for (int i = 0; i != R * C; ++i)
+            p.data[i] = a.data[i] * s;
+        return p;
+    }
+
+    template <typename T, int R, int C>
+    constexpr FixedMat<T, R, C> operator+(FixedMat<T, R, C> const& a, FixedMat<T, R, C> const& b)
+    {
+        FixedMat<T, R, C> p;
+        for (int i = 0; i != R * C; ++i)
+            p.data[i] = a.data[i] + b.data[i];
+        return p;
+    }
+
+    template <typename T, int R, int C>
+    constexpr FixedMat<T, R, C> operator-(FixedMat<T, R, C> const& a, FixedMat<T, R, C> const& b)
+    {
+        FixedMat<T, R, C> p;
+        for (int i = 0; i != R * C; ++i)
+            p.data[i] = a.data[i] - b.data[i];
+        return p;
+    }
+
+    template <typename T, int R, int C>
+    constexpr FixedMat<T, C, R> transpose(FixedMat<T, R, C> const& a)
+    {
+        FixedMat<T, C, R> t;
+        for (int i = 0; i != R; ++i)
+            for (int j = 0; j != C; ++j)
+                t(j, i) = a(i, j);
+        return t;
+    }
+
+    template <typename T, int N>
+    constexpr T trace(FixedMat<T, N, N> const& a)
+    {
+        T t = T(0);
+        for (int i = 0; i != N; ++i)
+            t += a(i, i);
+        return t;
+    }
+
+    //
+    // determinant
+    //
+    template <typename T>
+    constexpr T determinant(FixedMat<T, 2, 2> const& m)
+    {
+        return m[0] * m[3] - m[1] * m[2];
+    }
+
+    template <typename T>
+    constexpr T determinant(FixedMat<T, 3, 3> const& m)
+    {
+        return m[0] * (m[4] * m[8] - m[5] * m[7]) -
+               m[1] * (m[3] * m[8] - m[5] * m[6]) +
+               m[2] * (m[3] * m[7] - m[4] * m[6]);
+    }
+
+    template <typename T>
+    constexpr T determinant(FixedMat<T, 4, 4> const& m)
+    {
+        // 2x2 minors of the two top and the two bottom rows (Laplace expansion)
+        const T s0 = m[0] * m[5] - m[4] * m[1];
+        const T s1 = m[0] * m[6] - m[4] * m[2];
+        const T s2 = m[0] * m[7] - m[4] * m[3];
+        const T s3 = m[1] * m[6] - m[5] * m[2];
+        const T s4 = m[1] * m[7] - m[5] * m[3];
+        const T s5 = m[2] * m[7] - m[6] * m[3];
+
+        const T c5 = m[10] * m[15] - m[14] * m[11];
+        const T c4 = m[9] * m[15] - m[13] * m[11];
+        const T c3 = m[9] * m[14] - m[13] * m[10];
+        const T c2 = m[8] * m[15] - m[12] * m[11];
+        const T c1 = m[8] * m[14] - m[12] * m[10];
+        const T c0 = m[8] * m[13] - m[12] * m[9];
+
+        return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    }
+
+    //
+    // inverse, returns false (and leaves out untouched) when the matrix is singular
+    //
+    template <typename T>
+    bool inverse(FixedMat<T, 2, 2> const& m, FixedMat<T, 2, 2>& out)
+    {
+        const T det = determinant(m);
+        if (det == T(0))
+            return false;
+
+        const T inv = T(1) / det;
+        out[0] = m[3] * inv;
+        out[1] = -m[1] * inv;
+        out[2] = -m[2] * inv;
+        out[3] = m[0] * inv;
+        return true;
+    }
+
+    template <typename T>
+    bool inverse(FixedMat<T, 3, 3> const& m, FixedMat<T, 3, 3>& out)
+    {
+        const T c0 = m[4] * m[8] - m[5] * m[7];
+        const T c1 = m[5] * m[6] - m[3] * m[8];
+        const T c2 = m[3] * m[7] - m[4] * m[6];
+
+        const T det = m[0] * c0 + m[1] * c1 + m[2] * c2;
+        if (det == T(0))
+            return false;
+
+        const T inv = T(1) / det;
+        out[0] = c0 * inv;
+        out[1] = (m[2] * m[7] - m[1] * m[8]) * inv;
+        out[2] = (m[1] * m[5] - m[2] * m[4]) * inv;
+        out[3] = c1 * inv;
+        out[4] = (m[0] * m[8] - m[2] * m[6]) * inv;
+        out[5] = (m[2] * m[3] - m[0] * m[5]) * inv;
+        out[6] = c2 * inv;
+        out[7] = (m[1] * m[6] - m[0] * m[7]) * inv;
+        out[8] = (m[0] * m[4] - m[1] * m[3]) * inv;
+        return true;
+    }
+
+    template <typename T>
+    bool inverse(FixedMat<T, 4, 4> const& m, FixedMat<T, 4, 4>& out)
+    {
+        const T s0 = m[0] * m[5] - m[4] * m[1];
+        const T s1 = m[0] * m[6] - m[4] * m[2];
+        const T s2 = m[0] * m[7] - m[4] * m[3];
+        const T s3 = m[1] * m[6] - m[5] * m[2];
+        const T s4 = m[1] * m[7] - m[5] * m[3];
+        const T s5 = m[2] * m[7] - m[6] * m[3];
+
+        const T c5 = m[10] * m[15] - m[14] * m[11];
+        const T c4 = m[9] * m[15] - m[13] * m[11];
+        const T c3 = m[9] * m[14] - m[13] * m[10];
+        const T c2 = m[8] * m[15] - m[12] * m[11];
+        const T c1 = m[8] * m[14] - m[12] * m[10];
+        const T c0 = m[8] * m[13] - m[12] * m[9];
+
+        const T det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+        if (det == T(0))
+            return false;
+
+        const T inv = T(1) / det;
+        out[0] = (m[5] * c5 - m[6] * c4 + m[7] * c3) * inv;
+        out[1] = (-m[1] * c5 + m[2] * c4 - m[3] * c3) * inv;
+        out[2] = (m[13] * s5 - m[14] * s4 + m[15] * s3) * inv;
+        out[3] = (-m[9] * s5 + m[10] * s4 - m[11] * s3) * inv;
+
+        out[4] = (-m[4] * c5 + m[6] * c2 - m[7] * c1) * inv;
+        out[5] = (m[0] * c5 - m[2] * c2 + m[3] * c1) * inv;
+        out[6] = (-m[12] * s5 + m[14] * s2 - m[15] * s1) * inv;
+        out[7] = (m[8] * s5 - m[10] * s2 + m[11] * s1) * inv;
+
+        out[8] = (m[4] * c4 - m[5] * c2 + m[7] * c0) * inv;
+        out[9] = (-m[0] * c4 + m[1] * c2 - m[3] * c0) * inv;
+        out[10] = (m[12] * s4 - m[13] * s2 + m[15] * s0) * inv;
+        out[11] = (-m[8] * s4 + m[9] * s2 - m[11] * s0) * inv;
+
+        out[12] = (-m[4] * c3 + m[5] * c1 - m[6] * c0) * inv;
+        out[13] = (m[0] * c3 - m[1] * c1 + m[2] * c0) * inv;
+        out[14] = (-m[12] * s3 + m[13] * s1 - m[14] * s0) * inv;
+        out[15] = (m[8] * s3 - m[9] * s1 + m[10] * s0) * inv;
+        return true;
+    }
+
+    // Solves the 2x2 system A x = b with Cramer's rule.
+    // returns: false when A is singular.
+    template <typename T>
+    bool solve(FixedMat<T, 2, 2> const& a, FixedMat<T, 2, 1> const& b, FixedMat<T, 2, 1>& x)
+    {
+        const T det = determinant(a);
+        if (det == T(0))
+            return false;
+
+        x[0] = (b[0] * a[3] - a[1] * b[1]) / det;
+        x[1] = (a[0] * b[1] - a[2] * b[0]) / det;
+        return true;
+    }
+
+    //
+    // eigenvalues
+    //
+
+    // Eigenvalues of a 2x2 matrix with real eigenvalues (symmetric matrices, structure tensors), ev0 <= ev1.
+    // Complex eigenvalues give NaN.
+    template <typename T>
+    void eigenValues(FixedMat<T, 2, 2> const& m, T& ev0, T& ev1)
+    {
+        const T half_trace = (m[0] + m[3]) / T(2);
+        const T common = std::sqrt(half_trace * half_trace - determinant(m));
+        ev0 = half_trace - common;
+        ev1 = half_trace + common;
+    }
+
+    template <typename T>
+    T minEigenValue(FixedMat<T, 2, 2> const& m)
+    {
+        T ev0, ev1;
+        eigenValues(m, ev0, ev1);
+        return ev0;
+    }
+
+    // Eigenvalues of a symmetric 3x3 matrix, ev0 <= ev1 <= ev2.
+    // Trigonometric closed form, Smith 1961, only the upper triangle is read.
+    template <typename T>
+    void eigenValuesSymmetric(FixedMat<T, 3, 3> const& m, T& ev0, T& ev1, T& ev2)
+    {
+        const T p1 = m(0, 1) * m(0, 1) + m(0, 2) * m(0, 2) + m(1, 2) * m(1, 2);
+        if (p1 == T(0))
+        {
+            ev0 = m(0, 0);
+            ev1 = m(1, 1);
+            ev2 = m(2, 2);
+            if (ev0 > ev1) std::swap(ev0, ev1);
+            if (ev1 > ev2) std::swap(ev1, ev2);
+            if (ev0 > ev1) std::swap(ev0, ev1);
+            return;
+        }
+
+        const T q = trace(m) / T(3);
+        const T d0 = m(0, 0) - q;
+        const T d1 = m(1, 1) - q;
+        const T d2 = m(2, 2) - q;
+        const T p2 = d0 * d0 + d1 * d1 + d2 * d2 + T(2) * p1;
+        const T p = std::sqrt(p2 / T(6));
+
+        // B = (A - q I) / p, r = det(B) / 2
+        FixedMat<T, 3, 3> b = m;
+        b(0, 0) = d0;
+        b(1, 1) = d1;
+        b(2, 2) = d2;
+        b(1, 0) = m(0, 1);
+        b(2, 0) = m(0, 2);
+        b(2, 1) = m(1, 2);
+        const T r = determinant(b) / (T(2) * p * p * p);
+
+        const T pi = T(3.14159265358979323846);
+        const T phi = (r <= T(-1)) ? pi / T(3) : (r >= T(1)) ? T(0) : std::acos(r) / T(3);
+
+        ev2 = q + T(2) * p * std::cos(phi);
+        ev0 = q + T(2) * p * std::cos(phi + T(2) * pi / T(3));
+        ev1 = T(3) * q - ev0 - ev2;
+    }
+}
@@ -0,0 +1,244 @@
+#include "Histogram.hpp"
+#include "../math/Mathematics.hpp"
+#include "../threading/Parallel.hpp"
+
+#include <cassert>
+
+namespace smk
+{
+    // pixels per thread, smaller images are counted on the calling thread
+    static const int histogram_grain = 1 << 16;
+
+    Histogram::Histogram(int bins, float min, float max)
+        :m_bins(bins), m_min(min), m_max(max), m_scale(float(bins) / (max - min)), m_channels(0)
+    {
+        assert(bins > 0 && max > min);
+    }
+
+    int Histogram::bin(float value) const {
+        // clamped as a float, converting an out of range float to int is undefined
+        const float position = (value - m_min) * m_scale;
+        if (!(position >= 0.0f)) // below the range or NaN
+            return 0;
+        if (position >= float(m_bins))
+            return m_bins - 1;
+        return minimum(int(position), m_bins - 1);
+    }
+
+    float Histogram::binValue(int bin) const {
+        return m_min + float(bin) / m_scale;
+    }
+
+    void Histogram::compute(Mat const& im) {
+        m_channels = im.c;
+        m_counts.assign(size_t(m_bins) * size_t(m_channels), 0);
+
+        const int size = im.channelSize();
+        const int chunks = parallelChunks(0, size, histogram_grain);
+        std::vector<long long> partial(static_cast<size_t>(chunks) * size_t(m_bins));
+
+        for (int c = 0; c != im.c; ++c) {
+            const float* data = im.data + c * size;
+            std::fill(partial.begin(), partial.end(), 0);
+
+            parallelForChunks(0, size, [&](int chunk, int begin, int end) {
+                long long* h = partial.data() + size_t(chunk) * size_t(m_bins);
+                for (int i = begin; i != end; ++i)
+                    h[bin(data[i])]++;
+            }, histogram_grain);
+
+            long long* counts = m_counts.data() + size_t(c) * size_t(m_bins);
+            for (int chunk = 0; chunk != chunks; ++chunk) {
+                const long long* h = partial.data() + size_t(chunk) * size_t(m_bins);
+                for (int b = 0; b != m_bins; ++b)
+                    counts[b] += h[b];
+            }
+        }
+    }
+
+    void Histogram::compute(Mat const& im, int c, int x, int y, int w, int h) {
+        assert(c >= 0 && c < im.c);
+        assert(x >= 0 && y >= 0 && x + w <= im.w && y + h <= im.h);
+
+        m_channels = 1;
+        m_counts.assign(size_t(m_bins), 0);
+
+        for (int j = y; j != y + h; ++j) {
+            const float* row = im.data + c * im.channelSize() + j * im.w;
+            for (int i = x; i != x + w; ++i)
+                m_counts[size_t(bin(row[i]))]++;
+        }
+    }
+
+    int Histogram::bins() const { return m_bins; }
+    int Histogram::channels() const { return m_channels; }
+
+    long long Histogram::count(int bin, int c) const {
+        assert(bin >= 0 && bin < m_bins && c >= 0 && c < m_channels);
+        return m_counts[size_t(c) * size_t(m_bins) + size_t(bin)];
+    }
+
+    long long Histogram::total(int c) const {
+        long long sum = 0;
+        for (int b = 0; b != m_bins; ++b)
+            sum += count(b, c);
+        return sum;
+    }
+
+    std::vector<double> Histogram::probability(int c) const {
+        std::vector<double> p(static_cast<size_t>(m_bins), 0.0);
+        const long long n = total(c);
+        if (n == 0)
+            return p;
+
+        for (int b = 0; b != m_bins; ++b)
+            p[size_t(b)] = double(count(b, c)) / double(n);
+        return p;
+    }
+
+    std::vector<double> Histogram::cumulative(int c) const {
+        std::vector<double> cdf(static_cast<size_t>(m_bins), 0.0);
+        const long long n = total(c);
+        if (n == 0)
+            return cdf;
+
+        long long sum = 0;
+        for (int b = 0; b != m_bins; ++b) {
+            sum += count(b, c);
+            cdf[size_t(b)] = double(sum) / double(n);
+        }
+        return cdf;
+    }
+
+    // value mapping of a cumulative distribution, the first populated bin goes to 0
+    static void equalizationMap(std::vector<double> const& cdf, float* map) {
+        double first = 0.0;
+        for (double v : cdf)
+            if (v > 0.0) {
+                first = v;
+                break;
+            }
+
+        const double range = 1.0 - first;
+        for (size_t b = 0; b != cdf.size(); ++b)
+            map[b] = (range > 0.0) ? float(maximum(0.0, (cdf[b] - first) / range)) : float(cdf[b]);
+    }
+
+    void equalizeHistogram(Mat const& src, Mat& dst, int bins) {
+        dst.reshape(src.w, src.h, src.c);
+
+        Histogram histogram(bins);
+        histogram.compute(src);
+
+        std::vector<float> map(static_cast<size_t>(bins));
+        const int size = src.channelSize();
+        for (int c = 0; c != src.c; ++c) {
+            equalizationMap(histogram.cumulative(c), map.data());
+
+            const float* s = src.data + c * size;
+            float* d = dst.data + c * size;
+            parallelFor(0, size, [&](int begin, int end) {
+                for (int i = begin; i != end; ++i)
+                    d[i] = map[size_t(histogram.bin(s[i]))];
+            }, histogram_grain);
+        }
+    }
+
+    Mat equalizeHistogram(Mat const& src, int bins) {
+        Mat output;
+        equalizeHistogram(src, output, bins);
+        return output;
+    }
+
+    void clahe(Mat const& src, Mat& dst, int tiles_x, int tiles_y, float clip_limit, int bins) {
+        assert(tiles_x > 0 && tiles_y > 0 && bins > 0);
+
+        dst.reshape(src.w, src.h, src.c);
+
+        const int w = src.w;
+        const int h = src.h;
+        tiles_x = minimum(tiles_x, w);
+        tiles_y = minimum(tiles_y, h);
+
+        // tile t covers [t * w / tiles_x, (t + 1) * w / tiles_x)
+        auto tileBegin = [](int t, int size, int tiles) { return int((long long)(t) * size / tiles); };
+
+        const int tiles = tiles_x * tiles_y;
+        std::vector<float> maps(static_cast<size_t>(tiles) * size_t(bins));
+        const Histogram binning(bins);
+
+        for (int c = 0; c != src.c; ++c) {
+            // clipped mapping of every tile
+            parallelFor(0, tiles, [&](int begin, int end) {
+                Histogram histogram(bins);
+                std::vector<double> clipped(static_cast<size_t>(bins));
+
+                for (int t = begin; t != end; ++t) {
+                    const int tx = t % tiles_x;
+                    const int ty = t / tiles_x;
+                    const int x0 = tileBegin(tx, w, tiles_x);
+                    const int y0 = tileBegin(ty, h, tiles_y);
+                    const int tw = tileBegin(tx + 1, w, tiles_x) - x0;
+                    const int th = tileBegin(ty + 1, h, tiles_y) - y0;
+                    histogram.compute(src, c, x0, y0, tw, th);
+
+                    const double n = double(tw) * double(th);
+                    const double limit = maximum(1.0, double(clip_limit) * n / bins);
+
+                    double excess = 0.0;
+                    for (int b = 0; b != bins; ++b) {
+                        const double v = double(histogram.count(b));
+                        clipped[size_t(b)] = minimum(v, limit);
+                        excess += v - clipped[size_t(b)];
+                    }
+
+                    const double spread = excess / bins;
+                    double sum = 0.0;
+                    float* map = maps.data() + size_t(t) * size_t(bins);
+                    for (int b = 0; b != bins; ++b) {
+                        sum += clipped[size_t(b)] + spread;
+                        map[b] = float(minimum(1.0, sum / n));
+                    }
+                }
+            });
+
+            // bilinear interpolation between the 4 closest tile centers
+            const float* s = src.data + c * src.channelSize();
+            float* d = dst.data + c * dst.channelSize();
+            const float tile_w = float(w) / float(tiles_x);
+            const float tile_h = float(h) / float(tiles_y);
+
+            parallelFor(0, h, [&](int begin, int end) {
+                for (int y = begin; y != end; ++y) {
+                    const float fy = clampTo((float(y) + 0.5f) / tile_h - 0.5f, 0.0f, float(tiles_y - 1));
+                    const int ty0 = int(fy);
+                    const int ty1 = minimum(ty0 + 1, tiles_y - 1);
+                    const float ay = fy - float(ty0);
+
+                    for (int x = 0; x != w; ++x) {
+                        const float fx = clampTo((float(x) + 0.5f) / tile_w - 0.5f, 0.0f, float(tiles_x - 1));
+                        const int tx0 = int(fx);
+                        const int tx1 = minimum(tx0 + 1, tiles_x - 1);
+                        const float ax = fx - float(tx0);
+
+                        const size_t b = size_t(binning.bin(s[y * w + x]));
+                        const float v00 = maps[size_t(ty0 * tiles_x + tx0) * size_t(bins) + b];
+                        const float v01 = maps[size_t(ty0 * tiles_x + tx1) * size_t(bins) + b];
+                        const float v10 = maps[size_t(ty1 * tiles_x + tx0) * size_t(bins) + b];
+                        const float v11 = maps[size_t(ty1 * tiles_x + tx1) * size_t(bins) + b];
+
+                        const float top = v00 + (v01 - v00) * ax;
+                        const float bottom = v10 + (v11 - v10) * ax;
+                        d[y * w + x] = top + (bottom - top) * ay;
+                    }
+                }
+            }, 16);
+        }
+    }
+
+    Mat clahe(Mat const& src, int tiles_x, int tiles_y, float clip_limit, int bins) {
+        Mat output;
+        clahe(src, output, tiles_x, tiles_y, clip_limit, bins);
+        return output;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Mat.hpp"
+
+#include <vector>
+
+namespace smk
+{
+    //
+    // Histogram of an image, one per channel.
+    // Bins split [min, max) evenly, values outside are counted in the first / last bin.
+    // The pixels are counted in parallel, each thread fills its own sub histogram and they are merged.
+    //
+    class Histogram
+    {
+    public:
+        explicit Histogram(int bins = 256, float min = 0.0f, float max = 1.0f);
+
+        // Counts all channels of an image, previous counts are discarded.
+        void compute(Mat const& im);
+
+        // Counts a rectangle of one channel.
+        void compute(Mat const& im, int c, int x, int y, int w, int h);
+
+        int bins() const;
+        int channels() const;
+
+        // bin of a value, out of range values go to the first / last bin, NaN to the first
+        int bin(float value) const;
+
+        // lowest value that falls in a bin
+        float binValue(int bin) const;
+
+        long long count(int bin, int c = 0) const;
+        long long total(int c = 0) const;
+
+        // Normalized histogram, sums to 1.
+        std::vector<double> probability(int c = 0) const;
+
+        // Cumulative distribution, cdf[i] is the fraction of pixels in bins [0, i].
+        std::vector<double> cumulative(int c = 0) const;
+
+    private:
+        int m_bins;
+        float m_min;
+        float m_max;
+        float m_scale;
+        int m_channels;
+        std::vector<long long> m_counts; // m_bins per channel
+    };
+
+    // Histogram equalization, each channel is mapped through its cumulative distribution.
+    // image src: image with values in [0, 1].
+    // dst - output: equalized image.
+    // int bins: histogram bins.
+    void equalizeHistogram(Mat const& src, Mat& dst, int bins = 256);
+    Mat equalizeHistogram(Mat const& src, int bins = 256);
+
+    // Contrast Limited Adaptive Histogram Equalization
+    // The image is split in tiles_x x tiles_y tiles, each tile gets an equalization mapping
+    // with its bins clipped at clip_limit times the mean bin count, the excess is spread over all the bins.
+    // Pixels interpolate bilinearly between the mappings of the 4 nearest tile centers.
+    // image src: image with values in [0, 1].
+    // dst - output: equalized image.
+    void clahe(Mat const& src, Mat& dst, int tiles_x = 8, int tiles_y = 8, float clip_limit = 2.0f, int bins = 256);
+    Mat clahe(Mat const& src, int tiles_x = 8, int tiles_y = 8, float clip_limit = 2.0f, int bins = 256);
+}
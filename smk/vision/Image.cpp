@@ -1,11 +1,17 @@
 #include "Image.hpp"
 #include "Optimization.hpp"
 #include "Features.hpp"
+#include "Histogram.hpp"
+#include "MatFile.hpp"
 #include "../math/Mathematics.hpp"
 #include "../File.hpp"
+#include "../threading/Parallel.hpp"
 
 #include <iostream>
 #include <cassert>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
 
 #ifdef INCLUDE_STB_IMAGE
     #define STB_IMAGE_IMPLEMENTATION
@@ -21,6 +27,23 @@ namespace smk
     {
         path = convertFileNameToNativeStyle(path);
 
+        // native mat files skip the decoder
+        if (getLowerCaseFileExtension(path) == U"smat")
+        {
+            Mat m = loadMat(path);
+            if (channels <= 0 || channels == m.c || m.size() == 0)
+                return m;
+
+            if (channels > m.c)
+            {
+                std::cerr << "Cannot load image \"" << str32To8(path) << "\" - asked for " << channels << " channels, the mat has " << m.c << std::endl;
+                return Mat();
+            }
+
+            // the first planes, sharing the loaded data
+            return m.channelView(0, channels);
+        }
+
         int w, h, c;
         unsigned char *data = stbi_load(str32To8(path).c_str(), &w, &h, &c, 0);
         if (!data) {
@@ -33,87 +56,141 @@ namespace smk
             channels = c;
         }
 
+        // same values as the per pixel divide, looked up
+        float table[256];
+        for (int i = 0; i != 256; ++i)
+            table[i] = float(i) / 255.0f;
+
         Mat im(w, h, channels);
         for (int k = 0; k < channels; ++k)
         {
-            for (int j = 0; j < h; ++j)
-            {
-                for (int i = 0; i < w; ++i)
-                {
-                    int dst_index = i + w * j + w * h * k;
-                    int src_index = k + c * i + c * w * j;
-                    im.data[dst_index] = float(data[src_index]) / 255.0f;
-                }
-            }
+            const unsigned char* src = data + k;
+            float* dst = im.data + w * h * k;
+            for (int i = 0; i < w * h; ++i)
+                dst[i] = table[src[c * i]];
         }
 
         free(data);
         return im;
     }
 
+    //
+    // stb reads the png compression level from a global, encodes with the same level run together
+    // and a different level waits for the ones in flight to finish before switching it.
+    // Encodes are admitted in arrival order, a waiting level switch holds back the later arrivals so it can't starve.
+    //
+    class PngLevelLock
+    {
+    public:
+        explicit PngLevelLock(int level)
+        {
+            std::unique_lock<std::mutex> lock(s_mutex);
+            const unsigned long long ticket = s_next_ticket++;
+            s_condition.wait(lock, [level, ticket] { return ticket == s_serving && (s_active == 0 || s_level == level); });
+            if (s_active == 0)
+            {
+                stbi_write_png_compression_level = level;
+                s_level = level;
+            }
+            ++s_active;
+            ++s_serving;
+            s_condition.notify_all();
+        }
+
+        ~PngLevelLock()
+        {
+            std::unique_lock<std::mutex> lock(s_mutex);
+            if (--s_active == 0)
+                s_condition.notify_all();
+        }
+
+        PngLevelLock(PngLevelLock const &) = delete;
+        PngLevelLock &operator=(PngLevelLock const &) = delete;
+
+    private:
+        static inline std::mutex s_mutex;
+        static inline std::condition_variable s_condition;
+        static inline unsigned long long s_next_ticket = 0;
+        static inline unsigned long long s_serving = 0;
+        static inline int s_active = 0;
+        static inline int s_level = 8;
+    };
+
     bool saveImage(str32 path, Mat const &im)
+    {
+        return saveImage(path, im, ImageSaveOptions());
+    }
+
+    bool saveImage(str32 path, Mat const &im, ImageSaveOptions const &options)
     {
         path = convertFileNameToNativeStyle(path);
-        str32 ext = getFileExtension(path);
-        
-        std::string path8 = str32To8(path);
+        str32 ext = getLowerCaseFileExtension(path);
 
-        int quality = 80;
+        if (ext == U"smat")
+            return saveMat(path, im);
 
-        unsigned char *data = static_cast<unsigned char *>(calloc(size_t(im.w * im.h * im.c), sizeof(char)));
+        std::string path8 = str32To8(path);
 
-        for (int k = 0; k < im.c; ++k)
+        // interleave a pixel at a time so the writes are sequential, values are truncated as before
+        std::vector<unsigned char> data(size_t(im.w * im.h * im.c));
+        const int size = im.w * im.h;
+        for (int i = 0; i < size; ++i)
         {
-            for (int i = 0; i < im.w * im.h; ++i)
-            {
-                data[i * im.c + k] = static_cast<unsigned char>(255 * im.data[i + k * im.w * im.h]);
-            }
+            unsigned char *dst = data.data() + size_t(i) * size_t(im.c);
+            for (int k = 0; k < im.c; ++k)
+                dst[k] = static_cast<unsigned char>(clampTo(255 * im.data[i + k * size], 0.0f, 255.0f));
         }
 
         bool ok = false;
         if (ext == U"png")
         {
-            ok = stbi_write_png(path8.c_str(), im.w, im.h, im.c, data, im.w * im.c) > 0;
+            PngLevelLock level(clampTo(options.png_compression, 0, 9));
+            ok = stbi_write_png(path8.c_str(), im.w, im.h, im.c, data.data(), im.w * im.c) > 0;
         }
         else if (ext == U"tga")
         {
-            ok = stbi_write_tga(path8.c_str(), im.w, im.h, im.c, data) > 0;
+            ok = stbi_write_tga(path8.c_str(), im.w, im.h, im.c, data.data()) > 0;
         }
         else if (ext == U"bmp")
         {
-            ok = stbi_write_bmp(path8.c_str(), im.w, im.h, im.c, data) > 0;
+            ok = stbi_write_bmp(path8.c_str(), im.w, im.h, im.c, data.data()) > 0;
         }
         else if (ext == U"jpg")
         {
-            ok = stbi_write_jpg(path8.c_str(), im.w, im.h, im.c, data, quality) > 0;
+            ok = stbi_write_jpg(path8.c_str(), im.w, im.h, im.c, data.data(), clampTo(options.jpg_quality, 1, 100)) > 0;
         }
 
-        free(data);
-
         return ok;
     }
 
     Mat loadImage(str8 path, int channels) { return loadImage(str8To32(path), channels); }
     bool saveImage(str8 path, Mat const &im) { return saveImage(str8To32(path), im); }
+    bool saveImage(str8 path, Mat const &im, ImageSaveOptions const &options) { return saveImage(str8To32(path), im, options); }
+
 
+    // rows per task for the per pixel conversions
+    static const int color_rows_grain = 16;
 
     void rgb2gray(Mat const &src, Mat &dst)
     {
         assert(src.w >= 0 && src.h >= 0 && ((src.c == 3) || (src.c == 4)));
         dst.reshape(src.w, src.h, 1);
-        dst.zero();
 
-        static float scale[] = {0.299f, 0.587f, 0.114f};
-        for (int k = 0; k < 3; ++k)
-        {
-            for (int j = 0; j < src.h; ++j)
-            {
-                for (int i = 0; i < src.w; ++i)
-                {
-                    dst.data[i + dst.w * j] += scale[k] * src.get(i, j, k);
-                }
+        // a single pass over the planes, the sum keeps the r, g, b order of the old per channel accumulation
+        const int size = src.channelSize();
+        parallelFor(0, src.h, [&](int begin, int end) {
+            const float* r = src.data + begin * src.w;
+            const float* g = r + size;
+            const float* b = g + size;
+            float* d = dst.data + begin * src.w;
+
+            for (int i = 0; i != (end - begin) * src.w; ++i) {
+                float v = 0.299f * r[i];
+                v += 0.587f * g[i];
+                v += 0.114f * b[i];
+                d[i] = v;
             }
-        }
+        }, color_rows_grain);
     }
 
     void rgb2hsv(Mat const &src, Mat &dst)
@@ -121,124 +198,228 @@ namespace smk
         assert(src.w >= 0 && src.h >= 0 && src.c == 3);
         dst.reshape(src.w, src.h, 3);
 
-        int i, j;
-        float r, g, b;
-        float h, s, v;
-        for (j = 0; j < src.h; ++j)
-        {
-            for (i = 0; i < src.w; ++i)
-            {
-                r = src.get(i, j, 0);
-                g = src.get(i, j, 1);
-                b = src.get(i, j, 2);
-                float max = maximum(r, g, b);
-                float min = minimum(r, g, b);
-                float delta = max - min;
-                v = max;
-
-                if (equivalent(delta, 0.0f))
-                {
-                    s = 0.0f;
-                    h = 0.0f;
-                }
-                else
-                {
-                    s = delta / max;
+        // branch free, the hue sector is picked with selects so the loop vectorizes
+        const int size = src.channelSize();
+        parallelFor(0, src.h, [&](int begin, int end) {
+            const int offset = begin * src.w;
+            const float* rs = src.data + offset;
+            const float* gs = rs + size;
+            const float* bs = gs + size;
+            float* hd = dst.data + offset;
+            float* sd = hd + size;
+            float* vd = sd + size;
+
+            for (int i = 0; i != (end - begin) * src.w; ++i) {
+                const float r = rs[i];
+                const float g = gs[i];
+                const float b = bs[i];
+                const float max = maximum(r, g, b);
+                const float min = minimum(r, g, b);
+                const float delta = max - min;
+                const bool flat = equivalent(delta, 0.0f);
+                const float inverse = 1.0f / (flat ? 1.0f : delta);
+
+                float h = equivalent(r, max) ? (g - b) * inverse :
+                          equivalent(g, max) ? 2.0f + (b - r) * inverse :
+                                               4.0f + (r - g) * inverse;
+                h = (h < 0.0f) ? h + 6.0f : h;
+
+                hd[i] = flat ? 0.0f : h / 6.0f;
+                sd[i] = flat ? 0.0f : delta / max;
+                vd[i] = max;
+            }
+        }, color_rows_grain);
+    }
 
-                    if (equivalent(r, max))
-                    {
-                        h = (g - b) / delta;
-                    }
-                    else if (equivalent(g, max))
-                    {
-                        h = 2 + (b - r) / delta;
-                    }
-                    else
-                    {
-                        h = 4 + (r - g) / delta;
-                    }
+    void hsv2rgb(Mat const &src, Mat &dst)
+    {
+        assert(src.w >= 0 && src.h >= 0 && src.c == 3);
+        dst.reshape(src.w, src.h, 3);
 
-                    if (h < 0)
-                        h += 6.0;
-                    h = h / 6.0f;
-                }
+        // channel n = v - v s clamp(min(k, 4 - k), 0, 1) with k = (n + 6h) mod 6, n = 5 for r, 3 for g, 1 for b
+        // the same values as picking the hue sector, without branches
+        auto channel = [](float n, float h6, float vs, float v) {
+            float k = n + h6;
+            k = (k >= 6.0f) ? k - 6.0f : k;
+            return v - vs * clampTo(minimum(k, 4.0f - k), 0.0f, 1.0f);
+        };
 
-                dst.set(i, j, 0, h);
-                dst.set(i, j, 1, s);
-                dst.set(i, j, 2, v);
+        const int size = src.channelSize();
+        parallelFor(0, src.h, [&](int begin, int end) {
+            const int offset = begin * src.w;
+            const float* hs = src.data + offset;
+            const float* ss = hs + size;
+            const float* vs = ss + size;
+            float* rd = dst.data + offset;
+            float* gd = rd + size;
+            float* bd = gd + size;
+
+            for (int i = 0; i != (end - begin) * src.w; ++i) {
+                const float h6 = hs[i] * 6.0f;
+                const float v = vs[i];
+                const float sv = equivalent(ss[i], 0.0f) ? 0.0f : ss[i] * v;
+
+                rd[i] = channel(5.0f, h6, sv, v);
+                gd[i] = channel(3.0f, h6, sv, v);
+                bd[i] = channel(1.0f, h6, sv, v);
             }
-        }
+        }, color_rows_grain);
     }
 
-    void hsv2rgb(Mat const &src, Mat &dst)
+    // full range BT.601
+    static const float yuv_kr = 0.299f;
+    static const float yuv_kg = 0.587f;
+    static const float yuv_kb = 0.114f;
+
+    void rgb2yuv(Mat const &src, Mat &dst)
     {
-        assert(src.w >= 0 && src.h >= 0 && src.c == 3);
+        assert(src.c == 3);
         dst.reshape(src.w, src.h, 3);
 
-        int i, j;
-        float r, g, b;
-        float h, s, v;
-        float f, p, q, t;
-        for (j = 0; j < src.h; ++j)
-        {
-            for (i = 0; i < src.w; ++i)
-            {
-                h = src.get(i, j, 0) * 6.0f;
-                s = src.get(i, j, 1);
-                v = src.get(i, j, 2);
-                if (equivalent(s, 0.0f))
-                {
-                    r = g = b = v;
-                }
-                else
-                {
-                    int index = int(floor(h));
-                    f = h - index;
-                    p = v * (1 - s);
-                    q = v * (1 - s * f);
-                    t = v * (1 - s * (1 - f));
-                    if (index == 0)
-                    {
-                        r = v;
-                        g = t;
-                        b = p;
-                    }
-                    else if (index == 1)
-                    {
-                        r = q;
-                        g = v;
-                        b = p;
-                    }
-                    else if (index == 2)
-                    {
-                        r = p;
-                        g = v;
-                        b = t;
-                    }
-                    else if (index == 3)
-                    {
-                        r = p;
-                        g = q;
-                        b = v;
-                    }
-                    else if (index == 4)
-                    {
-                        r = t;
-                        g = p;
-                        b = v;
-                    }
-                    else
-                    {
-                        r = v;
-                        g = p;
-                        b = q;
+        const float u_scale = 0.5f / (1.0f - yuv_kb);
+        const float v_scale = 0.5f / (1.0f - yuv_kr);
+
+        const int size = src.channelSize();
+        parallelFor(0, src.h, [&](int begin, int end) {
+            const int offset = begin * src.w;
+            const float* rs = src.data + offset;
+            const float* gs = rs + size;
+            const float* bs = gs + size;
+            float* yd = dst.data + offset;
+            float* ud = yd + size;
+            float* vd = ud + size;
+
+            for (int i = 0; i != (end - begin) * src.w; ++i) {
+                const float r = rs[i];
+                const float b = bs[i];
+                const float y = yuv_kr * r + yuv_kg * gs[i] + yuv_kb * b;
+                yd[i] = y;
+                ud[i] = 0.5f + (b - y) * u_scale;
+                vd[i] = 0.5f + (r - y) * v_scale;
+            }
+        }, color_rows_grain);
+    }
+
+    void yuv2rgb(Mat const &src, Mat &dst)
+    {
+        assert(src.c == 3);
+        dst.reshape(src.w, src.h, 3);
+
+        const float rv = 2.0f * (1.0f - yuv_kr);
+        const float bu = 2.0f * (1.0f - yuv_kb);
+        const float gu = -bu * yuv_kb / yuv_kg;
+        const float gv = -rv * yuv_kr / yuv_kg;
+
+        const int size = src.channelSize();
+        parallelFor(0, src.h, [&](int begin, int end) {
+            const int offset = begin * src.w;
+            const float* ys = src.data + offset;
+            const float* us = ys + size;
+            const float* vs = us + size;
+            float* rd = dst.data + offset;
+            float* gd = rd + size;
+            float* bd = gd + size;
+
+            for (int i = 0; i != (end - begin) * src.w; ++i) {
+                const float y = ys[i];
+                const float u = us[i] - 0.5f;
+                const float v = vs[i] - 0.5f;
+                rd[i] = y + rv * v;
+                gd[i] = y + gu * u + gv * v;
+                bd[i] = y + bu * u;
+            }
+        }, color_rows_grain);
+    }
+
+    static inline unsigned char toByte(float v) {
+        return (unsigned char)(clampTo(v * 255.0f + 0.5f, 0.0f, 255.0f));
+    }
+
+    void rgb2nv12(Mat const &src, Matb &dst)
+    {
+        assert(src.c == 3 && src.w % 2 == 0 && src.h % 2 == 0);
+
+        const int w = src.w;
+        const int h = src.h;
+        dst.reshape(w, h + h / 2, 1);
+
+        const float u_scale = 0.5f / (1.0f - yuv_kb);
+        const float v_scale = 0.5f / (1.0f - yuv_kr);
+        const int size = src.channelSize();
+
+        // a pair of rows per step, the 2x2 block shares its chroma sample
+        parallelFor(0, h / 2, [&](int begin, int end) {
+            for (int j = begin; j != end; ++j) {
+                unsigned char* uv = dst.data + size + j * w;
+
+                for (int i = 0; i != w; i += 2) {
+                    float r = 0.0f, g = 0.0f, b = 0.0f;
+                    for (int k = 0; k != 4; ++k) {
+                        const int index = (2 * j + k / 2) * w + i + k % 2;
+                        const float pr = src.data[index];
+                        const float pg = src.data[index + size];
+                        const float pb = src.data[index + 2 * size];
+                        dst.data[index] = toByte(yuv_kr * pr + yuv_kg * pg + yuv_kb * pb);
+                        r += pr;
+                        g += pg;
+                        b += pb;
                     }
+
+                    const float y = (yuv_kr * r + yuv_kg * g + yuv_kb * b) * 0.25f;
+                    uv[i + 0] = toByte(0.5f + (b * 0.25f - y) * u_scale);
+                    uv[i + 1] = toByte(0.5f + (r * 0.25f - y) * v_scale);
                 }
-                dst.set(i, j, 0, r);
-                dst.set(i, j, 1, g);
-                dst.set(i, j, 2, b);
             }
-        }
+        }, color_rows_grain);
+    }
+
+    void nv122rgb(Matb const &src, Mat &dst)
+    {
+        assert(src.c == 1 && src.w % 2 == 0 && src.h % 3 == 0);
+
+        const int w = src.w;
+        const int h = src.h * 2 / 3;
+        dst.reshape(w, h, 3);
+
+        const float rv = 2.0f * (1.0f - yuv_kr);
+        const float bu = 2.0f * (1.0f - yuv_kb);
+        const float gu = -bu * yuv_kb / yuv_kg;
+        const float gv = -rv * yuv_kr / yuv_kg;
+        const float scale = 1.0f / 255.0f;
+        const int size = w * h;
+
+        parallelFor(0, h, [&](int begin, int end) {
+            for (int j = begin; j != end; ++j) {
+                const unsigned char* ys = src.data + j * w;
+                const unsigned char* uv = src.data + size + (j / 2) * w;
+                float* r = dst.data + j * w;
+                float* g = r + size;
+                float* b = g + size;
+
+                for (int i = 0; i != w; ++i) {
+                    const float y = ys[i] * scale;
+                    const float u = uv[i & ~1] * scale - 0.5f;
+                    const float v = uv[i | 1] * scale - 0.5f;
+                    r[i] = y + rv * v;
+                    g[i] = y + gu * u + gv * v;
+                    b[i] = y + bu * u;
+                }
+            }
+        }, color_rows_grain);
+    }
+
+    Mat rgb2yuv(Mat const &src)
+    {
+        Mat dst;
+        rgb2yuv(src, dst);
+        return dst;
+    }
+
+    Mat yuv2rgb(Mat const &src)
+    {
+        Mat dst;
+        yuv2rgb(src, dst);
+        return dst;
     }
 
     Mat rgb2gray(Mat const &src)
@@ -308,22 +489,11 @@ namespace smk
         dst.reshape(src.w, src.h, src.c);
 
         int const bins = 256;
-        double const size = src.size();
-
-        double histogram[bins];
-        memset(histogram, 0, bins * sizeof(double));
-
         float const bin_size = 1.0f / bins;
 
-        // compute the histogram
-        for (int i = 0; i < src.channelSize(); ++i) {
-            int bin = clampTo(int(src.data[i] / bin_size), 0, bins - 1);
-            histogram[bin] += 1.0;
-        }
-
-        for(int i = 0; i <= 255; i++) {
-            histogram[i] /= size;
-        }
+        Histogram h(bins);
+        h.compute(src);
+        std::vector<double> const histogram = h.probability();
 
         // compute probabilities
         //
@@ -431,30 +601,184 @@ namespace smk
         return q;
     }
 
-    void resize(Mat const &src, Mat &dst, int nw, int nh, const ResizeMode mode)
+    using ResizeTaps = Resizer::Taps;
+
+    void Resizer::Taps::reshape(int n, int count)
     {
-        dst.reshape(nw, nh, src.c);
+        taps = count;
+        index.assign(size_t(n) * size_t(count), 0);
+        weight.assign(size_t(n) * size_t(count), 0.0f);
+    }
 
-        float (*interpolate)(Mat const &, float, float, int) = (mode == Bilinear) ? interpolateBL : interpolateNN;
+    // one row of the horizontal pass, TAPS > 0 fixes the tap count at compile time
+    template<int TAPS>
+    static inline void resizeRow(const float* s, float* t, int n, ResizeTaps const& taps)
+    {
+        const int count = (TAPS > 0) ? TAPS : taps.taps;
+        const int* index = taps.index.data();
+        const float* weight = taps.weight.data();
+
+        for (int x = 0; x != n; ++x, index += count, weight += count) {
+            float v = s[index[0]] * weight[0];
+            for (int k = 1; k < count; ++k)
+                v += s[index[k]] * weight[k];
+            t[x] = v;
+        }
+    }
 
-        float x_ratio = float(src.w) / float(dst.w);
-        float y_ratio = float(src.h) / float(dst.h);
-        for (int k = 0; k < dst.c; ++k)
-        {
-            for (int y = 0; y < nh; ++y)
-            {
-                for (int x = 0; x < nw; ++x)
-                {
-                    float px = (x + 0.5f) * x_ratio;
-                    float py = (y + 0.5f) * y_ratio;
+    // the bilinear taps use the same arithmetic as interpolateBL, so the result is identical
+    static void resizeTaps(int src_size, int dst_size, ResizeMode mode, ResizeTaps& taps)
+    {
+        const float ratio = float(src_size) / float(dst_size);
+        const int last = src_size - 1;
 
-                    float value = interpolate(src, px, py, k);
-                    dst.set(x, y, k, value);
+        if (mode == Area && ratio <= 1.0f)
+            mode = Bilinear;
+
+        if (mode == NearestNeighbor) {
+            taps.reshape(dst_size, 1);
+            for (int i = 0; i != dst_size; ++i) {
+                taps.index[size_t(i)] = clampTo(int(floorf((i + 0.5f) * ratio)), 0, last);
+                taps.weight[size_t(i)] = 1.0f;
+            }
+        } else if (mode == Bilinear) {
+            taps.reshape(dst_size, 2);
+            for (int i = 0; i != dst_size; ++i) {
+                const float x = (i + 0.5f) * ratio - 0.5f;
+                const int ix = int(floorf(x));
+                const float d1 = x - ix;
+
+                taps.index[size_t(i) * 2 + 0] = clampTo(ix, 0, last);
+                taps.index[size_t(i) * 2 + 1] = clampTo(ix + 1, 0, last);
+                taps.weight[size_t(i) * 2 + 0] = 1.0f - d1;
+                taps.weight[size_t(i) * 2 + 1] = d1;
+            }
+        } else if (mode == Area) {
+            // coverage of [i * ratio, (i + 1) * ratio) over the source pixels
+            const int count = int(ceilf(ratio)) + 1;
+            taps.reshape(dst_size, count);
+            for (int i = 0; i != dst_size; ++i) {
+                const double begin = double(i) * src_size / dst_size;
+                const double end = double(i + 1) * src_size / dst_size;
+                const int first = int(floor(begin));
+
+                for (int t = 0; t != count; ++t) {
+                    const int j = first + t;
+                    const double overlap = minimum(end, double(j + 1)) - maximum(begin, double(j));
+                    taps.index[size_t(i) * size_t(count) + size_t(t)] = clampTo(j, 0, last);
+                    taps.weight[size_t(i) * size_t(count) + size_t(t)] = overlap > 0.0 ? float(overlap / (end - begin)) : 0.0f;
                 }
             }
+        } else {
+            // lanczos 3, stretched by the ratio when downscaling so it also low passes
+            const float scale = maximum(ratio, 1.0f);
+            const float support = 3.0f * scale;
+            const int count = int(ceilf(support)) * 2 + 1;
+            const float pi = piAngle<float>();
+            taps.reshape(dst_size, count);
+
+            for (int i = 0; i != dst_size; ++i) {
+                const float center = (i + 0.5f) * ratio - 0.5f;
+                const int first = int(floorf(center - support)) + 1;
+
+                float sum = 0.0f;
+                for (int t = 0; t != count; ++t) {
+                    const float d = (float(first + t) - center) / scale;
+                    const float w = (absolute(d) < 3.0f) ? sinc(pi * d) * sinc(pi * d / 3.0f) : 0.0f;
+                    taps.index[size_t(i) * size_t(count) + size_t(t)] = clampTo(first + t, 0, last);
+                    taps.weight[size_t(i) * size_t(count) + size_t(t)] = w;
+                    sum += w;
+                }
+
+                for (int t = 0; t != count; ++t)
+                    taps.weight[size_t(i) * size_t(count) + size_t(t)] /= sum;
+            }
         }
     }
 
+    void Resizer::resize(Mat const &src, Mat &dst, int nw, int nh, const ResizeMode mode)
+    {
+        assert(nw > 0 && nh > 0);
+        dst.reshape(nw, nh, src.c);
+
+        if (src.w != m_src_w || src.h != m_src_h || nw != m_w || nh != m_h || mode != m_mode)
+        {
+            resizeTaps(src.w, nw, mode, m_x);
+            resizeTaps(src.h, nh, mode, m_y);
+            m_src_w = src.w;
+            m_src_h = src.h;
+            m_w = nw;
+            m_h = nh;
+            m_mode = mode;
+
+            // only the source rows some output row reads go through the horizontal pass
+            m_needed.assign(size_t(src.h), 0);
+            for (size_t i = 0; i != m_y.index.size(); ++i)
+                if (m_y.weight[i] != 0.0f || i % size_t(m_y.taps) == 0)
+                    m_needed[size_t(m_y.index[i])] = 1;
+        }
+
+        // the intermediate image only grows
+        const size_t channel_size = size_t(nw) * size_t(src.h);
+        if (size_t(m_tmp.size()) < channel_size * size_t(src.c))
+            m_tmp.reshape(int(channel_size * size_t(src.c)), 1, 1);
+
+        ResizeTaps const &xt = m_x;
+        ResizeTaps const &yt = m_y;
+        float *tmp = m_tmp.data;
+
+        // horizontal pass
+        parallelFor(0, src.c * src.h, [&](int begin, int end) {
+            for (int row = begin; row != end; ++row) {
+                if (!m_needed[size_t(row % src.h)])
+                    continue;
+
+                const float* s = src.data + size_t(row) * size_t(src.w);
+                float* t = tmp + size_t(row) * size_t(nw);
+
+                if (xt.taps == 1)
+                    resizeRow<1>(s, t, nw, xt);
+                else if (xt.taps == 2)
+                    resizeRow<2>(s, t, nw, xt);
+                else
+                    resizeRow<0>(s, t, nw, xt);
+            }
+        }, 16);
+
+        // vertical pass, whole rows
+        parallelFor(0, src.c * nh, [&](int begin, int end) {
+            for (int row = begin; row != end; ++row) {
+                const int c = row / nh;
+                const int y = row % nh;
+                const int* index = yt.index.data() + size_t(y) * size_t(yt.taps);
+                const float* weight = yt.weight.data() + size_t(y) * size_t(yt.taps);
+                const float* channel = tmp + size_t(c) * channel_size;
+                float* d = dst.data + size_t(row) * size_t(nw);
+
+                const float* r = channel + size_t(index[0]) * size_t(nw);
+                const float w0 = weight[0];
+                for (int x = 0; x != nw; ++x)
+                    d[x] = r[x] * w0;
+
+                for (int k = 1; k < yt.taps; ++k) {
+                    if (weight[k] == 0.0f)
+                        continue;
+
+                    const float* rk = channel + size_t(index[k]) * size_t(nw);
+                    const float wk = weight[k];
+                    for (int x = 0; x != nw; ++x)
+                        d[x] += rk[x] * wk;
+                }
+            }
+        }, 16);
+    }
+
+    void resize(Mat const &src, Mat &dst, int nw, int nh, const ResizeMode mode)
+    {
+        Resizer resizer;
+        resizer.resize(src, dst, nw, nh, mode);
+    }
+
     Mat resize(Mat const &src, int nw, int nh, const ResizeMode mode)
     {
         Mat dst;
@@ -462,35 +786,178 @@ namespace smk
         return dst;
     }
 
-    Mat cylindricalProject(Mat const &im, float f)
+    void remap(Mat const &src, Mat &dst, Mat const &mapx, Mat const &mapy, const ResizeMode mode)
     {
-        Mat out(im.w, im.h, im.c);
+        assert(mapx.w == mapy.w && mapx.h == mapy.h && mapx.c == 1 && mapy.c == 1);
+        assert(mode == NearestNeighbor || mode == Bilinear);
+
+        dst.reshape(mapx.w, mapx.h, src.c);
+
+        const int w = src.w;
+        const int h = src.h;
+        const int size = src.channelSize();
+        const int dst_size = dst.channelSize();
+
+        parallelFor(0, dst.h, [&](int begin, int end) {
+            for (int y = begin; y != end; ++y) {
+                const float* mx = mapx.data + y * mapx.w;
+                const float* my = mapy.data + y * mapy.w;
+                float* d = dst.data + y * dst.w;
+
+                for (int x = 0; x != dst.w; ++x) {
+                    const float px = mx[x];
+                    const float py = my[x];
+                    if (!(px >= 0.0f && px < w && py >= 0.0f && py < h))
+                        continue;
 
-        float center_x = out.w / 2.0f;
-        float center_y = out.h / 2.0f;
+                    if (mode == NearestNeighbor) {
+                        const float* s = src.data + int(py) * w + int(px);
+                        for (int k = 0; k != src.c; ++k)
+                            d[k * dst_size + x] = s[k * size];
+                        continue;
+                    }
 
-        for (int k = 0; k < out.c; ++k)
-            for (int y = 0; y < out.h; ++y)
-                for (int x = 0; x < out.w; ++x)
-                {
-                    // calculate angle and height
-                    float angle = (x - center_x) / f;
-                    float height = (y - center_y) / f;
-
-                    // find unit cylindrical coords
-                    float cylinder_x = sin(angle);
-                    float cylinder_y = height;
-                    float cylinder_z = cos(angle);
-
-                    // project to image plane
-                    float px = f * cylinder_x / cylinder_z + center_x;
-                    float py = f * cylinder_y / cylinder_z + center_y;
-
-                    if (px >= 0 && px < im.w && py >= 0 && py < im.h)
-                    {
-                        out.set(x, y, k, im.get(int(px), int(py), k));
+                    // same arithmetic as interpolateBL, the weights are shared by the channels
+                    const float fx = px - 0.5f;
+                    const float fy = py - 0.5f;
+                    const int ix = int(floorf(fx));
+                    const int iy = int(floorf(fy));
+                    const int x0 = clampTo(ix, 0, w - 1);
+                    const int x1 = clampTo(ix + 1, 0, w - 1);
+                    const int y0 = clampTo(iy, 0, h - 1) * w;
+                    const int y1 = clampTo(iy + 1, 0, h - 1) * w;
+
+                    const float d1 = fx - ix;
+                    const float d2 = 1.0f - d1;
+                    const float d3 = fy - iy;
+                    const float d4 = 1.0f - d3;
+
+                    for (int k = 0; k != src.c; ++k) {
+                        const float* s = src.data + k * size;
+                        const float q1 = s[y0 + x0] * d2 + s[y0 + x1] * d1;
+                        const float q2 = s[y1 + x0] * d2 + s[y1 + x1] * d1;
+                        d[k * dst_size + x] = q1 * d4 + q2 * d3;
                     }
                 }
+            }
+        }, 16);
+    }
+
+    void perspectiveMap(Matd const &H, int w, int h, Mat &mapx, Mat &mapy, int x0, int y0)
+    {
+        assert(H.w == 3 && H.h == 3 && H.c == 1);
+
+        mapx.reshape(w, h, 1);
+        mapy.reshape(w, h, 1);
+
+        // evaluated as projectPoint does, (h0 x + h1 y) + h2 per row of H
+        parallelFor(0, h, [&](int begin, int end) {
+            for (int y = begin; y != end; ++y) {
+                const double sy = double(float(y + y0));
+                const double ax = H(0, 1) * sy;
+                const double ay = H(1, 1) * sy;
+                const double az = H(2, 1) * sy;
+                float* mx = mapx.data + y * w;
+                float* my = mapy.data + y * w;
+
+                for (int x = 0; x != w; ++x) {
+                    const double sx = double(float(x + x0));
+                    const double X = (H(0, 0) * sx + ax) + H(0, 2);
+                    const double Y = (H(1, 0) * sx + ay) + H(1, 2);
+                    const double Z = (H(2, 0) * sx + az) + H(2, 2);
+                    mx[x] = float(X / Z);
+                    my[x] = float(Y / Z);
+                }
+            }
+        }, 16);
+    }
+
+    void affineMap(Matd const &A, int w, int h, Mat &mapx, Mat &mapy, int x0, int y0)
+    {
+        assert((A.w == 3 && (A.h == 2 || A.h == 3)) && A.c == 1);
+
+        mapx.reshape(w, h, 1);
+        mapy.reshape(w, h, 1);
+
+        // affine maps are linear along a row, a row start and a constant step
+        parallelFor(0, h, [&](int begin, int end) {
+            for (int y = begin; y != end; ++y) {
+                const double sy = double(y + y0);
+                const double bx = A(0, 1) * sy + A(0, 2);
+                const double by = A(1, 1) * sy + A(1, 2);
+                float* mx = mapx.data + y * w;
+                float* my = mapy.data + y * w;
+
+                for (int x = 0; x != w; ++x) {
+                    const double sx = double(x + x0);
+                    mx[x] = float(A(0, 0) * sx + bx);
+                    my[x] = float(A(1, 0) * sx + by);
+                }
+            }
+        }, 16);
+    }
+
+    void warpPerspective(Mat const &src, Mat &dst, Matd const &H, const ResizeMode mode)
+    {
+        assert(dst.w > 0 && dst.h > 0);
+
+        Mat mapx, mapy;
+        perspectiveMap(H, dst.w, dst.h, mapx, mapy);
+        remap(src, dst, mapx, mapy, mode);
+    }
+
+    void warpAffine(Mat const &src, Mat &dst, Matd const &A, const ResizeMode mode)
+    {
+        assert(dst.w > 0 && dst.h > 0);
+
+        Mat mapx, mapy;
+        affineMap(A, dst.w, dst.h, mapx, mapy);
+        remap(src, dst, mapx, mapy, mode);
+    }
+
+    void cylindricalMap(int w, int h, float f, Mat &mapx, Mat &mapy)
+    {
+        mapx.reshape(w, h, 1);
+        mapy.reshape(w, h, 1);
+
+        float center_x = w / 2.0f;
+        float center_y = h / 2.0f;
+
+        // sin and cos only depend on x, one row of them
+        std::vector<float> xs(static_cast<size_t>(w));
+        std::vector<float> zs(static_cast<size_t>(w));
+        for (int x = 0; x < w; ++x)
+        {
+            // calculate angle, unit cylindrical coords
+            float angle = (x - center_x) / f;
+            xs[size_t(x)] = sin(angle);
+            zs[size_t(x)] = cos(angle);
+        }
+
+        parallelFor(0, h, [&](int begin, int end) {
+            for (int y = begin; y != end; ++y)
+            {
+                const float cylinder_y = (y - center_y) / f;
+                float *mx = mapx.data + y * w;
+                float *my = mapy.data + y * w;
+
+                // project to image plane
+                for (int x = 0; x < w; ++x)
+                {
+                    mx[x] = f * xs[size_t(x)] / zs[size_t(x)] + center_x;
+                    my[x] = f * cylinder_y / zs[size_t(x)] + center_y;
+                }
+            }
+        }, 16);
+    }
+
+    Mat cylindricalProject(Mat const &im, float f)
+    {
+        Mat out(im.w, im.h, im.c);
+
+        Mat mapx, mapy;
+        cylindricalMap(im.w, im.h, f, mapx, mapy);
+        remap(im, out, mapx, mapy, NearestNeighbor);
 
         return out;
     }
@@ -563,21 +1030,15 @@ namespace smk
             return;
         }
 
-        // warp image
-        for (int k = 0; k < dst.c; ++k)
-            for (int y = 0; y < dst.h; ++y)
-                for (int x = 0; x < dst.w; ++x)
-                {
-                    Vec p = projectPoint(H, Vec(x, y));
-                    int px = int(p.x());
-                    int py = int(p.y());
-                    if (px < 0 || px >= im.w || py < 0 || py >= im.h)
-                        continue;
-
-                    float value = interpolateBL(im, px, py, k);
-                    dst.set(x, y, k, value);
-                }
-
+        // warp image, the original mapping truncates the projected point before the bilinear sample
+        Mat mapx, mapy;
+        perspectiveMap(H, dst.w, dst.h, mapx, mapy);
+        for (int i = 0; i != mapx.size(); ++i)
+        {
+            mapx.data[i] = float(int(mapx.data[i]));
+            mapy.data[i] = float(int(mapy.data[i]));
+        }
+        remap(im, dst, mapx, mapy, Bilinear);
     }
 
 } // namespace vs
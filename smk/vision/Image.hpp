@@ -4,14 +4,27 @@
 #include "../Text.hpp"
 #include "../math/Vector.hpp"
 #include <array>
+#include <vector>
 
 namespace smk
 {
+    // encoder settings for saveImage
+    struct ImageSaveOptions
+    {
+        int jpg_quality = 80;    // 1 .. 100
+        int png_compression = 8; // zlib level 0 .. 9, higher is smaller and slower
+    };
+
+    // png, jpg, bmp, tga, ... through stb image, .smat files go through loadMat / saveMat (MatFile.hpp)
+    // Extensions are matched ignoring case. channels > 0 keeps the first channels planes, a .smat with fewer fails.
+    // Safe to call from several threads, see ImageIO.hpp for batches.
     Mat loadImage(str32 path, int channels = 0);
     bool saveImage(str32 path, Mat const &im);
+    bool saveImage(str32 path, Mat const &im, ImageSaveOptions const &options);
 
     Mat loadImage(str8 path, int channels = 0);
     bool saveImage(str8 path, Mat const &im);
+    bool saveImage(str8 path, Mat const &im, ImageSaveOptions const &options);
 
 
     void rgb2gray(Mat const& src, Mat &dst);
@@ -29,6 +42,18 @@ namespace smk
     Mat hsv2rgb(Mat const& src);
     void hsv2rgbInplace(Mat &inplace);
 
+    // full range BT.601 YUV (YCbCr), y in [0, 1], u and v centered at 0.5
+    void rgb2yuv(Mat const& src, Mat &dst);
+    Mat rgb2yuv(Mat const& src);
+
+    void yuv2rgb(Mat const& src, Mat &dst);
+    Mat yuv2rgb(Mat const& src);
+
+    // NV12 camera frames, a w x (h * 3 / 2) byte image: the full resolution y plane
+    // followed by interleaved u, v samples, one pair per 2x2 block. w and h must be even.
+    void rgb2nv12(Mat const& src, Matb &dst);
+    void nv122rgb(Matb const& src, Mat &dst);
+
 
     enum ThresholdMode {
         Binary,
@@ -44,14 +69,74 @@ namespace smk
     enum ResizeMode
     {
         NearestNeighbor,
-        Bilinear
+        Bilinear,
+        Area,    // mean of the covered source pixels, for downscaling without aliasing. Bilinear when upscaling
+        Lanczos3 // windowed sinc with 3 lobes, widened by the ratio when downscaling
     };
     float interpolateNN(Mat const& im, float x, float y, int c);
     float interpolateBL(Mat const& im, float x, float y, int c);
+    // Resize with precomputed tap tables, a horizontal pass and then a vertical one over whole rows.
     void resize(Mat const& src, Mat &dst, int nw, int nh, ResizeMode const mode = Bilinear);
     Mat resize(Mat const& src, int nw, int nh, ResizeMode const mode = Bilinear);
 
+    //
+    // resize that keeps its tap tables and intermediate image between calls,
+    // resizing every frame of a stream with the same sizes doesn't allocate nor recompute the taps.
+    //
+    class Resizer
+    {
+    public:
+        void resize(Mat const& src, Mat &dst, int nw, int nh, ResizeMode const mode = Bilinear);
+
+        // output sample i = sum weight[i * taps + t] * src[index[i * taps + t]]
+        // short rows are padded with zero weight taps on the last index.
+        struct Taps
+        {
+            int taps = 0;
+            std::vector<int> index;
+            std::vector<float> weight;
+
+            void reshape(int n, int count);
+        };
+
+    private:
+        Taps m_x;
+        Taps m_y;
+        int m_src_w = 0;
+        int m_src_h = 0;
+        int m_w = 0;
+        int m_h = 0;
+        ResizeMode m_mode = Bilinear;
+        std::vector<unsigned char> m_needed; // source rows read by the vertical pass
+        Mat m_tmp;
+    };
+
+
+    // Samples src at (mapx(x, y), mapy(x, y)) for every dst pixel, the map is shared by all channels.
+    // Coordinates follow interpolateNN / interpolateBL, pixel i covers [i, i + 1).
+    // Map points outside [0, src.w) x [0, src.h) leave the dst pixel untouched,
+    // dst is only reshaped when its size differs from the map.
+    // image src: image to sample.
+    // mapx, mapy: 1 channel maps, the size of dst.
+    // mode: NearestNeighbor or Bilinear.
+    void remap(Mat const& src, Mat &dst, Mat const& mapx, Mat const& mapy, ResizeMode const mode = Bilinear);
+
+    // Maps for a projective transform, map(x, y) = H * (x + x0, y + y0, 1) dehomogenized.
+    // The row terms are computed once per row, the per pixel cost is a few multiply adds and a divide.
+    // matrix H: 3x3 homography from dst to src coordinates.
+    // int w, h: map size.
+    void perspectiveMap(Matd const& H, int w, int h, Mat &mapx, Mat &mapy, int x0 = 0, int y0 = 0);
+
+    // Maps for an affine transform, map(x, y) = A * (x + x0, y + y0, 1).
+    // matrix A: 2x3 (or 3x3 with a 0 0 1 last row) transform from dst to src coordinates.
+    void affineMap(Matd const& A, int w, int h, Mat &mapx, Mat &mapy, int x0 = 0, int y0 = 0);
+
+    // Warps src into dst (which must be sized), H and A map dst coordinates to src coordinates.
+    void warpPerspective(Mat const& src, Mat &dst, Matd const& H, ResizeMode const mode = Bilinear);
+    void warpAffine(Mat const& src, Mat &dst, Matd const& A, ResizeMode const mode = Bilinear);
 
+    // Maps for the cylindrical projection of a w x h image with focal length f, reuse them for every frame.
+    void cylindricalMap(int w, int h, float f, Mat &mapx, Mat &mapy);
     Mat cylindricalProject(Mat const &im, float f);
 
     // http://dlib.net/imaging.html#extract_image_4points
@@ -0,0 +1,79 @@
+#include "ImageIO.hpp"
+#include "../threading/Parallel.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace smk
+{
+    ImageIO::ImageIO(int max_in_flight)
+    {
+        m_max_in_flight = (max_in_flight <= 0) ? parallelThreads() * 2 : max_in_flight;
+    }
+
+    ImageIO::~ImageIO()
+    {
+        // the queued requests point back here
+        wait();
+    }
+
+    int ImageIO::maxInFlight() const
+    {
+        return m_max_in_flight;
+    }
+
+    void ImageIO::submit(std::function<void()> task)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_in_flight < m_max_in_flight; });
+            ++m_in_flight;
+        }
+
+        parallelSubmit([this, task = std::move(task)] {
+            task();
+
+            // notify under the lock, the destructor may run as soon as the count reaches 0
+            std::unique_lock<std::mutex> lock(m_mutex);
+            --m_in_flight;
+            m_condition.notify_all();
+        });
+    }
+
+    void ImageIO::wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return m_in_flight == 0; });
+    }
+
+    std::future<Mat> ImageIO::load(str32 path, int channels)
+    {
+        return run([path, channels] { return loadImage(path, channels); });
+    }
+
+    std::future<bool> ImageIO::save(str32 path, Mat const &im, ImageSaveOptions const &options)
+    {
+        return run([path, im, options] { return saveImage(path, im, options); });
+    }
+
+    std::vector<std::future<Mat>> ImageIO::load(std::vector<str32> const &paths, int channels)
+    {
+        std::vector<std::future<Mat>> results;
+        results.reserve(paths.size());
+        for (str32 const &path : paths)
+            results.push_back(load(path, channels));
+        return results;
+    }
+
+    std::vector<std::future<bool>> ImageIO::save(std::vector<str32> const &paths, std::vector<Mat> const &images,
+                                                 ImageSaveOptions const &options)
+    {
+        assert(paths.size() == images.size());
+
+        std::vector<std::future<bool>> results;
+        results.reserve(paths.size());
+        for (size_t i = 0; i != paths.size(); ++i)
+            results.push_back(save(paths[i], images[i], options));
+        return results;
+    }
+}
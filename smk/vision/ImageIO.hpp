@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Image.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace smk
+{
+    //
+    // Asynchronous image loading and saving on the parallelFor thread pool (parallelSubmit), for batches that are decode / encode bound.
+    // Every request returns a future, results come back in submission order per future, not completion order.
+    // At most maxInFlight requests are queued or running, submitting more blocks the caller until one finishes,
+    // streaming a long list of paths through the service keeps a bounded amount of work (and pixels) alive.
+    // Don't submit from inside a request, it can wait on itself.
+    // The destructor waits for everything already submitted.
+    //
+    class ImageIO
+    {
+    public:
+        // max_in_flight: queued + running requests, 0 uses twice parallelThreads()
+        explicit ImageIO(int max_in_flight = 0);
+        ~ImageIO();
+
+        ImageIO(ImageIO const &) = delete;
+        ImageIO &operator=(ImageIO const &) = delete;
+
+        int maxInFlight() const;
+
+        // loadImage on the pool, an empty Mat when the file can't be decoded.
+        std::future<Mat> load(str32 path, int channels = 0);
+
+        // saveImage on the pool, the Mat is shared (shallow copy) so it must not be written until the future is ready.
+        std::future<bool> save(str32 path, Mat const &im, ImageSaveOptions const &options = ImageSaveOptions());
+
+        // One future per path, in the same order.
+        // Blocks while the batch doesn't fit in maxInFlight, the first futures are ready by the time it returns.
+        std::vector<std::future<Mat>> load(std::vector<str32> const &paths, int channels = 0);
+        std::vector<std::future<bool>> save(std::vector<str32> const &paths, std::vector<Mat> const &images,
+                                            ImageSaveOptions const &options = ImageSaveOptions());
+
+        // Any other work under the same bound, like decoding from memory or a custom format.
+        template <typename Function>
+        auto run(Function function) -> std::future<decltype(function())>
+        {
+            // std::function needs a copyable callable, the task is shared
+            using Result = decltype(function());
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+            std::future<Result> result = task->get_future();
+            submit([task] { (*task)(); });
+            return result;
+        }
+
+        // Waits for every request submitted so far.
+        void wait();
+
+    private:
+        void submit(std::function<void()> task);
+
+        int m_max_in_flight;
+
+        std::mutex m_mutex;
+        std::condition_variable m_condition; // a request finished
+        int m_in_flight = 0;
+    };
+}
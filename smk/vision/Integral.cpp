@@ -0,0 +1,319 @@
+#include "Integral.hpp"
+#include "../threading/Parallel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <initializer_list>
+
+namespace smk
+{
+    // rows per block when splitting a channel across threads
+    static const int integral_block_rows = 64;
+
+    // below this many pixels the table is computed on the calling thread
+    static const int integral_parallel_pixels = 1 << 16;
+
+    template<typename TO, typename TI>
+    static inline TO integralValue(TI v) { return TO(v); }
+
+    template<typename TO, typename TI>
+    static inline TO integralSquare(TI v) { return TO(v) * TO(v); }
+
+    // Integral of rows [begin, end) of one channel, the first row starts from zero.
+    // A running row sum plus the row above, a single streaming pass.
+    template<typename TO, typename TI, TO (*Value)(TI)>
+    static void integralRows(TI const* src, TO* dst, int w, int begin, int end)
+    {
+        for (int y = begin; y != end; ++y)
+        {
+            TI const* s = src + y * w;
+            TO* d = dst + y * w;
+            TO run = 0;
+
+            if (y == begin)
+            {
+                for (int x = 0; x != w; ++x)
+                {
+                    run += Value(s[x]);
+                    d[x] = run;
+                }
+            }
+            else
+            {
+                TO const* above = d - w;
+                for (int x = 0; x != w; ++x)
+                {
+                    run += Value(s[x]);
+                    d[x] = above[x] + run;
+                }
+            }
+        }
+    }
+
+    // Runs rows(k, begin, end) for every channel k.
+    // Big channels are split in row blocks that are integrated independently,
+    // then the last row of each block is carried into the blocks below it.
+    template<typename TO, typename Rows>
+    static void integralBlocks(std::initializer_list<MatT<TO>*> tables, Rows const& rows)
+    {
+        MatT<TO> const& first = **tables.begin();
+        const int w = first.w;
+        const int h = first.h;
+        const int c = first.c;
+
+        int blocks = 1;
+        if (w * h * c >= integral_parallel_pixels)
+            blocks = std::max(1, std::min(parallelThreads(), h / integral_block_rows));
+
+        if (blocks == 1)
+        {
+            parallelFor(0, c, [&](int begin, int end) {
+                for (int k = begin; k != end; ++k)
+                    rows(k, 0, h);
+            });
+            return;
+        }
+
+        auto block_begin = [&](int block) { return h * block / blocks; };
+
+        parallelFor(0, c * blocks, [&](int begin, int end) {
+            for (int task = begin; task != end; ++task)
+            {
+                const int block = task % blocks;
+                rows(task / blocks, block_begin(block), block_begin(block + 1));
+            }
+        });
+
+        for (MatT<TO>* table : tables)
+        {
+            // finish the last row of every block, sequential over blocks
+            for (int k = 0; k != c; ++k)
+            {
+                TO* channel = table->data + k * table->channelSize();
+                for (int block = 1; block != blocks; ++block)
+                {
+                    TO const* carry = channel + (block_begin(block) - 1) * w;
+                    TO* last = channel + (block_begin(block + 1) - 1) * w;
+                    for (int x = 0; x != w; ++x)
+                        last[x] += carry[x];
+                }
+            }
+
+            // add the carry to the remaining rows of every block
+            parallelFor(0, c * blocks, [&](int begin, int end) {
+                for (int task = begin; task != end; ++task)
+                {
+                    const int block = task % blocks;
+                    if (block == 0)
+                        continue;
+
+                    TO* channel = table->data + (task / blocks) * table->channelSize();
+                    TO const* carry = channel + (block_begin(block) - 1) * w;
+                    for (int y = block_begin(block); y != block_begin(block + 1) - 1; ++y)
+                    {
+                        TO* d = channel + y * w;
+                        for (int x = 0; x != w; ++x)
+                            d[x] += carry[x];
+                    }
+                }
+            });
+        }
+    }
+
+    template<typename TI, typename TO>
+    void makeIntegralImage(MatT<TI> const& im, MatT<TO>& out)
+    {
+        out.reshape(im.w, im.h, im.c);
+
+        integralBlocks({ &out }, [&](int k, int begin, int end) {
+            integralRows<TO, TI, integralValue<TO, TI>>(im.data + k * im.channelSize(),
+                                                        out.data + k * out.channelSize(),
+                                                        im.w, begin, end);
+        });
+    }
+
+    template<typename TI, typename TO>
+    void makeIntegralImage(MatT<TI> const& im, MatT<TO>& sum, MatT<TO>& sqsum)
+    {
+        sum.reshape(im.w, im.h, im.c);
+        sqsum.reshape(im.w, im.h, im.c);
+
+        integralBlocks({ &sum, &sqsum }, [&](int k, int begin, int end) {
+            TI const* src = im.data + k * im.channelSize();
+            TO* dst = sum.data + k * sum.channelSize();
+            TO* sqdst = sqsum.data + k * sqsum.channelSize();
+            const int w = im.w;
+
+            for (int y = begin; y != end; ++y)
+            {
+                TI const* s = src + y * w;
+                TO* d = dst + y * w;
+                TO* q = sqdst + y * w;
+                TO run = 0;
+                TO sqrun = 0;
+
+                if (y == begin)
+                {
+                    for (int x = 0; x != w; ++x)
+                    {
+                        const TO v = TO(s[x]);
+                        run += v;
+                        sqrun += v * v;
+                        d[x] = run;
+                        q[x] = sqrun;
+                    }
+                }
+                else
+                {
+                    for (int x = 0; x != w; ++x)
+                    {
+                        const TO v = TO(s[x]);
+                        run += v;
+                        sqrun += v * v;
+                        d[x] = d[x - w] + run;
+                        q[x] = q[x - w] + sqrun;
+                    }
+                }
+            }
+        });
+    }
+
+    template<typename TI, typename TO>
+    void makeSquaredIntegralImage(MatT<TI> const& im, MatT<TO>& out)
+    {
+        out.reshape(im.w, im.h, im.c);
+
+        integralBlocks({ &out }, [&](int k, int begin, int end) {
+            integralRows<TO, TI, integralSquare<TO, TI>>(im.data + k * im.channelSize(),
+                                                         out.data + k * out.channelSize(),
+                                                         im.w, begin, end);
+        });
+    }
+
+    template<typename TI, typename TO>
+    void makeTiltedIntegralImage(MatT<TI> const& im, MatT<TO>& out)
+    {
+        out.reshape(im.w, im.h, im.c);
+
+        const int w = im.w;
+        const int h = im.h;
+
+        // T(x,y) = T(x-1,y-1) + T(x+1,y-1) - T(x,y-2) + im(x,y) + im(x,y-1)
+        // the cones just outside the image are the border cones one row up:
+        // T(-1,y) = T(0,y-1) and T(w,y) = T(w-1,y-1)
+        // each row depends on the two above it, so only the channels run in parallel
+        parallelFor(0, im.c, [&](int begin, int end) {
+            for (int k = begin; k != end; ++k)
+            {
+                TI const* src = im.data + k * im.channelSize();
+                TO* dst = out.data + k * out.channelSize();
+
+                for (int y = 0; y != h; ++y)
+                {
+                    TI const* s = src + y * w;
+                    TO* d = dst + y * w;
+
+                    if (y == 0)
+                    {
+                        for (int x = 0; x != w; ++x)
+                            d[x] = TO(s[x]);
+                        continue;
+                    }
+
+                    TI const* s1 = s - w;
+                    TO const* d1 = d - w;
+                    TO const* d2 = y > 1 ? d - 2 * w : nullptr;
+
+                    for (int x = 0; x != w; ++x)
+                    {
+                        TO v = TO(s[x]) + TO(s1[x]);
+
+                        if (x > 0)
+                            v += d1[x - 1];
+                        else if (d2)
+                            v += d2[0];
+
+                        if (x + 1 < w)
+                            v += d1[x + 1];
+                        else if (d2)
+                            v += d2[w - 1];
+
+                        if (d2)
+                            v -= d2[x];
+
+                        d[x] = v;
+                    }
+                }
+            }
+        });
+    }
+
+    template<typename T>
+    void boxfilterIntegralImage(MatT<T> const& im, int smooth, Mat& out)
+    {
+        out.reshape(im.w, im.h, im.c);
+
+        const int offset = int(smooth / 2);
+        const int w = im.w;
+        const int h = im.h;
+
+        parallelFor(0, im.c * h, [&](int begin, int end) {
+            for (int row = begin; row != end; ++row)
+            {
+                const int k = row / h;
+                const int y = row % h;
+
+                const int t = std::max(y - offset, 0);
+                const int b = std::min(y + offset, h - 1);
+
+                T const* channel = im.data + k * im.channelSize();
+                T const* top = t > 0 ? channel + (t - 1) * w : nullptr;
+                T const* bottom = channel + b * w;
+                float* o = out.data + k * out.channelSize() + y * w;
+
+                for (int x = 0; x != w; ++x)
+                {
+                    const int l = std::max(x - offset, 0);
+                    const int r = std::min(x + offset, w - 1);
+
+                    T A = 0;
+                    T B = 0;
+                    T C = 0;
+                    T D = bottom[r];
+
+                    if (top) {
+                        B = top[r];
+                        if (l > 0)
+                            A = top[l - 1];
+                    }
+
+                    if (l > 0)
+                        C = bottom[l - 1];
+
+                    const int count = (r - l + 1) * (b - t + 1);
+                    o[x] = float(double(D + A - B - C) / double(count));
+                }
+            }
+        }, integral_block_rows);
+    }
+
+    //
+    // force template instantiation
+    //
+#define SMK_INTEGRAL_INSTANTIATE(TI, TO) \
+    template void makeIntegralImage(MatT<TI> const& im, MatT<TO>& out); \
+    template void makeIntegralImage(MatT<TI> const& im, MatT<TO>& sum, MatT<TO>& sqsum); \
+    template void makeSquaredIntegralImage(MatT<TI> const& im, MatT<TO>& out); \
+    template void makeTiltedIntegralImage(MatT<TI> const& im, MatT<TO>& out);
+
+    SMK_INTEGRAL_INSTANTIATE(float, float)
+    SMK_INTEGRAL_INSTANTIATE(float, double)
+    SMK_INTEGRAL_INSTANTIATE(double, double)
+    SMK_INTEGRAL_INSTANTIATE(long long, long long)
+
+#undef SMK_INTEGRAL_INSTANTIATE
+
+    template void boxfilterIntegralImage(MatT<float> const& im, int smooth, Mat& out);
+    template void boxfilterIntegralImage(MatT<double> const& im, int smooth, Mat& out);
+    template void boxfilterIntegralImage(MatT<long long> const& im, int smooth, Mat& out);
+}
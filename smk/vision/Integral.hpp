@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Mat.hpp"
+
+namespace smk
+{
+  //
+  // Integral images (summed area tables)
+  // Tables have the same size as the source, I[x,y] includes the pixel x,y.
+  // The accumulator type is the output type, use Matd or Matl for large images,
+  // float tables lose precision once the sums get big.
+  // Large tables are computed in parallel over channels and row blocks.
+  //
+
+  // Make an integral image or summed area table from an image
+  // image im: image to process
+  // returns: image I such that I[x,y] = sum{i<=x, j<=y}(im[i,j])
+  template<typename TI, typename TO>
+  void makeIntegralImage(MatT<TI> const& im, MatT<TO>& out);
+
+  // Integral image and squared integral image in one pass
+  // sum: I[x,y] = sum{i<=x, j<=y}(im[i,j])
+  // sqsum: I[x,y] = sum{i<=x, j<=y}(im[i,j]^2)
+  template<typename TI, typename TO>
+  void makeIntegralImage(MatT<TI> const& im, MatT<TO>& sum, MatT<TO>& sqsum);
+
+  // Squared integral image
+  // returns: image I such that I[x,y] = sum{i<=x, j<=y}(im[i,j]^2)
+  template<typename TI, typename TO>
+  void makeSquaredIntegralImage(MatT<TI> const& im, MatT<TO>& out);
+
+  // 45 degree rotated integral image (Lienhart & Maydt)
+  // returns: image I such that I[x,y] = sum{j<=y, |x-i| <= y-j}(im[i,j])
+  //          the sum over the upward cone with apex at x,y
+  template<typename TI, typename TO>
+  void makeTiltedIntegralImage(MatT<TI> const& im, MatT<TO>& out);
+
+  //
+  // Gets an integral image info for a region
+  // c - channel
+  // ltrb - Corners
+  // sum = sumed area
+  // count = pixed count used in sum
+  //
+  template<typename T>
+  inline void getIntegralImageRegion(MatT<T> const& im, int c,
+                                     int l, int t, int r, int b,
+                                     T& sum, int& count)
+  {
+      if (l < 0)
+          l = 0;
+
+      if (t < 0)
+          t = 0;
+
+      if (r >= im.w)
+          r = im.w - 1;
+
+      if (b >= im.h)
+          b = im.h - 1;
+
+      T const* channel = im.data + c * im.channelSize();
+      T const* bottom = channel + b * im.w;
+
+      T A = 0;
+      T B = 0;
+      T C = 0;
+      T D = bottom[r];
+
+      if (t > 0) {
+          T const* top = channel + (t - 1) * im.w;
+          B = top[r];
+          if (l > 0)
+              A = top[l - 1];
+      }
+
+      if (l > 0)
+          C = bottom[l - 1];
+
+      sum = D + A - B - C;
+      count = (r - l + 1) * (b - t + 1);
+  }
+
+  // Apply a box filter to an image using an integral image for speed
+  // image im: integral image of the image to smooth
+  // int s: window size for box filter
+  // returns: smoothed image
+  template<typename T>
+  void boxfilterIntegralImage(MatT<T> const& im, int smooth, Mat& out);
+
+} // namespace vs
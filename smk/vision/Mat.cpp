@@ -1,7 +1,11 @@
 #include "Mat.hpp"
+#include "Decomposition.hpp"
 #include "../math/Mathematics.hpp"
+#include "../threading/Parallel.hpp"
 
 #include <cassert>
+#include <type_traits>
+#include <vector>
 
 namespace smk
 {
@@ -30,6 +34,14 @@ namespace smk
         this->data = ext;
     }
 
+    template <typename T>
+    MatT<T>::MatT(int w, int h, int c, T *ext, std::shared_ptr<void> owner)
+        : MatT(w, h, c, ext)
+    {
+        // aliasing constructor, the mat shares the owner lifetime and points at ext
+        shared_data = std::shared_ptr<T>(std::move(owner), ext);
+    }
+
     template <typename T>
     MatT<T> MatT<T>::clone() const
     {
@@ -70,6 +82,18 @@ namespace smk
         return output;
     }
 
+    template <typename T>
+    MatT<T> MatT<T>::view(int offset, int w, int h, int c)
+    {
+        assert(offset >= 0 && offset + w * h * c <= size());
+
+        MatT<T> output(w, h, c, data + offset);
+        // share the data across mat objets
+        output.shared_data = shared_data;
+
+        return output;
+    }
+
     template <typename T>
     MatT<T> &MatT<T>::zero()
     {
@@ -279,10 +303,23 @@ namespace smk
     {
         MatT<T> t(h, w, c);
 
+        // 32x32 tiles, the reads and the writes both stay in cache
+        const int tile = 32;
         for (int k = 0; k != t.c; ++k)
-            for (int y = 0; y != t.h; ++y)
-                for (int x = 0; x != t.w; ++x)
-                    t.set(x, y, k, get(y, x, k));
+        {
+            const T *s = data + k * w * h;
+            T *d = t.data + k * t.w * t.h;
+
+            for (int y0 = 0; y0 < h; y0 += tile)
+                for (int x0 = 0; x0 < w; x0 += tile)
+                {
+                    const int y1 = minimum(y0 + tile, h);
+                    const int x1 = minimum(x0 + tile, w);
+                    for (int y = y0; y != y1; ++y)
+                        for (int x = x0; x != x1; ++x)
+                            d[x * h + y] = s[y * w + x];
+                }
+        }
 
         return t;
     }
@@ -514,69 +551,11 @@ namespace smk
     template <typename T>
     MatT<T> MatT<T>::invert() const
     {
-        MatT<T> none;
-
-        // Matrix not square
-        if (h != w)
-            return none;
-
-        MatT<T> c = augment();
-
-        for (int k = 0; k < c.h; ++k)
-        {
-            T p = 0;
-            int index = -1;
-            for (int i = k; i < c.h; ++i)
-            {
-                T val = T(fabs(c(i, k)));
-                if (val > p)
-                {
-                    p = val;
-                    index = i;
-                }
-            }
-
-            // "Can't do it, sorry!
-            if (index == -1)
-                return none;
-
-            T swap;
-            for (int j = 0; j != c.w; ++j)
-            {
-                swap = c(index, j);
-                c(index, j) = c(k, j);
-                c(k, j) = swap;
-            }
-
-            T val = c(k, k);
-            c(k, k) = 1;
-            for (int j = k + 1; j < c.w; ++j)
-                c(k, j) /= val;
-
-            for (int i = k + 1; i < c.h; ++i)
-            {
-                T s = -c(i, k);
-                c(i, k) = 0;
-                for (int j = k + 1; j < c.w; ++j)
-                    c(i, j) += s * c(k, j);
-            }
-        }
-
-        for (int k = c.h - 1; k > 0; --k)
-            for (int i = 0; i < k; ++i)
-            {
-                T s = -c(i, k);
-                c(i, k) = 0;
-                for (int j = k + 1; j < c.w; ++j)
-                    c(i, j) += s * c(k, j);
-            }
-
-        MatT<T> inv(w, h);
-        for (int i = 0; i < h; ++i)
-            for (int j = 0; j < w; ++j)
-                inv(i, j) = c(i, j + w);
-
-        return inv;
+        // Matrix not square, or not a floating point matrix
+        if constexpr (!std::is_floating_point_v<T>)
+            return MatT<T>();
+        else
+            return LUDecompositionT<T>(*this).inverse();
     }
 
     template <typename T>
@@ -605,17 +584,133 @@ namespace smk
         return H;
     }
 
+    //
+    // gemm
+    // B is packed in kc x nr strips that stay in cache while 4 rows of A stream through the micro kernel.
+    // The micro kernel keeps a 4 x 8 block of C in fixed size accumulators, plain loops the compiler vectorizes.
+    // Products below gemm_small_work go through a i-k-j loop, the sums are formed in the same order as the naive loop.
+    //
+    const int gemm_mr = 4;
+    const int gemm_nr = 8;
+    const int gemm_kc = 256;
+    const int gemm_nc = 512;
+    const long long gemm_small_work = 48 * 48 * 48;
+    const long long gemm_parallel_work = 128 * 128 * 128;
+
+    template <typename T>
+    static void gemmKernel(int m, int n, int kc, const T *a, int lda, const T *bp, T *c, int ldc, bool accumulate)
+    {
+        T acc[gemm_mr][gemm_nr] = {};
+
+        for (int k = 0; k != kc; ++k)
+        {
+            const T *b = bp + k * gemm_nr;
+            for (int r = 0; r != gemm_mr; ++r)
+            {
+                const T av = (r < m) ? a[r * lda + k] : T(0);
+                for (int j = 0; j != gemm_nr; ++j)
+                    acc[r][j] += av * b[j];
+            }
+        }
+
+        for (int r = 0; r != m; ++r)
+        {
+            T *cr = c + r * ldc;
+            if (accumulate)
+                for (int j = 0; j != n; ++j)
+                    cr[j] += acc[r][j];
+            else
+                for (int j = 0; j != n; ++j)
+                    cr[j] = acc[r][j];
+        }
+    }
+
+    template <typename T>
+    static void gemm(int m, int n, int k, const T *a, const T *b, T *c)
+    {
+        const long long work = (long long)(m) * n * k;
+
+        if (work < gemm_small_work)
+        {
+            for (int i = 0; i != m; ++i)
+            {
+                T *cr = c + i * n;
+                for (int j = 0; j != n; ++j)
+                    cr[j] = T(0);
+
+                const T *ar = a + i * k;
+                for (int p = 0; p != k; ++p)
+                {
+                    const T av = ar[p];
+                    const T *br = b + p * n;
+                    for (int j = 0; j != n; ++j)
+                        cr[j] += av * br[j];
+                }
+            }
+            return;
+        }
+
+        const int tiles = (m + gemm_mr - 1) / gemm_mr;
+        const int grain = (work < gemm_parallel_work) ? tiles : 8;
+        std::vector<T> packed;
+
+        for (int j0 = 0; j0 < n; j0 += gemm_nc)
+        {
+            const int nc = minimum(gemm_nc, n - j0);
+            const int strips = (nc + gemm_nr - 1) / gemm_nr;
+
+            for (int k0 = 0; k0 < k; k0 += gemm_kc)
+            {
+                const int kc = minimum(gemm_kc, k - k0);
+
+                // strip s holds columns [j0 + s * nr, j0 + (s + 1) * nr) of rows [k0, k0 + kc), zero padded
+                packed.assign(static_cast<size_t>(strips) * size_t(kc) * size_t(gemm_nr), T(0));
+                for (int s = 0; s != strips; ++s)
+                {
+                    const int js = j0 + s * gemm_nr;
+                    const int nr = minimum(gemm_nr, n - js);
+                    T *dst = packed.data() + size_t(s) * size_t(kc) * size_t(gemm_nr);
+                    for (int p = 0; p != kc; ++p)
+                    {
+                        const T *src = b + (k0 + p) * n + js;
+                        for (int j = 0; j != nr; ++j)
+                            dst[p * gemm_nr + j] = src[j];
+                    }
+                }
+
+                const bool accumulate = k0 > 0;
+                const T *bp = packed.data();
+
+                parallelFor(0, tiles, [&](int begin, int end) {
+                    for (int t = begin; t != end; ++t)
+                    {
+                        const int i = t * gemm_mr;
+                        const int mr = minimum(gemm_mr, m - i);
+                        for (int s = 0; s != strips; ++s)
+                        {
+                            const int js = j0 + s * gemm_nr;
+                            gemmKernel(mr, minimum(gemm_nr, n - js), kc,
+                                       a + i * k + k0, k,
+                                       bp + size_t(s) * size_t(kc) * size_t(gemm_nr),
+                                       c + i * n + js, n, accumulate);
+                        }
+                    }
+                }, grain);
+            }
+        }
+    }
+
     template <typename T>
     void MatT<T>::mmult(const MatT<T> &a, const MatT<T> &b, MatT<T> &p)
     {
         assert(a.w == b.h);
+        assert(&p != &a && &p != &b);
         p.reshape(b.w, a.h, 1);
-        p.zero();
 
-        for (int i = 0; i < p.h; ++i)
-            for (int j = 0; j < p.w; ++j)
-                for (int k = 0; k < a.w; ++k)
-                    p(i, j) += a(i, k) * b(k, j);
+        if (p.size() == 0)
+            return;
+
+        gemm(a.h, b.w, a.w, a.data, b.data, p.data);
     }
 
     template <typename T>
@@ -650,19 +745,11 @@ namespace smk
     template <typename T>
     MatT<T> MatT<T>::llsSolve(MatT<T> const &M, MatT<T> const &b)
     {
-
-        MatT<T> none;
-        MatT<T> Mt = M.transpose();
-        MatT<T> MtM = MatT<T>::mmult(Mt, M);
-        MatT<T> MtMinv = MtM.invert();
-
-        if (MtMinv.size() == 0)
-            return none;
-
-        MatT<T> Mdag = MatT<T>::mmult(MtMinv, Mt);
-        MatT<T> a = MatT<T>::mmult(Mdag, b);
-
-        return a;
+        // householder QR of M, the normal equations are never formed
+        if constexpr (!std::is_floating_point_v<T>)
+            return MatT<T>();
+        else
+            return QRDecompositionT<T>(M).solve(b);
     }
 
     //
@@ -677,4 +764,11 @@ namespace smk
     template MatT<float> MatT<double>::convert();
 
     template class MatT<long long>;
+    template class MatT<int>;
+
+    template class MatT<unsigned char>;
+    template void MatT<float>::convert(MatT<unsigned char> &out);
+    template MatT<unsigned char> MatT<float>::convert();
+    template void MatT<unsigned char>::convert(MatT<float> &out);
+    template MatT<float> MatT<unsigned char>::convert();
 }
@@ -13,6 +13,7 @@ namespace smk
         MatT();
         explicit MatT(int w, int h = 1, int c = 1);
         explicit MatT(int w, int h, int c, T* ext); // external memory pointer
+        explicit MatT(int w, int h, int c, T* ext, std::shared_ptr<void> owner); // external memory kept alive by owner
 
         void reshape(int w, int h, int c);
         int size() const;
@@ -26,6 +27,7 @@ namespace smk
         // these are virtual view on a Mat data, they will point to the parent memory
         // thus they don't allocate new memory
         MatT channelView(int c, int count = 1);
+        MatT view(int offset, int w, int h, int c); // w x h x c mat starting at data + offset
 
         MatT &zero();
         MatT &fill(int c, T v); // fills a channel with v value
@@ -94,6 +96,9 @@ namespace smk
         MatT &setIdentity();
 
         MatT augment() const;
+
+        // inverse through LUDecompositionT, empty when singular or not square
+        // factor once with LUDecompositionT when solving the same system many times
         MatT invert() const;
 
         static MatT makeIdentity(int rows, int cols);
@@ -101,7 +106,8 @@ namespace smk
         static MatT makeTranslation3x3(T dx, T dy);
 
         // Matrix-Matrix multiplication
-        // p = a * b
+        // p = a * b, p must not alias a or b
+        // cache blocked and register tiled, large products run on the parallel threads
         static void mmult(const MatT &a, const MatT &b, MatT& p);
         static MatT mmult(const MatT &a, const MatT &b);
 
@@ -110,8 +116,9 @@ namespace smk
         static void vmult(const MatT &a, const MatT &b, MatT& p);
         static MatT vmult(const MatT &a, const MatT &b);
 
-        // linear least squares solver
+        // linear least squares solver, householder QR (QRDecompositionT)
         // https://textbooks.math.gatech.edu/ila/least-squares.html
+        // returns: empty when M is rank deficient
         static MatT llsSolve(MatT const& M, MatT const& b);
 
         int w;    // width
@@ -125,4 +132,6 @@ namespace smk
     using Mat = MatT<float>;
     using Matd = MatT<double>;
     using Matl = MatT<long long>;
+    using Mati = MatT<int>;
+    using Matb = MatT<unsigned char>;
 }
@@ -0,0 +1,446 @@
+#include "MatFile.hpp"
+#include "../math/Mathematics.hpp"
+#include "../File.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace smk
+{
+    static const char mat_file_magic[4] = {'S', 'M', 'A', 'T'};
+    static const uint32_t mat_file_version = 1;
+    static const uint64_t mat_file_alignment = 64;
+
+    struct MatFileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t type;
+        uint32_t w;
+        uint32_t h;
+        uint32_t c;
+        uint64_t offset;
+        uint64_t bytes;
+        float scale;
+        uint8_t reserved[20];
+    };
+    static_assert(sizeof(MatFileHeader) == mat_file_alignment, "the planes start right after the header");
+
+    static size_t matFileTypeSize(MatFileType type)
+    {
+        switch (type)
+        {
+        case MatFileType::Float32: return 4;
+        case MatFileType::Float16: return 2;
+        case MatFileType::UInt8: return 1;
+        case MatFileType::Float64: return 8;
+        case MatFileType::Int32: return 4;
+        case MatFileType::Int64: return 8;
+        }
+        return 0;
+    }
+
+    template <typename T> static MatFileType matFileTypeOf();
+    template <> MatFileType matFileTypeOf<float>() { return MatFileType::Float32; }
+    template <> MatFileType matFileTypeOf<double>() { return MatFileType::Float64; }
+    template <> MatFileType matFileTypeOf<unsigned char>() { return MatFileType::UInt8; }
+    template <> MatFileType matFileTypeOf<int>() { return MatFileType::Int32; }
+    template <> MatFileType matFileTypeOf<long long>() { return MatFileType::Int64; }
+
+    //
+    // IEEE half precision, round to nearest even
+    //
+    static uint16_t floatToHalf(float value)
+    {
+        uint32_t f;
+        memcpy(&f, &value, sizeof(f));
+
+        const uint32_t sign = (f >> 16) & 0x8000u;
+        const uint32_t exponent = (f >> 23) & 0xffu;
+        uint32_t mantissa = f & 0x7fffffu;
+
+        // nan and inf
+        if (exponent == 0xffu)
+            return uint16_t(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+
+        const int e = int(exponent) - 127 + 15;
+        if (e >= 0x1f)
+            return uint16_t(sign | 0x7c00u);
+
+        if (e <= 0)
+        {
+            // subnormal half, or zero
+            if (e < -10)
+                return uint16_t(sign);
+
+            mantissa |= 0x800000u;
+            const uint32_t shift = uint32_t(14 - e);
+            uint32_t half = mantissa >> shift;
+            const uint32_t rest = mantissa & ((1u << shift) - 1u);
+            const uint32_t halfway = 1u << (shift - 1u);
+            if (rest > halfway || (rest == halfway && (half & 1u)))
+                half++;
+            return uint16_t(sign | half);
+        }
+
+        uint32_t half = (uint32_t(e) << 10) | (mantissa >> 13);
+        const uint32_t rest = mantissa & 0x1fffu;
+        if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+            half++; // may carry into the exponent, up to inf, which is the right rounding
+        return uint16_t(sign | half);
+    }
+
+    static float halfToFloat(uint16_t half)
+    {
+        const uint32_t sign = uint32_t(half & 0x8000u) << 16;
+        uint32_t exponent = (half >> 10) & 0x1fu;
+        uint32_t mantissa = half & 0x3ffu;
+
+        uint32_t f;
+        if (exponent == 0x1fu)
+        {
+            f = sign | 0x7f800000u | (mantissa << 13);
+        }
+        else if (exponent == 0)
+        {
+            if (mantissa == 0)
+            {
+                f = sign;
+            }
+            else
+            {
+                // normalize the subnormal
+                int e = -1;
+                do
+                {
+                    mantissa <<= 1;
+                    e++;
+                } while ((mantissa & 0x400u) == 0);
+
+                f = sign | (uint32_t(127 - 15 - e) << 23) | ((mantissa & 0x3ffu) << 13);
+            }
+        }
+        else
+        {
+            f = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+
+        float value;
+        memcpy(&value, &f, sizeof(value));
+        return value;
+    }
+
+    //
+    // mapping
+    //
+    struct MappedFile
+    {
+        void *address = nullptr;
+        size_t size = 0;
+#if defined(_WIN32)
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#endif
+
+        MappedFile() = default;
+        MappedFile(MappedFile const &) = delete;
+        MappedFile &operator=(MappedFile const &) = delete;
+
+        ~MappedFile()
+        {
+#if defined(_WIN32)
+            if (address)
+                UnmapViewOfFile(address);
+            if (mapping)
+                CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+#else
+            if (address)
+                munmap(address, size);
+#endif
+        }
+    };
+
+    // copy on write mapping of a whole file
+    static std::shared_ptr<MappedFile> mapFile(str32 const &path)
+    {
+        auto mapped = std::make_shared<MappedFile>();
+        std::filesystem::path native(path);
+
+#if defined(_WIN32)
+        mapped->file = CreateFileW(native.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (mapped->file == INVALID_HANDLE_VALUE)
+            return nullptr;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(mapped->file, &size) || size.QuadPart == 0)
+            return nullptr;
+        mapped->size = size_t(size.QuadPart);
+
+        mapped->mapping = CreateFileMappingW(mapped->file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if (!mapped->mapping)
+            return nullptr;
+
+        mapped->address = MapViewOfFile(mapped->mapping, FILE_MAP_COPY, 0, 0, 0);
+        if (!mapped->address)
+            return nullptr;
+#else
+        const int fd = open(native.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            close(fd);
+            return nullptr;
+        }
+        mapped->size = size_t(st.st_size);
+
+        void *address = mmap(nullptr, mapped->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED)
+            return nullptr;
+        mapped->address = address;
+#endif
+
+        return mapped;
+    }
+
+    static bool parseHeader(void const *address, size_t size, MatFileInfo &info)
+    {
+        if (size < sizeof(MatFileHeader))
+            return false;
+
+        MatFileHeader header;
+        memcpy(&header, address, sizeof(header));
+
+        if (memcmp(header.magic, mat_file_magic, sizeof(mat_file_magic)) != 0 || header.version != mat_file_version)
+            return false;
+
+        // the dimensions and the element count must fit in int, each product is checked before the next one
+        const uint64_t int_max = uint64_t(std::numeric_limits<int>::max());
+        if (header.w > int_max || header.h > int_max || header.c > int_max)
+            return false;
+
+        const uint64_t plane = uint64_t(header.w) * header.h;
+        if (plane > int_max || plane * header.c > int_max)
+            return false;
+        const uint64_t count = plane * header.c;
+
+        info.type = MatFileType(header.type);
+        info.w = int(header.w);
+        info.h = int(header.h);
+        info.c = int(header.c);
+        info.offset = header.offset;
+        info.bytes = header.bytes;
+        info.scale = header.scale;
+
+        const size_t element = matFileTypeSize(info.type);
+        return element != 0 &&
+               info.bytes == count * element &&
+               info.offset % mat_file_alignment == 0 &&
+               info.offset <= size && info.bytes <= size - info.offset;
+    }
+
+    bool readMatInfo(str32 path, MatFileInfo &info)
+    {
+        std::ifstream in(std::filesystem::path(path), std::ios::binary);
+        if (!in)
+            return false;
+
+        MatFileHeader header;
+        if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+            return false;
+
+        in.seekg(0, in.end);
+        return parseHeader(&header, size_t(in.tellg()), info);
+    }
+
+    //
+    // save
+    //
+    static bool writeMat(str32 const &path, int w, int h, int c, MatFileType type, float scale, void const *planes)
+    {
+        MatFileHeader header = {};
+        memcpy(header.magic, mat_file_magic, sizeof(mat_file_magic));
+        header.version = mat_file_version;
+        header.type = uint32_t(type);
+        header.w = uint32_t(w);
+        header.h = uint32_t(h);
+        header.c = uint32_t(c);
+        header.offset = mat_file_alignment;
+        header.bytes = uint64_t(w) * uint64_t(h) * uint64_t(c) * matFileTypeSize(type);
+        header.scale = scale;
+
+        std::ofstream out(std::filesystem::path(path), std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!out.good())
+            return false;
+
+        out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+        out.write(static_cast<char const *>(planes), std::streamsize(header.bytes));
+        return out.good();
+    }
+
+    template <typename T>
+    static bool saveNative(str32 path, MatT<T> const &m)
+    {
+        path = convertFileNameToNativeStyle(path);
+        return writeMat(path, m.w, m.h, m.c, matFileTypeOf<T>(), 1.0f, m.data);
+    }
+
+    bool saveMat(str32 path, Mat const &m, MatFileType type)
+    {
+        path = convertFileNameToNativeStyle(path);
+
+        if (type == MatFileType::Float32)
+            return writeMat(path, m.w, m.h, m.c, type, 1.0f, m.data);
+
+        const size_t count = size_t(m.size());
+        if (type == MatFileType::Float16)
+        {
+            std::vector<uint16_t> planes(count);
+            for (size_t i = 0; i != count; ++i)
+                planes[i] = floatToHalf(m.data[i]);
+            return writeMat(path, m.w, m.h, m.c, type, 1.0f, planes.data());
+        }
+
+        if (type == MatFileType::UInt8)
+        {
+            std::vector<uint8_t> planes(count);
+            for (size_t i = 0; i != count; ++i)
+                planes[i] = uint8_t(clampTo(m.data[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+            return writeMat(path, m.w, m.h, m.c, type, 1.0f / 255.0f, planes.data());
+        }
+
+        std::cerr << "Unsupported mat file type for a float Mat" << std::endl;
+        return false;
+    }
+
+    bool saveMat(str32 path, Matd const &m) { return saveNative(path, m); }
+    bool saveMat(str32 path, Matb const &m) { return saveNative(path, m); }
+    bool saveMat(str32 path, Mati const &m) { return saveNative(path, m); }
+    bool saveMat(str32 path, Matl const &m) { return saveNative(path, m); }
+
+    //
+    // load
+    //
+    template <typename S>
+    static void convertPlanes(void const *src, size_t count, float scale, float *dst)
+    {
+        S const *s = static_cast<S const *>(src);
+        for (size_t i = 0; i != count; ++i)
+            dst[i] = float(s[i]) * scale;
+    }
+
+    Mat loadMat(str32 path)
+    {
+        path = convertFileNameToNativeStyle(path);
+
+        std::shared_ptr<MappedFile> mapped = mapFile(path);
+        MatFileInfo info;
+        if (!mapped || !parseHeader(mapped->address, mapped->size, info))
+        {
+            std::cerr << "Cannot load mat \"" << str32To8(path) << "\"" << std::endl;
+            return Mat();
+        }
+
+        Mat m(info.w, info.h, info.c);
+        void const *planes = static_cast<uint8_t const *>(mapped->address) + info.offset;
+        const size_t count = size_t(m.size());
+
+        switch (info.type)
+        {
+        case MatFileType::Float32:
+            if (info.scale == 1.0f)
+                memcpy(m.data, planes, count * sizeof(float));
+            else
+                convertPlanes<float>(planes, count, info.scale, m.data);
+            break;
+        case MatFileType::Float16:
+        {
+            uint16_t const *s = static_cast<uint16_t const *>(planes);
+            for (size_t i = 0; i != count; ++i)
+                m.data[i] = halfToFloat(s[i]) * info.scale;
+            break;
+        }
+        case MatFileType::UInt8:
+        {
+            // same values loadImage gives for 8 bit images, i / 255 and not i * (1 / 255)
+            float table[256];
+            for (int i = 0; i != 256; ++i)
+                table[i] = (info.scale == 1.0f / 255.0f) ? float(i) / 255.0f : float(i) * info.scale;
+
+            uint8_t const *s = static_cast<uint8_t const *>(planes);
+            for (size_t i = 0; i != count; ++i)
+                m.data[i] = table[s[i]];
+            break;
+        }
+        case MatFileType::Float64: convertPlanes<double>(planes, count, info.scale, m.data); break;
+        case MatFileType::Int32: convertPlanes<int32_t>(planes, count, info.scale, m.data); break;
+        case MatFileType::Int64: convertPlanes<int64_t>(planes, count, info.scale, m.data); break;
+        }
+
+        return m;
+    }
+
+    //
+    // map
+    //
+    template <typename T>
+    MatT<T> mapMat(str32 path)
+    {
+        path = convertFileNameToNativeStyle(path);
+
+        std::shared_ptr<MappedFile> mapped = mapFile(path);
+        MatFileInfo info;
+        if (!mapped || !parseHeader(mapped->address, mapped->size, info))
+        {
+            std::cerr << "Cannot map mat \"" << str32To8(path) << "\"" << std::endl;
+            return MatT<T>();
+        }
+
+        if (info.type != matFileTypeOf<T>() || info.scale != 1.0f)
+        {
+            std::cerr << "Cannot map mat \"" << str32To8(path) << "\" - stored type needs a conversion, use loadMat" << std::endl;
+            return MatT<T>();
+        }
+
+        if (info.bytes == 0)
+            return MatT<T>();
+
+        T *data = reinterpret_cast<T *>(static_cast<uint8_t *>(mapped->address) + info.offset);
+        return MatT<T>(info.w, info.h, info.c, data, std::move(mapped));
+    }
+
+    Mat mapMat(str32 path) { return mapMat<float>(path); }
+
+    bool saveMat(str8 path, Mat const &m, MatFileType type) { return saveMat(str8To32(path), m, type); }
+    Mat loadMat(str8 path) { return loadMat(str8To32(path)); }
+    Mat mapMat(str8 path) { return mapMat(str8To32(path)); }
+
+    //
+    // force template instantiation
+    //
+    template MatT<float> mapMat<float>(str32 path);
+    template MatT<double> mapMat<double>(str32 path);
+    template MatT<unsigned char> mapMat<unsigned char>(str32 path);
+    template MatT<int> mapMat<int>(str32 path);
+    template MatT<long long> mapMat<long long>(str32 path);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Mat.hpp"
+#include "../Text.hpp"
+
+#include <cstdint>
+
+namespace smk
+{
+    //
+    // Native Mat container, a 64 byte header followed by the raw planes, in MatT layout.
+    // The planes start 64 byte aligned so a file can be memory mapped and used in place.
+    //
+    // header (little endian)
+    //   char magic[4]       "SMAT"
+    //   uint32 version      1
+    //   uint32 type         MatFileType of the stored elements
+    //   uint32 w, h, c
+    //   uint64 offset       start of the planes, from the beginning of the file
+    //   uint64 bytes        size of the planes
+    //   float scale         stored value * scale is the loaded value (UInt8 images use 1 / 255)
+    //
+    enum class MatFileType : uint32_t
+    {
+        Float32 = 0,
+        Float16 = 1,
+        UInt8 = 2,
+        Float64 = 3,
+        Int32 = 4,
+        Int64 = 5,
+    };
+
+    struct MatFileInfo
+    {
+        MatFileType type = MatFileType::Float32;
+        int w = 0;
+        int h = 0;
+        int c = 0;
+        uint64_t offset = 0;
+        uint64_t bytes = 0;
+        float scale = 1.0f;
+    };
+
+    // Reads the header of a mat file.
+    // returns: false when the file can't be read or isn't a mat file.
+    bool readMatInfo(str32 path, MatFileInfo& info);
+
+    // Writes a Mat.
+    // type: Float32 (exact), Float16 (half the size) or UInt8 (images in [0, 1], clamped and rounded to 1 / 255 steps).
+    bool saveMat(str32 path, Mat const& m, MatFileType type = MatFileType::Float32);
+    bool saveMat(str32 path, Matd const& m);
+    bool saveMat(str32 path, Matb const& m);
+    bool saveMat(str32 path, Mati const& m);
+    bool saveMat(str32 path, Matl const& m);
+
+    // Reads a mat file of any element type into a float Mat, converting and scaling.
+    // returns: empty Mat on failure.
+    Mat loadMat(str32 path);
+
+    // Memory maps a mat file, no copy and no decoding, the data is read by the page as it's used.
+    // The stored type must be T (Float32 for Mat, UInt8 for Matb, ...) and the scale 1, otherwise an empty Mat is returned.
+    // The mapping is copy on write, writes to the Mat never reach the file.
+    // The mapping lives as long as the returned Mat or any copy / view of it.
+    template <typename T>
+    MatT<T> mapMat(str32 path);
+
+    Mat mapMat(str32 path);
+
+    bool saveMat(str8 path, Mat const& m, MatFileType type = MatFileType::Float32);
+    Mat loadMat(str8 path);
+    Mat mapMat(str8 path);
+}
@@ -0,0 +1,226 @@
+#include "Morphology.hpp"
+#include "../math/Mathematics.hpp"
+#include "../threading/Parallel.hpp"
+
+#include <cassert>
+#include <limits>
+#include <vector>
+
+namespace smk
+{
+    // columns per band in the vertical pass, the band buffers stay in cache
+    static const int morphology_band_columns = 256;
+
+    template<typename T>
+    struct MorphologyMin {
+        static inline T apply(T const a, T const b) { return minimum(a, b); }
+        static inline T identity() { return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max(); }
+    };
+
+    template<typename T>
+    struct MorphologyMax {
+        static inline T apply(T const a, T const b) { return maximum(a, b); }
+        static inline T identity() { return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest(); }
+    };
+
+    // Padded length of a line of n samples for a window of k, a whole number of k blocks.
+    // The line starts at k / 2, everything else holds the identity.
+    static inline int morphologyPadded(int n, int k) {
+        const int length = n + k - 1;
+        return ((length + k - 1) / k) * k;
+    }
+
+    // van Herk / Gil-Werman over one line.
+    // line: padded samples, g and h: scratch of the same size.
+    // g[i] runs the operation from the start of i's block, h[i] from the end of i's block.
+    // The window starting at i spans at most 2 blocks: out[i] = op(h[i], g[i + k - 1]).
+    template<typename T, typename Op>
+    static inline void morphologyLine(T const* line, T* g, T* h, int padded, int k, T* out, int n) {
+        for (int b = 0; b < padded; b += k) {
+            g[b] = line[b];
+            for (int i = b + 1; i != b + k; ++i)
+                g[i] = Op::apply(g[i - 1], line[i]);
+
+            h[b + k - 1] = line[b + k - 1];
+            for (int i = b + k - 2; i >= b; --i)
+                h[i] = Op::apply(h[i + 1], line[i]);
+        }
+
+        for (int i = 0; i != n; ++i)
+            out[i] = Op::apply(h[i], g[i + k - 1]);
+    }
+
+    template<typename T, typename Op>
+    static void morphologyHorizontal(MatT<T> const& src, MatT<T>& dst, int k) {
+        const int w = src.w;
+        const int padded = morphologyPadded(w, k);
+        const int offset = k / 2;
+
+        parallelFor(0, src.h * src.c, [&](int begin, int end) {
+            std::vector<T> scratch(static_cast<size_t>(padded) * 3);
+            T* line = scratch.data();
+            T* g = line + padded;
+            T* h = g + padded;
+
+            for (int i = 0; i != offset; ++i)
+                line[i] = Op::identity();
+            for (int i = offset + w; i != padded; ++i)
+                line[i] = Op::identity();
+
+            for (int row = begin; row != end; ++row) {
+                const T* s = src.data + size_t(row) * size_t(w);
+                T* d = dst.data + size_t(row) * size_t(w);
+
+                std::copy(s, s + w, line + offset);
+                morphologyLine<T, Op>(line, g, h, padded, k, d, w);
+            }
+        }, 16);
+    }
+
+    // Same algorithm down the columns, a row at a time over a band of columns, the inner loops are contiguous.
+    // Only 2 blocks of k rows are kept: the h of the current block and the g of the next one.
+    // Both g and h of a block are computed before the block above it is written,
+    // the rows written never come after the rows still to be read, so it runs in place.
+    template<typename T, typename Op>
+    static void morphologyVertical(MatT<T>& im, int k) {
+        const int w = im.w;
+        const int rows = im.h;
+        const int padded = morphologyPadded(rows, k);
+        const int offset = k / 2;
+
+        for (int c = 0; c != im.c; ++c) {
+            T* channel = im.data + c * im.channelSize();
+
+            parallelFor(0, w, [&](int begin, int end) {
+                const size_t band = size_t(end - begin);
+                const size_t block = size_t(k) * band;
+                std::vector<T> scratch(block * 4 + band, Op::identity());
+                T* g_current = scratch.data();
+                T* h_current = g_current + block;
+                T* g_next = h_current + block;
+                T* h_next = g_next + block;
+                const T* identity = h_next + block;
+
+                // the input row i of the padded column, identity outside the image
+                auto row = [&](int i) -> T const* {
+                    const int y = i - offset;
+                    return (y >= 0 && y < rows) ? channel + y * w + begin : identity;
+                };
+
+                auto prepare = [&](int b, T* g, T* h) {
+                    std::copy(row(b), row(b) + band, g);
+                    for (int i = 1; i != k; ++i) {
+                        const T* s = row(b + i);
+                        const T* p = g + size_t(i - 1) * band;
+                        T* o = g + size_t(i) * band;
+                        for (size_t x = 0; x != band; ++x)
+                            o[x] = Op::apply(p[x], s[x]);
+                    }
+
+                    std::copy(row(b + k - 1), row(b + k - 1) + band, h + size_t(k - 1) * band);
+                    for (int i = k - 2; i >= 0; --i) {
+                        const T* s = row(b + i);
+                        const T* p = h + size_t(i + 1) * band;
+                        T* o = h + size_t(i) * band;
+                        for (size_t x = 0; x != band; ++x)
+                            o[x] = Op::apply(p[x], s[x]);
+                    }
+                };
+
+                prepare(0, g_current, h_current);
+                for (int b = 0; b < rows; b += k) {
+                    if (b + k < padded)
+                        prepare(b + k, g_next, h_next);
+
+                    // out[y] = op(h[y], g[y + k - 1]), g[y + k - 1] is row y - 1 of the next block
+                    const int last = minimum(b + k, rows);
+                    for (int y = b; y != last; ++y) {
+                        const int i = y - b;
+                        const T* a = h_current + size_t(i) * band;
+                        const T* e = (i == 0) ? g_current + size_t(k - 1) * band : g_next + size_t(i - 1) * band;
+                        T* o = channel + y * w + begin;
+                        for (size_t x = 0; x != band; ++x)
+                            o[x] = Op::apply(a[x], e[x]);
+                    }
+
+                    std::swap(g_current, g_next);
+                    std::swap(h_current, h_next);
+                }
+            }, morphology_band_columns);
+        }
+    }
+
+    template<typename T, typename Op>
+    static void morphology(MatT<T> const& src, MatT<T>& dst, int kw, int kh) {
+        assert(kw > 0 && kh > 0);
+
+        dst.reshape(src.w, src.h, src.c);
+
+        if (kw > 1)
+            morphologyHorizontal<T, Op>(src, dst, kw);
+        else if (dst.data != src.data)
+            std::copy(src.data, src.data + src.size(), dst.data);
+
+        if (kh > 1)
+            morphologyVertical<T, Op>(dst, kh);
+    }
+
+    template<typename T>
+    void erode(MatT<T> const& src, MatT<T>& dst, int kw, int kh) {
+        morphology<T, MorphologyMin<T>>(src, dst, kw, kh);
+    }
+
+    template<typename T>
+    void dilate(MatT<T> const& src, MatT<T>& dst, int kw, int kh) {
+        morphology<T, MorphologyMax<T>>(src, dst, kw, kh);
+    }
+
+    template<typename T>
+    void opening(MatT<T> const& src, MatT<T>& dst, int kw, int kh) {
+        erode(src, dst, kw, kh);
+        dilate(dst, dst, kw, kh);
+    }
+
+    template<typename T>
+    void closing(MatT<T> const& src, MatT<T>& dst, int kw, int kh) {
+        dilate(src, dst, kw, kh);
+        erode(dst, dst, kw, kh);
+    }
+
+    Mat erode(Mat const& src, int kw, int kh) {
+        Mat output;
+        erode(src, output, kw, kh);
+        return output;
+    }
+
+    Mat dilate(Mat const& src, int kw, int kh) {
+        Mat output;
+        dilate(src, output, kw, kh);
+        return output;
+    }
+
+    Mat opening(Mat const& src, int kw, int kh) {
+        Mat output;
+        opening(src, output, kw, kh);
+        return output;
+    }
+
+    Mat closing(Mat const& src, int kw, int kh) {
+        Mat output;
+        closing(src, output, kw, kh);
+        return output;
+    }
+
+    //
+    // force template instantiation
+    //
+    template void erode(Mat const& src, Mat& dst, int kw, int kh);
+    template void dilate(Mat const& src, Mat& dst, int kw, int kh);
+    template void opening(Mat const& src, Mat& dst, int kw, int kh);
+    template void closing(Mat const& src, Mat& dst, int kw, int kh);
+
+    template void erode(Matb const& src, Matb& dst, int kw, int kh);
+    template void dilate(Matb const& src, Matb& dst, int kw, int kh);
+    template void opening(Matb const& src, Matb& dst, int kw, int kh);
+    template void closing(Matb const& src, Matb& dst, int kw, int kh);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Mat.hpp"
+
+namespace smk
+{
+    //
+    // Morphology with rectangular structuring elements.
+    // van Herk / Gil-Werman: a line of any length costs 3 min (or max) per pixel,
+    // the rectangle is a horizontal line followed by a vertical one.
+    // Pixels outside the image are ignored, the window is clipped at the borders.
+    // Instantiated for Mat (float) and Matb (unsigned char) masks.
+    // src and dst can be the same mat.
+    //
+
+    // Erosion, minimum over a kw x kh window
+    // image src: input image, every channel is processed.
+    // int kw, kh: window size, the window covers [x - kw / 2, x - kw / 2 + kw - 1] (same for y).
+    // dst - output: eroded image.
+    template<typename T>
+    void erode(MatT<T> const& src, MatT<T>& dst, int kw, int kh);
+
+    // Dilation, maximum over a kw x kh window
+    template<typename T>
+    void dilate(MatT<T> const& src, MatT<T>& dst, int kw, int kh);
+
+    // Opening, erosion followed by dilation. Removes foreground smaller than the window.
+    template<typename T>
+    void opening(MatT<T> const& src, MatT<T>& dst, int kw, int kh);
+
+    // Closing, dilation followed by erosion. Fills holes smaller than the window.
+    template<typename T>
+    void closing(MatT<T> const& src, MatT<T>& dst, int kw, int kh);
+
+    Mat erode(Mat const& src, int kw, int kh);
+    Mat dilate(Mat const& src, int kw, int kh);
+    Mat opening(Mat const& src, int kw, int kh);
+    Mat closing(Mat const& src, int kw, int kh);
+}
@@ -2,94 +2,18 @@
 #include "Filter.hpp"
 #include "Image.hpp"
 #include "Features.hpp"
+#include "../math/Mathematics.hpp"
+#include "../threading/Parallel.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
 
 namespace smk
 {
 
-    void makeIntegralImage(const Mat &im, Mat &out)
-    {
-        out.reshape(im.w, im.h, im.c);
-
-        for (int k = 0; k != im.c; ++k)
-            for (int y = 0; y != im.h; ++y)
-                for (int x = 0; x != im.w; ++x)
-                {
-                    float v = im.get(x, y, k);
-
-                    if (y > 0)
-                        v += out.get(x, y - 1, k);
-
-                    if (x > 0)
-                        v += out.get(x - 1, y, k);
-
-                    if (x > 0 && y > 0)
-                        v -= out.get(x - 1, y - 1, k);
-
-                    out.set(x, y, k, v);
-                }
-    }
-
-
-    void getIntegralImageRegion(const Mat &im, int c, int l, int t, int r, int b, float &sum, int &count)
-    {
-        if (l < 0)
-            l = 0;
-
-        if (t < 0)
-            t = 0;
-
-        if (r >= im.w)
-            r = im.w - 1;
-
-        if (b >= im.h)
-            b = im.h - 1;
-
-        float A = 0;
-        float B = 0;
-        float C = 0;
-        float D = im.get(r, b, c);
-
-        if (l - 1 >= 0 && t - 1 >= 0) {
-            A = im.get(l - 1, t - 1, c);
-            B = im.get(r, t - 1, c);
-            C = im.get(l - 1, b, c);
-        } else if (l - 1 >= 0) {
-            C = im.get(l - 1, b, c);
-        } else if (t - 1 >= 0) {
-            B = im.get(r, t - 1, c);
-        }
-
-        sum = D + A - B - C;
-        count = (r - l + 1) * (b - t + 1);
-    }
-
-
-    void boxfilterIntegralImage(const Mat &im, int smooth, Mat &out)
-    {
-        out.reshape(im.w, im.h, im.c);
-
-        int offset = int(smooth / 2);
-        int wi = im.w - 1;
-        int hi = im.h - 1;
-
-        for (int k = 0; k != im.c; ++k)
-            for (int y = 0; y != im.h; ++y)
-                for (int x = 0; x != im.w; ++x)
-                {
-                    int l = x - offset;
-                    int t = y - offset;
-                    int r = x + offset;
-                    int b = y + offset;
-
-                    float sum;
-                    int count;
-                    getIntegralImageRegion(im, k, l, t, r, b, sum, count);
-                    out.set(x, y, k, sum / float(count));
-                }
-    }
-
     void LucasKanade::timeStructureMatrix(const Mat &im, const Mat &prev, int smooth, Mat &S)
     {
         // returns: structure matrix. 1st channel is Ix^2, 2nd channel is Iy^2,
@@ -119,8 +43,7 @@ namespace smk
             IyIt.data[i] = y * t;
         }
 
-        makeIntegralImage(m_I, m_Ii);
-        boxfilterIntegralImage(m_Ii, smooth, S);
+        boxfilter(m_I, S, m_box, smooth);
     }
 
     void LucasKanade::velocityImage(const Mat &S, int stride, Mat &v)
@@ -130,9 +53,9 @@ namespace smk
         v.reshape(S.w/stride, S.h/stride, 3);
         v.zero();
 
-        Mat A(2,2);
-        Mat B(1, 2);
-        Mat P(1, 2);
+        Mat2 A;
+        FixedVec<float, 2> B;
+        FixedVec<float, 2> P;
 
         for (int y = (stride - 1) / 2; y < S.h; y += stride)
         {
@@ -152,24 +75,177 @@ namespace smk
                 A(1, 0) = S.get(x, y, 2); // Ixy
                 A(1, 1) = S.get(x, y, 1); // Iyy
 
-                B(0, 0) = -S.get(x, y, 3); //Ixt
-                B(1, 0) = -S.get(x, y, 4); //Iyt
+                B[0] = -S.get(x, y, 3); //Ixt
+                B[1] = -S.get(x, y, 4); //Iyt
 
                 // check for invertability
                 if (minEigenValue2x2(A) > eigen_threshold)
                 {
-                    Mat Ai = A.invert();
-                    if (Ai.size() == 0)
+                    if (!solve(A, B, P))
                         continue;
 
-                    Mat::vmult(Ai, B, P);
-                    v.set(tx, ty, 0, P(0, 0));
-                    v.set(tx, ty, 1, P(1, 0));
+                    v.set(tx, ty, 0, P[0]);
+                    v.set(tx, ty, 1, P[1]);
                 }
             }
         }
     }
 
+
+    void LucasKanade::velocity(const Mat &im, const Mat &prev, int smooth, int stride, Mat &v)
+    {
+        assert(im.w == prev.w && im.h == prev.h);
+        assert(im.c == 1 && prev.c == 1);
+        assert(stride > 0);
+
+        const float eigen_threshold = 0.0002f;
+
+        const int w = im.w;
+        const int h = im.h;
+        const int r = smooth / 2;
+        const int first = (stride - 1) / 2;
+
+        v.reshape(w / stride, h / stride, 3);
+        v.zero();
+
+        const int vw = v.w;
+        const int vh = v.h;
+        if (vw == 0 || vh == 0)
+            return;
+
+        // per chunk: 5 row prefix sums, a ring of 2r + 1 reduced rows and the running vertical sum
+        const int prefix_size = 5 * (w + 1);
+        const int reduced_size = 5 * vw;
+        const int ring = 2 * r + 1;
+        const int chunk_size = prefix_size + (ring + 1) * reduced_size;
+        const int chunks = parallelChunks(0, vh, 4);
+        m_rows.reshape(chunk_size, chunks, 1);
+
+        // window columns of each sampled x
+        std::vector<int> lefts(static_cast<size_t>(vw)), rights(static_cast<size_t>(vw));
+        for (int tx = 0; tx != vw; ++tx)
+        {
+            const int x = first + tx * stride;
+            lefts[size_t(tx)] = maximum(x - r, 0);
+            rights[size_t(tx)] = minimum(x + r, w - 1);
+        }
+
+        parallelForChunks(0, vh, [&](int chunk, int begin, int end) {
+            double *prefix = m_rows.data + chunk * chunk_size;
+            double *rows = prefix + prefix_size;
+            double *sum = rows + ring * reduced_size;
+
+            // reduces image row y to the 5 window sums at each sampled column
+            auto reduce = [&](int y, double *out) {
+                const float *r0 = im.data + clampTo(y - 1, 0, h - 1) * w;
+                const float *r1 = im.data + y * w;
+                const float *r2 = im.data + clampTo(y + 1, 0, h - 1) * w;
+                const float *p1 = prev.data + y * w;
+
+                double *pxx = prefix;
+                double *pyy = pxx + w + 1;
+                double *pxy = pyy + w + 1;
+                double *pxt = pxy + w + 1;
+                double *pyt = pxt + w + 1;
+                pxx[0] = pyy[0] = pxy[0] = pxt[0] = pyt[0] = 0.0;
+
+                for (int x = 0; x != w; ++x)
+                {
+                    const int xl = maximum(x - 1, 0);
+                    const int xr = minimum(x + 1, w - 1);
+
+                    const float gx = (r0[xr] - r0[xl]) + 2.0f * (r1[xr] - r1[xl]) + (r2[xr] - r2[xl]);
+                    const float gy = (r2[xl] + 2.0f * r2[x] + r2[xr]) - (r0[xl] + 2.0f * r0[x] + r0[xr]);
+                    const float gt = r1[x] - p1[x];
+
+                    pxx[x + 1] = pxx[x] + double(gx * gx);
+                    pyy[x + 1] = pyy[x] + double(gy * gy);
+                    pxy[x + 1] = pxy[x] + double(gx * gy);
+                    pxt[x + 1] = pxt[x] + double(gx * gt);
+                    pyt[x + 1] = pyt[x] + double(gy * gt);
+                }
+
+                for (int tx = 0; tx != vw; ++tx)
+                {
+                    const int a = lefts[size_t(tx)];
+                    const int b = rights[size_t(tx)] + 1;
+                    double *o = out + 5 * tx;
+                    o[0] = pxx[b] - pxx[a];
+                    o[1] = pyy[b] - pyy[a];
+                    o[2] = pxy[b] - pxy[a];
+                    o[3] = pxt[b] - pxt[a];
+                    o[4] = pyt[b] - pyt[a];
+                }
+            };
+
+            // rows [lo, hi] are summed in sum and kept in the ring
+            int lo = 0;
+            int hi = -1;
+
+            for (int ty = begin; ty != end; ++ty)
+            {
+                const int y = first + ty * stride;
+                const int want_lo = maximum(y - r, 0);
+                const int want_hi = minimum(y + r, h - 1);
+
+                // no overlap with the previous window, start over
+                if (want_lo > hi)
+                {
+                    std::fill(sum, sum + reduced_size, 0.0);
+                    lo = want_lo;
+                    hi = want_lo - 1;
+                }
+
+                while (lo < want_lo)
+                {
+                    const double *old = rows + (lo % ring) * reduced_size;
+                    for (int i = 0; i != reduced_size; ++i)
+                        sum[i] -= old[i];
+                    lo++;
+                }
+
+                while (hi < want_hi)
+                {
+                    hi++;
+                    double *row = rows + (hi % ring) * reduced_size;
+                    reduce(hi, row);
+                    for (int i = 0; i != reduced_size; ++i)
+                        sum[i] += row[i];
+                }
+
+                const int count_y = hi - lo + 1;
+                for (int tx = 0; tx != vw; ++tx)
+                {
+                    const double count = double(count_y * (rights[size_t(tx)] - lefts[size_t(tx)] + 1));
+                    const double *s = sum + 5 * tx;
+
+                    const float xx = float(s[0] / count);
+                    const float yy = float(s[1] / count);
+                    const float xy = float(s[2] / count);
+                    const float xt = float(s[3] / count);
+                    const float yt = float(s[4] / count);
+
+                    Mat2 A;
+                    A[0] = xx; A[1] = xy;
+                    A[2] = xy; A[3] = yy;
+
+                    // check for invertability
+                    if (minEigenValue2x2(A) <= eigen_threshold)
+                        continue;
+
+                    FixedVec<float, 2> B, P;
+                    B[0] = -xt;
+                    B[1] = -yt;
+                    if (!solve(A, B, P))
+                        continue;
+
+                    v.set(tx, ty, 0, P[0]);
+                    v.set(tx, ty, 1, P[1]);
+                }
+            }
+        });
+    }
+
     void LucasKanade::opticalflow(const Mat &im, const Mat &prev, int smooth, int stride, Mat &vs)
     {
         assert(im.w == prev.w && im.h == prev.h);
@@ -184,11 +260,1036 @@ namespace smk
         else    
             rgb2gray(prev, m_prev_gray);        
         
-        timeStructureMatrix(m_curr_gray, m_prev_gray, smooth, m_S);
-        velocityImage(m_S, stride, m_V);
+        velocity(m_curr_gray, m_prev_gray, smooth, stride, m_V);
 
         m_V.constrain(6.0f);
-        smoothImage(m_V, vs, 2.0);
+        smoothImage(m_V, vs, m_tmp, 2.0);
+    }
+
+    bool LucasKanade::push(const Mat &frame, int smooth, int stride, Mat &vs)
+    {
+        if (frame.c == 1)
+        {
+            m_frame_gray.reshape(frame.w, frame.h, 1);
+            memcpy(m_frame_gray.data, frame.data, sizeof(float) * size_t(frame.size()));
+        }
+        else
+        {
+            rgb2gray(frame, m_frame_gray);
+        }
+
+        const bool computed = m_has_last && m_last_gray.w == frame.w && m_last_gray.h == frame.h;
+        if (computed)
+        {
+            velocity(m_frame_gray, m_last_gray, smooth, stride, m_V);
+
+            m_V.constrain(6.0f);
+            smoothImage(m_V, vs, m_tmp, 2.0);
+        }
+
+        std::swap(m_frame_gray, m_last_gray);
+        m_has_last = true;
+        return computed;
+    }
+
+    void LucasKanade::reset()
+    {
+        m_has_last = false;
+    }
+
+    // Samples a (2 * half + 1)^2 patch centered at x, y with bilinear interpolation.
+    // The sub pixel weights are the same for every sample, only the border needs clamping.
+    static void sampleBilinearPatch(Mat const &im, float x, float y, int half, float *out)
+    {
+        const int x0 = floorToInt(x);
+        const int y0 = floorToInt(y);
+        const float ax = x - float(x0);
+        const float ay = y - float(y0);
+
+        const float w00 = (1.0f - ax) * (1.0f - ay);
+        const float w10 = ax * (1.0f - ay);
+        const float w01 = (1.0f - ax) * ay;
+        const float w11 = ax * ay;
+
+        const int size = 2 * half + 1;
+        const int last_x = im.w - 1;
+        const int last_y = im.h - 1;
+
+        if (x0 - half >= 0 && y0 - half >= 0 && x0 + half + 1 <= last_x && y0 + half + 1 <= last_y)
+        {
+            for (int j = 0; j != size; ++j)
+            {
+                const float *r0 = im.data + (y0 - half + j) * im.w + x0 - half;
+                const float *r1 = r0 + im.w;
+                float *o = out + j * size;
+
+                for (int i = 0; i != size; ++i)
+                    o[i] = w00 * r0[i] + w10 * r0[i + 1] + w01 * r1[i] + w11 * r1[i + 1];
+            }
+            return;
+        }
+
+        for (int j = 0; j != size; ++j)
+        {
+            const int ya = clampTo(y0 - half + j, 0, last_y);
+            const int yb = clampTo(y0 - half + j + 1, 0, last_y);
+            const float *r0 = im.data + ya * im.w;
+            const float *r1 = im.data + yb * im.w;
+            float *o = out + j * size;
+
+            for (int i = 0; i != size; ++i)
+            {
+                const int xa = clampTo(x0 - half + i, 0, last_x);
+                const int xb = clampTo(x0 - half + i + 1, 0, last_x);
+                o[i] = w00 * r0[xa] + w10 * r0[xb] + w01 * r1[xa] + w11 * r1[xb];
+            }
+        }
+    }
+
+    void SparseLucasKanade::buildPyramid(const Mat &im, Pyramid &pyramid)
+    {
+        if (im.c == 1)
+        {
+            pyramid.build(im, levels);
+        }
+        else
+        {
+            rgb2gray(im, m_gray);
+            pyramid.build(m_gray, levels);
+        }
+    }
+
+    void SparseLucasKanade::track(const Mat &prev, const Mat &im,
+                                  std::vector<Vector2F> const &points,
+                                  std::vector<Vector2F> &tracked,
+                                  std::vector<unsigned char> &status)
+    {
+        assert(im.w == prev.w && im.h == prev.h);
+
+        buildPyramid(prev, m_prev);
+        buildPyramid(im, m_curr);
+        track(m_prev, m_curr, points, tracked, status);
+    }
+
+    void SparseLucasKanade::track(Pyramid const &prev, Pyramid const &curr,
+                                  std::vector<Vector2F> const &points,
+                                  std::vector<Vector2F> &tracked,
+                                  std::vector<unsigned char> &status) const
+    {
+        assert(prev.levels() > 0 && curr.levels() > 0);
+        assert(prev.level(0).w == curr.level(0).w && prev.level(0).h == curr.level(0).h);
+        assert(prev.level(0).c == 1 && curr.level(0).c == 1);
+        assert(window >= 3 && window % 2 == 1);
+
+        tracked.resize(points.size());
+        status.resize(points.size());
+
+        const int count = int(points.size());
+        const int top = minimum(prev.levels(), curr.levels()) - 1;
+        const int half = window / 2;
+        const int size = window;
+        const int padded = window + 2;
+        const float area = float(window * window);
+
+        parallelFor(0, count, [&](int begin, int end) {
+            std::vector<float> patch(size_t(padded * padded));
+            std::vector<float> ix(size_t(size * size));
+            std::vector<float> iy(size_t(size * size));
+            std::vector<float> moved(size_t(size * size));
+
+            for (int p = begin; p != end; ++p)
+            {
+                const Vector2F point = points[size_t(p)];
+                bool ok = true;
+
+                // d is the displacement estimate at the current level
+                float dx = 0.0f;
+                float dy = 0.0f;
+
+                for (int level = top; level >= 0 && ok; --level)
+                {
+                    Mat const &I = prev.level(level);
+                    Mat const &J = curr.level(level);
+                    const float scale = 1.0f / float(1 << level);
+                    const float ux = point.x() * scale;
+                    const float uy = point.y() * scale;
+
+                    if (ux < 0.0f || uy < 0.0f || ux > float(I.w - 1) || uy > float(I.h - 1))
+                    {
+                        ok = false;
+                        break;
+                    }
+
+                    // previous window with a one pixel margin for the central differences
+                    sampleBilinearPatch(I, ux, uy, half + 1, patch.data());
+
+                    float gxx = 0.0f, gxy = 0.0f, gyy = 0.0f;
+                    for (int j = 0; j != size; ++j)
+                    {
+                        const float *c = patch.data() + (j + 1) * padded + 1;
+                        float *ox = ix.data() + j * size;
+                        float *oy = iy.data() + j * size;
+
+                        for (int i = 0; i != size; ++i)
+                        {
+                            const float x = (c[i + 1] - c[i - 1]) * 0.5f;
+                            const float y = (c[i + padded] - c[i - padded]) * 0.5f;
+                            ox[i] = x;
+                            oy[i] = y;
+                            gxx += x * x;
+                            gxy += x * y;
+                            gyy += y * y;
+                        }
+                    }
+
+                    if (minEigenValue2x2(gxx, gxy, gxy, gyy) / area < min_eigen)
+                    {
+                        ok = false;
+                        break;
+                    }
+
+                    const float det = gxx * gyy - gxy * gxy;
+                    const float idet = 1.0f / det;
+
+                    for (int iteration = 0; iteration != iterations; ++iteration)
+                    {
+                        const float vx = ux + dx;
+                        const float vy = uy + dy;
+                        if (vx < -float(half) || vy < -float(half) ||
+                            vx > float(J.w - 1 + half) || vy > float(J.h - 1 + half))
+                        {
+                            ok = false;
+                            break;
+                        }
+
+                        sampleBilinearPatch(J, vx, vy, half, moved.data());
+
+                        float bx = 0.0f, by = 0.0f;
+                        for (int j = 0; j != size; ++j)
+                        {
+                            const float *c = patch.data() + (j + 1) * padded + 1;
+                            const float *m = moved.data() + j * size;
+                            const float *ox = ix.data() + j * size;
+                            const float *oy = iy.data() + j * size;
+
+                            for (int i = 0; i != size; ++i)
+                            {
+                                const float e = c[i] - m[i];
+                                bx += e * ox[i];
+                                by += e * oy[i];
+                            }
+                        }
+
+                        const float ex = (gyy * bx - gxy * by) * idet;
+                        const float ey = (gxx * by - gxy * bx) * idet;
+                        dx += ex;
+                        dy += ey;
+
+                        if (ex * ex + ey * ey < epsilon * epsilon)
+                            break;
+                    }
+
+                    // guess for the next finer level
+                    if (level > 0)
+                    {
+                        dx *= 2.0f;
+                        dy *= 2.0f;
+                    }
+                }
+
+                Vector2F result(point.x() + dx, point.y() + dy);
+                Mat const &base = curr.level(0);
+                if (result.x() < 0.0f || result.y() < 0.0f || result.x() > float(base.w - 1) || result.y() > float(base.h - 1))
+                    ok = false;
+
+                tracked[size_t(p)] = ok ? result : point;
+                status[size_t(p)] = ok ? 1 : 0;
+            }
+        }, 16);
+    }
+
+    //
+    // Farneback
+    //
+    // farnebackGaussian, polynomialExpansion and updateMatrices (border weights included) are adapted from
+    // OpenCV's FarnebackPolyExp / FarnebackUpdateMatrices (modules/video/src/optflowgf.cpp),
+    // https://github.com/opencv/opencv/blob/3.4/modules/video/src/optflowgf.cpp
+    // used under its 3-clause BSD license:
+    //
+    // Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+    // Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+    // Third party copyrights are property of their respective owners.
+    //
+    // Redistribution and use in source and binary forms, with or without modification,
+    // are permitted provided that the following conditions are met:
+    //
+    //   * Redistribution's of source code must retain the above copyright notice,
+    //     this list of conditions and the following disclaimer.
+    //
+    //   * Redistribution's in binary form must reproduce the above copyright notice,
+    //     this list of conditions and the following disclaimer in the documentation
+    //     and/or other materials provided with the distribution.
+    //
+    //   * The name of the copyright holders may not be used to endorse or promote products
+    //     derived from this software without specific prior written permission.
+    //
+    // This software is provided by the copyright holders and contributors "as is" and
+    // any express or implied warranties, including, but not limited to, the implied
+    // warranties of merchantability and fitness for a particular purpose are disclaimed.
+    // In no event shall the Intel Corporation or contributors be liable for any direct,
+    // indirect, incidental, special, exemplary, or consequential damages
+    // (including, but not limited to, procurement of substitute goods or services;
+    // loss of use, data, or profits; or business interruption) however caused
+    // and on any theory of liability, whether in contract, strict liability,
+    // or tort (including negligence or otherwise) arising in any way out of
+    // the use of this software, even if advised of the possibility of such damage.
+    //
+
+    // gaussian weights g, x * g, x^2 * g for x in [-n, n], stored at index x + n,
+    // and the entries of the inverse normal matrix needed by the expansion
+    static void farnebackGaussian(int n, float sigma,
+                                  std::vector<float> &g, std::vector<float> &xg, std::vector<float> &xxg,
+                                  double &ig11, double &ig03, double &ig33, double &ig55)
+    {
+        const int size = 2 * n + 1;
+        g.resize(size_t(size));
+        xg.resize(size_t(size));
+        xxg.resize(size_t(size));
+
+        double s = 0.0;
+        for (int x = -n; x <= n; ++x)
+        {
+            g[size_t(x + n)] = float(std::exp(-x * x / (2.0 * double(sigma) * double(sigma))));
+            s += g[size_t(x + n)];
+        }
+
+        s = 1.0 / s;
+        for (int x = -n; x <= n; ++x)
+        {
+            const size_t i = size_t(x + n);
+            g[i] = float(g[i] * s);
+            xg[i] = float(x) * g[i];
+            xxg[i] = float(x * x) * g[i];
+        }
+
+        // normal matrix of the basis 1, x, y, x^2, y^2, xy
+        Matd G(6, 6);
+        for (int y = -n; y <= n; ++y)
+            for (int x = -n; x <= n; ++x)
+            {
+                const double gyx = double(g[size_t(y + n)]) * double(g[size_t(x + n)]);
+                G(0, 0) += gyx;
+                G(1, 1) += gyx * x * x;
+                G(3, 3) += gyx * x * x * x * x;
+                G(5, 5) += gyx * x * x * y * y;
+            }
+
+        G(2, 2) = G(0, 3) = G(0, 4) = G(3, 0) = G(4, 0) = G(1, 1);
+        G(4, 4) = G(3, 3);
+        G(3, 4) = G(4, 3) = G(5, 5);
+
+        Matd iG = G.invert();
+        assert(iG.size() != 0);
+
+        ig11 = iG(1, 1);
+        ig03 = iG(0, 3);
+        ig33 = iG(3, 3);
+        ig55 = iG(5, 5);
+    }
+
+    void FarnebackFlow::polynomialExpansion(const Mat &src, Mat &dst, int n, float sigma)
+    {
+        assert(src.c == 1);
+        assert(n > 0);
+
+        const int w = src.w;
+        const int h = src.h;
+        dst.reshape(w, h, 5);
+
+        std::vector<float> g, xg, xxg;
+        double ig11, ig03, ig33, ig55;
+        farnebackGaussian(n, sigma, g, xg, xxg, ig11, ig03, ig33, ig55);
+
+        const float fig11 = float(ig11);
+        const float fig03 = float(ig03);
+        const float fig33 = float(ig33);
+        const float fig55 = float(ig55);
+
+        const int cs = dst.channelSize();
+
+        parallelFor(0, h, [&](int begin, int end) {
+            // vertical convolutions of a row, 3 interleaved values per pixel with n replicated pixels on each side
+            std::vector<float> buffer(size_t((w + 2 * n) * 3));
+            float *row = buffer.data() + n * 3;
+
+            for (int y = begin; y != end; ++y)
+            {
+                const float *s0 = src.data + y * w;
+                const float g0 = g[size_t(n)];
+                for (int x = 0; x != w; ++x)
+                {
+                    row[x * 3] = s0[x] * g0;
+                    row[x * 3 + 1] = 0.0f;
+                    row[x * 3 + 2] = 0.0f;
+                }
+
+                for (int k = 1; k <= n; ++k)
+                {
+                    const float gk = g[size_t(n + k)];
+                    const float xgk = xg[size_t(n + k)];
+                    const float xxgk = xxg[size_t(n + k)];
+                    const float *up = src.data + maximum(y - k, 0) * w;
+                    const float *down = src.data + minimum(y + k, h - 1) * w;
+
+                    for (int x = 0; x != w; ++x)
+                    {
+                        const float p = up[x] + down[x];
+                        row[x * 3] += gk * p;
+                        row[x * 3 + 1] += xgk * (down[x] - up[x]);
+                        row[x * 3 + 2] += xxgk * p;
+                    }
+                }
+
+                for (int x = 0; x != n; ++x)
+                    for (int j = 0; j != 3; ++j)
+                    {
+                        row[(-1 - x) * 3 + j] = row[j];
+                        row[(w + x) * 3 + j] = row[(w - 1) * 3 + j];
+                    }
+
+                // horizontal convolutions
+                float *d = dst.data + y * w;
+                for (int x = 0; x != w; ++x)
+                {
+                    // b1 ~ 1, b2 ~ x, b3 ~ y, b4 ~ x^2, b5 ~ y^2, b6 ~ xy
+                    float b1 = row[x * 3] * g0, b2 = 0.0f, b3 = row[x * 3 + 1] * g0;
+                    float b4 = 0.0f, b5 = row[x * 3 + 2] * g0, b6 = 0.0f;
+
+                    for (int k = 1; k <= n; ++k)
+                    {
+                        const float *r = row + (x + k) * 3;
+                        const float *l = row + (x - k) * 3;
+                        const float gk = g[size_t(n + k)];
+                        const float xgk = xg[size_t(n + k)];
+                        const float tg = r[0] + l[0];
+
+                        b1 += tg * gk;
+                        b4 += tg * xxg[size_t(n + k)];
+                        b2 += (r[0] - l[0]) * xgk;
+                        b3 += (r[1] + l[1]) * gk;
+                        b6 += (r[1] - l[1]) * xgk;
+                        b5 += (r[2] + l[2]) * gk;
+                    }
+
+                    d[x] = b3 * fig11;
+                    d[x + cs] = b2 * fig11;
+                    d[x + 2 * cs] = b1 * fig03 + b5 * fig33;
+                    d[x + 3 * cs] = b1 * fig03 + b4 * fig33;
+                    d[x + 4 * cs] = b6 * fig55;
+                }
+            }
+        }, 8);
+    }
+
+    // Builds the per pixel matrices G (g11, g12, g22) and h (h1, h2) of the displacement equations
+    // comparing the expansion R0 with R1 displaced by the current flow.
+    static void farnebackUpdateMatrices(Mat const &R0, Mat const &R1, Mat const &flow, Mat &M)
+    {
+        static const int border_size = 5;
+        static const float border[border_size] = { 0.14f, 0.14f, 0.4472f, 0.4472f, 0.4472f };
+
+        const int w = flow.w;
+        const int h = flow.h;
+        const int cs = w * h;
+        M.reshape(w, h, 5);
+
+        parallelFor(0, h, [&](int begin, int end) {
+            for (int y = begin; y != end; ++y)
+            {
+                const float *fx_row = flow.data + y * w;
+                const float *fy_row = fx_row + cs;
+                const float *r0 = R0.data + y * w;
+                float *m = M.data + y * w;
+
+                for (int x = 0; x != w; ++x)
+                {
+                    const float dx = fx_row[x];
+                    const float dy = fy_row[x];
+                    float fx = float(x) + dx;
+                    float fy = float(y) + dy;
+
+                    const int x1 = floorToInt(fx);
+                    const int y1 = floorToInt(fy);
+                    fx -= float(x1);
+                    fy -= float(y1);
+
+                    float r2, r3, r4, r5, r6;
+
+                    if (x1 >= 0 && y1 >= 0 && x1 < w - 1 && y1 < h - 1)
+                    {
+                        const float a00 = (1.0f - fx) * (1.0f - fy);
+                        const float a01 = fx * (1.0f - fy);
+                        const float a10 = (1.0f - fx) * fy;
+                        const float a11 = fx * fy;
+
+                        const float *p = R1.data + y1 * w + x1;
+                        auto sample = [&](int k) {
+                            const float *q = p + k * cs;
+                            return a00 * q[0] + a01 * q[1] + a10 * q[w] + a11 * q[w + 1];
+                        };
+
+                        r2 = sample(0);
+                        r3 = sample(1);
+                        r4 = (r0[x + 2 * cs] + sample(2)) * 0.5f;
+                        r5 = (r0[x + 3 * cs] + sample(3)) * 0.5f;
+                        r6 = (r0[x + 4 * cs] + sample(4)) * 0.25f;
+                    }
+                    else
+                    {
+                        r2 = r3 = 0.0f;
+                        r4 = r0[x + 2 * cs];
+                        r5 = r0[x + 3 * cs];
+                        r6 = r0[x + 4 * cs] * 0.5f;
+                    }
+
+                    r2 = (r0[x] - r2) * 0.5f;
+                    r3 = (r0[x + cs] - r3) * 0.5f;
+
+                    r2 += r4 * dy + r6 * dx;
+                    r3 += r6 * dy + r5 * dx;
+
+                    // less weight to the borders, the expansion there is made of replicated pixels
+                    if (x < border_size || y < border_size || x >= w - border_size || y >= h - border_size)
+                    {
+                        const float scale = (x < border_size ? border[x] : 1.0f) *
+                                            (x >= w - border_size ? border[w - x - 1] : 1.0f) *
+                                            (y < border_size ? border[y] : 1.0f) *
+                                            (y >= h - border_size ? border[h - y - 1] : 1.0f);
+                        r2 *= scale;
+                        r3 *= scale;
+                        r4 *= scale;
+                        r5 *= scale;
+                        r6 *= scale;
+                    }
+
+                    m[x] = r4 * r4 + r6 * r6;            // g11
+                    m[x + cs] = (r4 + r5) * r6;          // g12
+                    m[x + 2 * cs] = r5 * r5 + r6 * r6;   // g22
+                    m[x + 3 * cs] = r4 * r2 + r6 * r3;   // h1
+                    m[x + 4 * cs] = r6 * r2 + r5 * r3;   // h2
+                }
+            }
+        }, 8);
+    }
+
+    // flow resampled to a w x h level, dst(x, y) = src(x * ratio, y * ratio) / ratio
+    static void scaleFlow(Mat const &src, Mat &dst, int w, int h, float ratio)
+    {
+        dst.reshape(w, h, 2);
+
+        const int sw = src.w;
+        const int sh = src.h;
+        const float inv = 1.0f / ratio;
+
+        // the source columns and weights are the same for every row
+        std::vector<int> columns(static_cast<size_t>(w) * 2);
+        std::vector<float> weights(static_cast<size_t>(w));
+        for (int x = 0; x != w; ++x)
+        {
+            const float sx = minimum(float(x) * ratio, float(sw - 1));
+            const int x0 = int(sx);
+            columns[size_t(2 * x)] = x0;
+            columns[size_t(2 * x + 1)] = minimum(x0 + 1, sw - 1);
+            weights[size_t(x)] = sx - float(x0);
+        }
+
+        // blend the two source rows first, then widen the blended row
+        parallelFor(0, h, [&](int begin, int end) {
+            std::vector<float> row(static_cast<size_t>(sw));
+
+            for (int y = begin; y != end; ++y)
+            {
+                const float sy = minimum(float(y) * ratio, float(sh - 1));
+                const int y0 = int(sy);
+                const int y1 = minimum(y0 + 1, sh - 1);
+                const float ay = sy - float(y0);
+
+                for (int k = 0; k != 2; ++k)
+                {
+                    const float *r0 = src.data + k * src.channelSize() + y0 * sw;
+                    const float *r1 = src.data + k * src.channelSize() + y1 * sw;
+                    for (int x = 0; x != sw; ++x)
+                        row[size_t(x)] = (r0[x] * (1.0f - ay) + r1[x] * ay) * inv;
+
+                    const float *r = row.data();
+                    float *d = dst.data + k * dst.channelSize() + y * w;
+                    for (int x = 0; x != w; ++x)
+                    {
+                        const float a = r[columns[size_t(2 * x)]];
+                        const float b = r[columns[size_t(2 * x + 1)]];
+                        d[x] = a + (b - a) * weights[size_t(x)];
+                    }
+                }
+            }
+        }, 8);
+    }
+
+    void FarnebackFlow::prepare(const Mat &frame, Pyramid &pyramid, std::vector<Mat> &expansions)
+    {
+        // expansion constants are tuned for 0-255 intensities
+        if (frame.c == 1)
+        {
+            m_gray.reshape(frame.w, frame.h, 1);
+            for (int i = 0; i != frame.size(); ++i)
+                m_gray.data[i] = frame.data[i] * 255.0f;
+        }
+        else
+        {
+            rgb2gray(frame, m_gray);
+            m_gray.mult(255.0f);
+        }
+
+        pyramid.build(m_gray, levels, 32);
+
+        expansions.resize(size_t(pyramid.levels()));
+        for (int k = 0; k != pyramid.levels(); ++k)
+            polynomialExpansion(pyramid.level(k), expansions[size_t(k)], poly_n, poly_sigma);
+    }
+
+    void FarnebackFlow::compute(bool initial)
+    {
+        const int top = minimum(m_prev.levels(), m_curr.levels()) - 1;
+        const double regularization = 1e-3;
+
+        for (int k = top; k >= 0; --k)
+        {
+            Mat const &level = m_curr.level(k);
+
+            if (k != top)
+            {
+                std::swap(m_level_flow, m_coarse_flow);
+                scaleFlow(m_coarse_flow, m_level_flow, level.w, level.h, 0.5f);
+            }
+            else if (initial)
+            {
+                scaleFlow(m_flow, m_level_flow, level.w, level.h, float(1 << top));
+            }
+            else
+            {
+                m_level_flow.reshape(level.w, level.h, 2);
+                m_level_flow.zero();
+            }
+
+            Mat const &R0 = m_prev_R[size_t(k)];
+            Mat const &R1 = m_curr_R[size_t(k)];
+            farnebackUpdateMatrices(R0, R1, m_level_flow, m_M);
+
+            for (int i = 0; i != iterations; ++i)
+            {
+                // average the equations over the window and solve G d = h
+                boxfilter(m_M, m_blur, m_tmp, window);
+
+                const int cs = m_blur.channelSize();
+                parallelFor(0, level.h, [&](int begin, int end) {
+                    for (int j = begin * level.w; j != end * level.w; ++j)
+                    {
+                        const double g11 = m_blur.data[j];
+                        const double g12 = m_blur.data[j + cs];
+                        const double g22 = m_blur.data[j + 2 * cs];
+                        const double h1 = m_blur.data[j + 3 * cs];
+                        const double h2 = m_blur.data[j + 4 * cs];
+
+                        const double idet = 1.0 / (g11 * g22 - g12 * g12 + regularization);
+                        m_level_flow.data[j] = float((g11 * h2 - g12 * h1) * idet);
+                        m_level_flow.data[j + cs] = float((g22 * h1 - g12 * h2) * idet);
+                    }
+                }, 8);
+
+                if (i + 1 != iterations)
+                    farnebackUpdateMatrices(R0, R1, m_level_flow, m_M);
+            }
+        }
+
+        m_flow.reshape(m_level_flow.w, m_level_flow.h, 2);
+        memcpy(m_flow.data, m_level_flow.data, sizeof(float) * size_t(m_flow.size()));
+    }
+
+    void FarnebackFlow::opticalflow(const Mat &im, const Mat &prev, Mat &flow)
+    {
+        assert(im.w == prev.w && im.h == prev.h);
+
+        prepare(prev, m_prev, m_prev_R);
+        prepare(im, m_curr, m_curr_R);
+        compute(false);
+
+        flow.reshape(m_flow.w, m_flow.h, m_flow.c);
+        memcpy(flow.data, m_flow.data, sizeof(float) * size_t(m_flow.size()));
+
+        m_prev.swap(m_curr);
+        std::swap(m_prev_R, m_curr_R);
+        m_has_prev = true;
+        m_has_flow = true;
+    }
+
+    bool FarnebackFlow::push(const Mat &frame, Mat &flow)
+    {
+        prepare(frame, m_curr, m_curr_R);
+
+        if (m_has_prev && m_prev.level(0).w == m_curr.level(0).w && m_prev.level(0).h == m_curr.level(0).h)
+        {
+            compute(use_previous_flow && m_has_flow);
+
+            flow.reshape(m_flow.w, m_flow.h, m_flow.c);
+            memcpy(flow.data, m_flow.data, sizeof(float) * size_t(m_flow.size()));
+            m_has_flow = true;
+        }
+        else
+        {
+            m_has_flow = false;
+        }
+
+        const bool computed = m_has_flow;
+        m_prev.swap(m_curr);
+        std::swap(m_prev_R, m_curr_R);
+        m_has_prev = true;
+        return computed;
+    }
+
+    void FarnebackFlow::reset()
+    {
+        m_has_prev = false;
+        m_has_flow = false;
+    }
+
+    //
+    // Dense inverse search
+    //
+
+    // central differences, one sided on the borders. dst: 2 channels, d/dx and d/dy
+    static void inverseSearchGradients(Mat const &src, Mat &dst)
+    {
+        const int w = src.w;
+        const int h = src.h;
+        dst.reshape(w, h, 2);
+
+        parallelFor(0, h, [&](int begin, int end) {
+            for (int y = begin; y != end; ++y)
+            {
+                const float *r = src.data + y * w;
+                const float *up = src.data + maximum(y - 1, 0) * w;
+                const float *down = src.data + minimum(y + 1, h - 1) * w;
+                const float ky = (y == 0 || y == h - 1) ? 1.0f : 0.5f;
+                float *gx = dst.data + y * w;
+                float *gy = gx + dst.channelSize();
+
+                for (int x = 1; x < w - 1; ++x)
+                    gx[x] = (r[x + 1] - r[x - 1]) * 0.5f;
+                gx[0] = (w > 1) ? r[1] - r[0] : 0.0f;
+                gx[w - 1] = (w > 1) ? r[w - 1] - r[w - 2] : 0.0f;
+
+                for (int x = 0; x != w; ++x)
+                    gy[x] = (down[x] - up[x]) * ky;
+            }
+        }, 16);
+    }
+
+    // patch centers along an axis of size pixels, stride apart, the last one against the border.
+    // first[p] and last[p] - output: the range of patches covering pixel p.
+    static void inverseSearchGrid(int size, int half, int stride,
+                                  std::vector<int> &centers, std::vector<int> &first, std::vector<int> &last)
+    {
+        centers.clear();
+        const int end = size - 1 - half;
+        for (int c = half; c < end; c += stride)
+            centers.push_back(c);
+        centers.push_back(end);
+
+        first.resize(size_t(size));
+        last.resize(size_t(size));
+        const int count = int(centers.size());
+        int a = 0;
+        int b = 0;
+        for (int p = 0; p != size; ++p)
+        {
+            while (centers[size_t(a)] + half < p)
+                a++;
+            while (b != count && centers[size_t(b)] - half <= p)
+                b++;
+            first[size_t(p)] = a;
+            last[size_t(p)] = b;
+        }
+    }
+
+    // one bilinear sample, clamped to the image, at least 2 x 2
+    static inline float sampleBilinear(Mat const &im, float x, float y)
+    {
+        x = clampTo(x, 0.0f, float(im.w - 1));
+        y = clampTo(y, 0.0f, float(im.h - 1));
+        const int x0 = minimum(int(x), im.w - 2);
+        const int y0 = minimum(int(y), im.h - 2);
+        const float ax = x - float(x0);
+        const float ay = y - float(y0);
+
+        const float *r0 = im.data + y0 * im.w + x0;
+        const float *r1 = r0 + im.w;
+        const float top = r0[0] + (r0[1] - r0[0]) * ax;
+        const float bottom = r1[0] + (r1[1] - r1[0]) * ax;
+        return top + (bottom - top) * ay;
+    }
+
+    void InverseSearchFlow::prepare(const Mat &frame, Pyramid &pyramid, std::vector<Mat> &gradients)
+    {
+        // patches need room on the coarsest level
+        pyramid.reshape(frame.w, frame.h, 1, levels, 2 * patch);
+        if (frame.c == 1)
+            memcpy(pyramid.level(0).data, frame.data, sizeof(float) * size_t(frame.size()));
+        else
+            rgb2gray(frame, pyramid.level(0));
+        pyramid.update(0);
+
+        // only the searched levels need gradients
+        gradients.resize(size_t(pyramid.levels()));
+        for (int k = minimum(finest_level, pyramid.levels() - 1); k != pyramid.levels(); ++k)
+            inverseSearchGradients(pyramid.level(k), gradients[size_t(k)]);
+    }
+
+    void InverseSearchFlow::search(int k)
+    {
+        Mat const &I0 = m_prev.level(k);
+        Mat const &I1 = m_curr.level(k);
+        Mat const &G = m_prev_gradients[size_t(k)];
+        const int w = I0.w;
+        const int h = I0.h;
+        const int half = patch / 2;
+        const int size = patch;
+        const int area = size * size;
+
+        inverseSearchGrid(w, half, stride, m_xs, m_x_first, m_x_last);
+        inverseSearchGrid(h, half, stride, m_ys, m_y_first, m_y_last);
+
+        const int nx = int(m_xs.size());
+        const int ny = int(m_ys.size());
+        m_patches.reshape(nx, ny, 2);
+
+        // align every patch of the previous frame in the current one, starting from the flow at its center
+        parallelFor(0, ny, [&](int begin, int end) {
+            std::vector<float> templ(static_cast<size_t>(area));
+            std::vector<float> moved(static_cast<size_t>(area));
+            std::vector<float> ix(static_cast<size_t>(area));
+            std::vector<float> iy(static_cast<size_t>(area));
+
+            for (int j = begin; j != end; ++j)
+            {
+                const int cy = m_ys[size_t(j)];
+                for (int i = 0; i != nx; ++i)
+                {
+                    const int cx = m_xs[size_t(i)];
+
+                    // zero mean template, robust to brightness changes
+                    float mean = 0.0f;
+                    float gxx = 0.0f, gxy = 0.0f, gyy = 0.0f;
+                    for (int v = 0; v != size; ++v)
+                    {
+                        const int offset = (cy - half + v) * w + cx - half;
+                        const float *r = I0.data + offset;
+                        const float *gx = G.data + offset;
+                        const float *gy = gx + G.channelSize();
+                        for (int u = 0; u != size; ++u)
+                        {
+                            const int t = v * size + u;
+                            templ[size_t(t)] = r[u];
+                            ix[size_t(t)] = gx[u];
+                            iy[size_t(t)] = gy[u];
+                            mean += r[u];
+                            gxx += gx[u] * gx[u];
+                            gxy += gx[u] * gy[u];
+                            gyy += gy[u] * gy[u];
+                        }
+                    }
+                    mean /= float(area);
+                    for (float &t : templ)
+                        t -= mean;
+
+                    const int center = cy * w + cx;
+                    const float x0 = m_level_flow.data[center];
+                    const float y0 = m_level_flow.data[center + m_level_flow.channelSize()];
+                    float dx = x0;
+                    float dy = y0;
+
+                    // flat patches keep their guess
+                    const float det = gxx * gyy - gxy * gxy;
+                    if (det > 1e-6f * (gxx + gyy) * (gxx + gyy) && det > 0.0f)
+                    {
+                        const float idet = 1.0f / det;
+
+                        for (int iteration = 0; iteration != iterations; ++iteration)
+                        {
+                            sampleBilinearPatch(I1, float(cx) + dx, float(cy) + dy, half, moved.data());
+
+                            float moved_mean = 0.0f;
+                            for (int t = 0; t != area; ++t)
+                                moved_mean += moved[size_t(t)];
+                            moved_mean /= float(area);
+
+                            float bx = 0.0f, by = 0.0f;
+                            for (int t = 0; t != area; ++t)
+                            {
+                                const float e = templ[size_t(t)] - (moved[size_t(t)] - moved_mean);
+                                bx += e * ix[size_t(t)];
+                                by += e * iy[size_t(t)];
+                            }
+
+                            const float ex = (gyy * bx - gxy * by) * idet;
+                            const float ey = (gxx * by - gxy * bx) * idet;
+                            dx += ex;
+                            dy += ey;
+
+                            if (ex * ex + ey * ey < epsilon * epsilon)
+                                break;
+                        }
+
+                        // a search that wandered further than the patch size is most likely lost
+                        if ((dx - x0) * (dx - x0) + (dy - y0) * (dy - y0) > float(size * size))
+                        {
+                            dx = x0;
+                            dy = y0;
+                        }
+                    }
+
+                    m_patches.data[j * nx + i] = dx;
+                    m_patches.data[j * nx + i + m_patches.channelSize()] = dy;
+                }
+            }
+        }, 4);
+
+        // densify: every pixel averages the patches covering it, weighted by 1 / max(residual, 1 / 255)
+        const int cs = m_level_flow.channelSize();
+        const int ps = m_patches.channelSize();
+        parallelFor(0, h, [&](int begin, int end) {
+            for (int y = begin; y != end; ++y)
+            {
+                const int jb = m_y_first[size_t(y)];
+                const int je = m_y_last[size_t(y)];
+                const float *r0 = I0.data + y * w;
+                float *fx = m_level_flow.data + y * w;
+                float *fy = fx + cs;
+
+                for (int x = 0; x != w; ++x)
+                {
+                    const int ib = m_x_first[size_t(x)];
+                    const int ie = m_x_last[size_t(x)];
+
+                    float sx = 0.0f, sy = 0.0f, sw = 0.0f;
+                    for (int j = jb; j != je; ++j)
+                    {
+                        const float *px = m_patches.data + j * nx;
+                        const float *py = px + ps;
+                        for (int i = ib; i != ie; ++i)
+                        {
+                            const float d = sampleBilinear(I1, float(x) + px[i], float(y) + py[i]) - r0[x];
+                            const float weight = 1.0f / maximum(absolute(d), 1.0f / 255.0f);
+                            sx += weight * px[i];
+                            sy += weight * py[i];
+                            sw += weight;
+                        }
+                    }
+
+                    fx[x] = sx / sw;
+                    fy[x] = sy / sw;
+                }
+            }
+        }, 8);
+    }
+
+    void InverseSearchFlow::compute(bool initial)
+    {
+        assert(patch >= 3 && patch % 2 == 1);
+        assert(stride >= 1 && stride <= patch);
+
+        assert(m_curr.level(0).w >= patch && m_curr.level(0).h >= patch);
+
+        const int top = minimum(m_prev.levels(), m_curr.levels()) - 1;
+        const int finest = clampTo(finest_level, 0, top);
+
+        for (int k = top; k >= finest; --k)
+        {
+            Mat const &level = m_curr.level(k);
+
+            if (k != top)
+            {
+                std::swap(m_level_flow, m_coarse_flow);
+                scaleFlow(m_coarse_flow, m_level_flow, level.w, level.h, 0.5f);
+            }
+            else if (initial)
+            {
+                scaleFlow(m_flow, m_level_flow, level.w, level.h, float(1 << top));
+            }
+            else
+            {
+                m_level_flow.reshape(level.w, level.h, 2);
+                m_level_flow.zero();
+            }
+
+            search(k);
+        }
+
+        Mat const &base = m_curr.level(0);
+        if (finest == 0)
+        {
+            m_flow.reshape(m_level_flow.w, m_level_flow.h, 2);
+            memcpy(m_flow.data, m_level_flow.data, sizeof(float) * size_t(m_flow.size()));
+        }
+        else
+        {
+            scaleFlow(m_level_flow, m_flow, base.w, base.h, 1.0f / float(1 << finest));
+        }
+    }
+
+    void InverseSearchFlow::opticalflow(const Mat &im, const Mat &prev, Mat &flow)
+    {
+        assert(im.w == prev.w && im.h == prev.h);
+
+        prepare(prev, m_prev, m_prev_gradients);
+        prepare(im, m_curr, m_curr_gradients);
+        compute(false);
+
+        flow.reshape(m_flow.w, m_flow.h, m_flow.c);
+        memcpy(flow.data, m_flow.data, sizeof(float) * size_t(m_flow.size()));
+
+        m_prev.swap(m_curr);
+        std::swap(m_prev_gradients, m_curr_gradients);
+        m_has_prev = true;
+        m_has_flow = true;
+    }
+
+    bool InverseSearchFlow::push(const Mat &frame, Mat &flow)
+    {
+        prepare(frame, m_curr, m_curr_gradients);
+
+        if (m_has_prev && m_prev.level(0).w == m_curr.level(0).w && m_prev.level(0).h == m_curr.level(0).h)
+        {
+            compute(use_previous_flow && m_has_flow);
+
+            flow.reshape(m_flow.w, m_flow.h, m_flow.c);
+            memcpy(flow.data, m_flow.data, sizeof(float) * size_t(m_flow.size()));
+            m_has_flow = true;
+        }
+        else
+        {
+            m_has_flow = false;
+        }
+
+        const bool computed = m_has_flow;
+        m_prev.swap(m_curr);
+        std::swap(m_prev_gradients, m_curr_gradients);
+        m_has_prev = true;
+        return computed;
+    }
+
+    void InverseSearchFlow::reset()
+    {
+        m_has_prev = false;
+        m_has_flow = false;
     }
 
-} 
+}
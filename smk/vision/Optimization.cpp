@@ -1,222 +1,416 @@
 #include "Optimization.hpp"
+#include "../math/Mathematics.hpp"
 
+#include <algorithm>
 #include <cassert>
-#include <deque>
+#include <limits>
 
 namespace smk
 {
 
     long assignmentCost(const CostMatrix &cost, const Assignment &assignment)
     {
-        assert(cost.w == cost.h);
+        assert(int(assignment.size()) == cost.h);
         assert(assignment.size() > 0);
 
         CostT sum = 0;
         for (size_t i = 0; i < assignment.size(); ++i)
-            sum += cost(int(i), int(assignment[i]));
+            if (assignment[i] >= 0)
+                sum += cost(int(i), int(assignment[i]));
 
         return sum;
     }
 
-    inline void compute_slack(
-        const size_t x,
-        std::vector<CostT> &slack,
-        std::vector<CostT> &slackx,
-        const CostMatrix &cost,
-        const std::vector<CostT> &lx, const std::vector<CostT> &ly)
+    Assignment const &AssignmentSolver::maxCost(CostMatrix const &cost)
     {
-        const size_t cost_nc = cost.w;
+        return solve(cost, true);
+    }
 
-        for (size_t y = 0; y < cost_nc; ++y)
-            if (lx[x] + ly[y] - cost(int(x), int(y)) < slack[y])
-            {
-                slack[y] = lx[x] + ly[y] - cost(int(x), int(y));
-                slackx[y] = x;
-            }
+    Assignment const &AssignmentSolver::minCost(CostMatrix const &cost)
+    {
+        return solve(cost, false);
     }
 
-    Assignment assignmentMaxCost(const CostMatrix &cost)
+    Assignment const &AssignmentSolver::solve(CostMatrix const &cost, bool maximize)
     {
-        // This algorithm only works if the elements of the cost matrix can be reliably
-        // compared using operator==. However, comparing for equality with floating point
-        // numbers is not a stable operation. So you need to use an integer cost matrix.
-        assert(std::numeric_limits<CostMatrix::Type>::is_integer);
-        assert(cost.w == cost.h);
+        assert(cost.c == 1 || cost.size() == 0);
 
-        // I based the implementation of this algorithm on the description of the
-        // Hungarian algorithm on the following websites:
-        //     http://www.math.uwo.ca/~mdawes/courses/344/kuhn-munkres.pdf
-        //     http://www.topcoder.com/tc?module=Static&d1=tutorials&d2=hungarianAlgorithm
+        m_assignment.assign(size_t(cost.h), -1);
+        if (cost.size() == 0)
+            return m_assignment;
 
-        // Note that this is the fast O(n^3) version of the algorithm.
+        // rows are the smaller side, more rows than columns solve the transposed problem
+        const bool transposed = cost.h > cost.w;
+        const int n = transposed ? cost.w : cost.h;
+        const int m = transposed ? cost.h : cost.w;
+        const CostT sign = maximize ? -1 : 1;
 
-        if (cost.size() == 0)
-            return Assignment();
-
-        std::vector<CostT> lx, ly;
-        Assignment xy, yx;
-        std::vector<bool> S, T;
-        std::vector<CostT> slack;
-        std::vector<CostT> slackx;
-        std::vector<CostT> aug_path;
-
-        const size_t cost_nc = cost.w;
-        const size_t cost_nr = cost.h;
-
-        // Initially, nothing is matched.
-        xy.assign(cost_nc, -1);
-        yx.assign(cost_nc, -1);
-
-        // We maintain the following invariant:
-        //     Vertex x is matched to vertex xy[x] and
-        //     vertex y is matched to vertex yx[y].
-
-        //     A value of -1 means a vertex isn't matched to anything.  Moreover,
-        //     x corresponds to rows of the cost matrix and y corresponds to the
-        //     columns of the cost matrix.  So we are matching X to Y.
-
-        // Create an initial feasible labeling.  Moreover, in the following
-        // code we will always have:
-        //     for all valid x and y:  lx[x] + ly[y] >= cost(x,y)
-        lx.resize(cost_nc);
-        ly.assign(cost_nc, 0);
-        for (size_t x = 0; x < cost_nr; ++x)
-            lx[x] = cost.rowm(int(x)).max();
-
-        // Now grow the match set by picking edges from the equality subgraph until
-        // we have a complete matching.
-        for (size_t match_size = 0; match_size < cost_nc; ++match_size)
+        // nearly square problems get zero cost rows, their columns are the ones left out
+        const bool square = 2 * n >= m;
+        const int rows = square ? m : n;
+
+        m_cost.assign(size_t(rows) * size_t(m), 0);
+        for (int y = 0; y != cost.h; ++y)
         {
-            std::deque<CostT> q;
+            const CostT *src = cost.data + size_t(y) * size_t(cost.w);
+            if (transposed)
+                for (int x = 0; x != cost.w; ++x)
+                    m_cost[size_t(x) * size_t(m) + size_t(y)] = sign * src[x];
+            else
+                for (int x = 0; x != cost.w; ++x)
+                    m_cost[size_t(y) * size_t(m) + size_t(x)] = sign * src[x];
+        }
 
-            // Empty out the S and T sets
-            S.assign(cost_nc, false);
-            T.assign(cost_nc, false);
+        // m_row_of[j] is the row of column j, 0 based
+        if (square)
+            solveSquare(m);
+        else
+            solveRectangular(n, m);
 
-            // clear out old slack values
-            slack.assign(cost_nc, std::numeric_limits<CostT>::max());
-            slackx.resize(cost_nc);
+        for (int j = 0; j != m; ++j)
+        {
+            const int i = m_row_of[size_t(j)];
+            if (i < 0 || i >= n)
+                continue;
+
+            if (transposed)
+                m_assignment[size_t(j)] = i;
+            else
+                m_assignment[size_t(i)] = j;
+        }
 
-            // slack and slackx are maintained such that we always
-            // have the following (once they get initialized by compute_slack() below):
-            //     - for all y:
-            //         - let x == slackx[y]
-            //         - slack[y] == lx[x] + ly[y] - cost(x,y)
+        return m_assignment;
+    }
 
-            aug_path.assign(cost_nc, -1);
+    void AssignmentSolver::solveSquare(int n)
+    {
+        m_v.assign(size_t(n), 0);
+        m_row_of.assign(size_t(n), -1);
+        m_col_of.assign(size_t(n), -1);
+        m_matches.assign(size_t(n), 0);
+        m_free.resize(size_t(n));
+        m_columns.resize(size_t(n));
+        m_min.resize(size_t(n));
+        m_way.resize(size_t(n));
+
+        const CostT *c = m_cost.data();
+        CostT *v = m_v.data();
+        int *row_of = m_row_of.data(); // column -> row
+        int *col_of = m_col_of.data(); // row -> column
+        int *free = m_free.data();
+        int *columns = m_columns.data();
+        CostT *d = m_min.data();
+        int *pred = m_way.data();
+
+        if (n == 1)
+        {
+            row_of[0] = 0;
+            return;
+        }
 
-            for (size_t x = 0; x < cost_nc; ++x)
-            {
-                // If x is not matched to anything
-                if (xy[x] == -1)
-                {
-                    q.push_back(x);
-                    S[x] = true;
+        const CostT infinity = std::numeric_limits<CostT>::max();
+        auto at = [c, n](int i, int j) { return c[size_t(i) * size_t(n) + size_t(j)]; };
 
-                    compute_slack(x, slack, slackx, cost, lx, ly);
-                    break;
+        // column reduction, every column goes to its cheapest row, a row keeps its cheapest column
+        for (int j = n - 1; j >= 0; --j)
+        {
+            CostT lowest = at(0, j);
+            int best = 0;
+            for (int i = 1; i != n; ++i)
+                if (at(i, j) < lowest)
+                {
+                    lowest = at(i, j);
+                    best = i;
                 }
+            v[j] = lowest;
+
+            if (++m_matches[size_t(best)] == 1)
+            {
+                col_of[best] = j;
+                row_of[j] = best;
+            }
+            else if (v[j] < v[col_of[best]])
+            {
+                row_of[col_of[best]] = -1;
+                col_of[best] = j;
+                row_of[j] = best;
+            }
+        }
+
+        // reduction transfer, rows with a single column move their slack to that column's price
+        int free_count = 0;
+        for (int i = 0; i != n; ++i)
+        {
+            if (m_matches[size_t(i)] == 0)
+            {
+                free[free_count++] = i;
             }
+            else if (m_matches[size_t(i)] == 1)
+            {
+                const int j1 = col_of[i];
+                CostT lowest = infinity;
+                for (int j = 0; j != n; ++j)
+                    if (j != j1)
+                        lowest = minimum(lowest, at(i, j) - v[j]);
+                v[j1] -= lowest;
+            }
+        }
 
-            CostT x_start = 0;
-            CostT y_start = 0;
+        // augmenting row reduction, two passes
+        for (int pass = 0; pass != 2; ++pass)
+        {
+            const int previous_count = free_count;
+            free_count = 0;
 
-            // Find an augmenting path.
-            bool found_augmenting_path = false;
-            while (!found_augmenting_path)
+            int k = 0;
+            while (k < previous_count)
             {
-                while (q.size() > 0 && !found_augmenting_path)
+                const int i = free[k++];
+
+                // lowest and second lowest reduced cost of the row
+                CostT first = at(i, 0) - v[0];
+                CostT second = infinity;
+                int j1 = 0;
+                int j2 = 0;
+                for (int j = 1; j != n; ++j)
                 {
-                    const CostT x = q.front();
-                    q.pop_front();
-                    for (size_t y = 0; y < cost_nc; ++y)
+                    const CostT h = at(i, j) - v[j];
+                    if (h < second)
                     {
-                        if (cost(int(x), int(y)) == lx[x] + ly[y] && !T[y])
+                        if (h >= first)
                         {
-                            // if vertex y isn't matched with anything
-                            if (yx[y] == -1)
-                            {
-                                y_start = y;
-                                x_start = x;
-                                found_augmenting_path = true;
-                                break;
-                            }
-
-                            T[y] = true;
-                            q.push_back(yx[y]);
-
-                            aug_path[yx[y]] = x;
-                            S[yx[y]] = true;
-                            compute_slack(yx[y], slack, slackx, cost, lx, ly);
+                            second = h;
+                            j2 = j;
+                        }
+                        else
+                        {
+                            second = first;
+                            first = h;
+                            j2 = j1;
+                            j1 = j;
                         }
                     }
                 }
 
-                if (found_augmenting_path)
-                    break;
-
-                // Since we didn't find an augmenting path we need to improve the
-                // feasible labeling stored in lx and ly.  We also need to keep the
-                // slack updated accordingly.
-                CostT delta = std::numeric_limits<CostT>::max();
-                for (size_t i = 0; i < T.size(); ++i)
+                int i0 = row_of[j1];
+                if (first < second)
                 {
-                    if (!T[i])
-                        delta = std::min(delta, slack[i]);
+                    // make j1 as expensive as the second choice, the row takes it
+                    v[j1] -= second - first;
                 }
-                for (size_t i = 0; i < T.size(); ++i)
+                else if (i0 >= 0)
                 {
-                    if (S[i])
-                        lx[i] -= delta;
+                    // a tie, take the second column instead
+                    j1 = j2;
+                    i0 = row_of[j2];
+                }
 
-                    if (T[i])
-                        ly[i] += delta;
+                col_of[i] = j1;
+                row_of[j1] = i;
+
+                if (i0 >= 0)
+                {
+                    // the displaced row is retried now when the price went up, next pass otherwise
+                    col_of[i0] = -1;
+                    if (first < second)
+                        free[--k] = i0;
                     else
-                        slack[i] -= delta;
+                        free[free_count++] = i0;
                 }
+            }
+        }
+
+        // augmentation, a Dijkstra search from every row still free
+        for (int f = 0; f != free_count; ++f)
+        {
+            const int start = free[f];
+            for (int j = 0; j != n; ++j)
+            {
+                d[j] = at(start, j) - v[j];
+                pred[j] = start;
+                columns[j] = j;
+            }
+
+            // columns[0, low) are scanned, [low, up) are at the current minimum distance, [up, n) are left
+            int low = 0;
+            int up = 0;
+            int last = 0;
+            int end = -1;
+            CostT lowest = 0;
 
-                q.clear();
-                for (size_t y = 0; y < cost_nc; ++y)
+            while (end < 0)
+            {
+                if (up == low)
                 {
-                    if (!T[y] && slack[y] == 0)
+                    last = low;
+                    lowest = d[columns[up++]];
+                    for (int k = up; k != n; ++k)
                     {
-                        // if vertex y isn't matched with anything
-                        if (yx[y] == -1)
+                        const int j = columns[k];
+                        const CostT h = d[j];
+                        if (h <= lowest)
+                        {
+                            if (h < lowest)
+                            {
+                                up = low;
+                                lowest = h;
+                            }
+                            columns[k] = columns[up];
+                            columns[up++] = j;
+                        }
+                    }
+
+                    for (int k = low; k != up; ++k)
+                        if (row_of[columns[k]] < 0)
                         {
-                            x_start = slackx[y];
-                            y_start = y;
-                            found_augmenting_path = true;
+                            end = columns[k];
                             break;
                         }
-                        else
+                }
+
+                if (end < 0)
+                {
+                    const int j1 = columns[low++];
+                    const int i = row_of[j1];
+                    const CostT h = at(i, j1) - v[j1] - lowest;
+
+                    for (int k = up; k != n; ++k)
+                    {
+                        const int j = columns[k];
+                        const CostT distance = at(i, j) - v[j] - h;
+                        if (distance < d[j])
                         {
-                            T[y] = true;
-                            if (!S[yx[y]])
+                            pred[j] = i;
+                            if (distance == lowest)
                             {
-                                q.push_back(yx[y]);
-
-                                aug_path[yx[y]] = slackx[y];
-                                S[yx[y]] = true;
-                                compute_slack(yx[y], slack, slackx, cost, lx, ly);
+                                if (row_of[j] < 0)
+                                {
+                                    end = j;
+                                    break;
+                                }
+                                columns[k] = columns[up];
+                                columns[up++] = j;
                             }
+                            d[j] = distance;
                         }
                     }
                 }
-            } // end while (!found_augmenting_path)
+            }
 
-            // Flip the edges along the augmenting path.  This means we will add one more
-            // item to our matching.
-            for (CostT cx = x_start, cy = y_start, ty;
-                 cx != -1;
-                 cx = aug_path[cx], cy = ty)
+            // update the prices of the scanned columns
+            for (int k = 0; k != last; ++k)
             {
-                ty = xy[cx];
-                yx[cy] = cx;
-                xy[cx] = cy;
+                const int j = columns[k];
+                v[j] += d[j] - lowest;
             }
+
+            // flip the path
+            int i;
+            do
+            {
+                i = pred[end];
+                row_of[end] = i;
+                const int next = col_of[i];
+                col_of[i] = end;
+                end = next;
+            } while (i != start);
         }
+    }
+
+    void AssignmentSolver::solveRectangular(int n, int m)
+    {
+        // 1 based, column 0 is the virtual start of every search
+        const CostT infinity = std::numeric_limits<CostT>::max();
+        m_u.assign(size_t(n + 1), 0);
+        m_v.assign(size_t(m + 1), 0);
+        m_row_of.assign(size_t(m + 1), 0);
+        m_way.assign(size_t(m + 1), 0);
+        m_min.resize(size_t(m + 1));
+        m_used.resize(size_t(m + 1));
+
+        CostT *u = m_u.data();
+        CostT *v = m_v.data();
+        CostT *lowest = m_min.data();
+        int *row_of = m_row_of.data();
+        int *way = m_way.data();
+        char *used = m_used.data();
+
+        for (int i = 1; i <= n; ++i)
+        {
+            // shortest augmenting path from row i, dijkstra on the reduced costs
+            row_of[0] = i;
+            int j0 = 0;
+            std::fill(lowest, lowest + m + 1, infinity);
+            std::fill(used, used + m + 1, char(0));
+
+            do
+            {
+                used[j0] = 1;
+                const int i0 = row_of[j0];
+                const CostT *row = m_cost.data() + size_t(i0 - 1) * size_t(m) - 1;
+                const CostT ui = u[i0];
+
+                CostT delta = infinity;
+                int j1 = 0;
+                for (int j = 1; j <= m; ++j)
+                {
+                    if (used[j])
+                        continue;
 
-        return xy;
+                    const CostT current = row[j] - ui - v[j];
+                    if (current < lowest[j])
+                    {
+                        lowest[j] = current;
+                        way[j] = j0;
+                    }
+                    if (lowest[j] < delta)
+                    {
+                        delta = lowest[j];
+                        j1 = j;
+                    }
+                }
+
+                for (int j = 0; j <= m; ++j)
+                {
+                    if (used[j])
+                    {
+                        u[row_of[j]] += delta;
+                        v[j] -= delta;
+                    }
+                    else
+                    {
+                        lowest[j] -= delta;
+                    }
+                }
+
+                j0 = j1;
+            } while (row_of[j0] != 0);
+
+            // flip the path
+            do
+            {
+                const int j1 = way[j0];
+                row_of[j0] = row_of[j1];
+                j0 = j1;
+            } while (j0 != 0);
+        }
+
+        // back to 0 based columns and rows, -1 for free columns
+        for (int j = 0; j != m; ++j)
+            row_of[j] = row_of[j + 1] - 1;
+        m_row_of.resize(size_t(m));
+    }
+
+    Assignment assignmentMaxCost(const CostMatrix &cost)
+    {
+        AssignmentSolver solver;
+        return solver.maxCost(cost);
+    }
+
+    Assignment assignmentMinCost(const CostMatrix &cost)
+    {
+        AssignmentSolver solver;
+        return solver.minCost(cost);
     }
 
 }
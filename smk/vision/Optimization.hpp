@@ -6,17 +6,55 @@
 
 namespace smk
 {
-    // this code was copied from dlib
-    // http://dlib.net/dlib/optimization/max_cost_assignment.h.html
     using CostT = long long;
     using Assignment = std::vector<CostT>;
     using CostMatrix = Matl;
 
 
-    // calculates the actual cost for the input assigment
+    // calculates the actual cost for the input assigment, unassigned (-1) rows are skipped
     long assignmentCost(const CostMatrix &cost, const Assignment &assignment);
 
+    //
+    // Linear assignment of rows to columns, rectangular cost matrices are supported.
+    // Square problems (and nearly square ones, padded with zero cost rows) run LAPJV:
+    // column reduction, reduction transfer and two augmenting row reduction passes assign most
+    // rows cheaply, the rows left free are added with Dijkstra shortest augmenting paths.
+    // R. Jonker, A. Volgenant, A shortest augmenting path algorithm for dense and sparse linear
+    // assignment problems, Computing 38, 1987.
+    // Very unbalanced problems (twice as many columns as rows or more) skip the padding and add every row with a
+    // shortest augmenting path over row and column potentials, O(n^2 m) for n <= m, the Hungarian algorithm
+    // as written in https://cp-algorithms.com/graph/hungarian-algorithm.html
+    // The workspace is kept between calls, reuse one solver per tracker to avoid allocations every frame.
+    // Costs are integers so comparisons are exact.
+    //
+    class AssignmentSolver
+    {
+    public:
+        // returns: assignment[row] = column, -1 for the rows left out when there are more rows than columns.
+        Assignment const& maxCost(CostMatrix const& cost);
+        Assignment const& minCost(CostMatrix const& cost);
+
+    private:
+        Assignment const& solve(CostMatrix const& cost, bool maximize);
+        void solveSquare(int n);
+        void solveRectangular(int n, int m);
+
+        std::vector<CostT> m_cost; // rows x cols, rows <= cols, negated when maximizing
+        std::vector<CostT> m_u;
+        std::vector<CostT> m_v;
+        std::vector<CostT> m_min;
+        std::vector<int> m_row_of;
+        std::vector<int> m_col_of;
+        std::vector<int> m_way;
+        std::vector<int> m_free;
+        std::vector<int> m_columns;
+        std::vector<int> m_matches;
+        std::vector<char> m_used;
+        Assignment m_assignment;
+    };
+
     // Hungarian algorithm for max cost assigment
     Assignment assignmentMaxCost(const CostMatrix &cost);
+    Assignment assignmentMinCost(const CostMatrix &cost);
 
 }
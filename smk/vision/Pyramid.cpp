@@ -0,0 +1,294 @@
+#include "Pyramid.hpp"
+#include "../math/Mathematics.hpp"
+
+#include <cassert>
+#include <cstring>
+
+namespace smk
+{
+    // the scratch buffer only grows, one buffer serves every level of a pyramid
+    static float *scratch(Mat &tmp, int size)
+    {
+        if (tmp.size() < size)
+            tmp.reshape(size, 1, 1);
+        return tmp.data;
+    }
+
+    void pyramidDown(Mat const &src, Mat &dst, Mat &tmp)
+    {
+        assert(src.w > 0 && src.h > 0);
+
+        const int dw = (src.w + 1) / 2;
+        const int dh = (src.h + 1) / 2;
+        const float scale = 1.0f / 16.0f;
+
+        dst.reshape(dw, dh, src.c);
+        float *const buffer = scratch(tmp, dw * src.h);
+
+        const int last_x = src.w - 1;
+        const int last_y = src.h - 1;
+
+        // output columns whose 5 taps are all inside the row
+        const int inner_begin = minimum(1, dw);
+        const int inner_end = clampTo(last_x >= 2 ? (last_x - 2) / 2 + 1 : 0, inner_begin, dw);
+
+        auto clamped = [last_x](const float *r, int x) {
+            const int sx = 2 * x;
+            return r[clampTo(sx - 2, 0, last_x)] + r[clampTo(sx + 2, 0, last_x)] +
+                   4.0f * (r[clampTo(sx - 1, 0, last_x)] + r[clampTo(sx + 1, 0, last_x)]) +
+                   6.0f * r[sx];
+        };
+
+        for (int k = 0; k != src.c; ++k)
+        {
+            const float *s = src.data + k * src.channelSize();
+            float *d = dst.data + k * dst.channelSize();
+
+            // horizontal pass, src.h rows of dw samples
+            for (int y = 0; y != src.h; ++y)
+            {
+                const float *r = s + y * src.w;
+                float *t = buffer + y * dw;
+
+                int x = 0;
+                for (; x < inner_begin; ++x)
+                    t[x] = clamped(r, x) * scale;
+
+                for (; x < inner_end; ++x)
+                {
+                    const float *c = r + 2 * x;
+                    t[x] = (c[-2] + c[2] + 4.0f * (c[-1] + c[1]) + 6.0f * c[0]) * scale;
+                }
+
+                for (; x < dw; ++x)
+                    t[x] = clamped(r, x) * scale;
+            }
+
+            // vertical pass, one output row at a time
+            for (int y = 0; y != dh; ++y)
+            {
+                const int sy = 2 * y;
+                const float *t0 = buffer + clampTo(sy - 2, 0, last_y) * dw;
+                const float *t1 = buffer + clampTo(sy - 1, 0, last_y) * dw;
+                const float *t2 = buffer + sy * dw;
+                const float *t3 = buffer + clampTo(sy + 1, 0, last_y) * dw;
+                const float *t4 = buffer + clampTo(sy + 2, 0, last_y) * dw;
+                float *o = d + y * dw;
+
+                for (int x = 0; x != dw; ++x)
+                    o[x] = (t0[x] + t4[x] + 4.0f * (t1[x] + t3[x]) + 6.0f * t2[x]) * scale;
+            }
+        }
+    }
+
+    void pyramidDown(Mat const &src, Mat &dst)
+    {
+        Mat tmp;
+        pyramidDown(src, dst, tmp);
+    }
+
+    void pyramidUp(Mat const &src, Mat &dst, Mat &tmp, int w, int h)
+    {
+        assert(src.w > 0 && src.h > 0);
+        assert(w == 2 * src.w || w == 2 * src.w - 1);
+        assert(h == 2 * src.h || h == 2 * src.h - 1);
+
+        dst.reshape(w, h, src.c);
+        float *const buffer = scratch(tmp, w * src.h);
+
+        const int last_x = src.w - 1;
+        const int last_y = src.h - 1;
+
+        // the upsampled image is zero stuffed and filtered with 2 * [1 4 6 4 1] / 16
+        // even samples:   (s[i - 1] + 6 s[i] + s[i + 1]) / 8
+        // odd samples:    (s[i] + s[i + 1]) / 2
+        for (int k = 0; k != src.c; ++k)
+        {
+            const float *s = src.data + k * src.channelSize();
+            float *d = dst.data + k * dst.channelSize();
+
+            for (int y = 0; y != src.h; ++y)
+            {
+                const float *r = s + y * src.w;
+                float *t = buffer + y * w;
+
+                for (int x = 0; x < w; ++x)
+                {
+                    const int i = x / 2;
+                    if (x % 2 == 0)
+                        t[x] = (r[clampTo(i - 1, 0, last_x)] + 6.0f * r[i] + r[clampTo(i + 1, 0, last_x)]) * 0.125f;
+                    else
+                        t[x] = (r[i] + r[clampTo(i + 1, 0, last_x)]) * 0.5f;
+                }
+            }
+
+            for (int y = 0; y != h; ++y)
+            {
+                const int i = y / 2;
+                float *o = d + y * w;
+
+                if (y % 2 == 0)
+                {
+                    const float *t0 = buffer + clampTo(i - 1, 0, last_y) * w;
+                    const float *t1 = buffer + i * w;
+                    const float *t2 = buffer + clampTo(i + 1, 0, last_y) * w;
+
+                    for (int x = 0; x != w; ++x)
+                        o[x] = (t0[x] + 6.0f * t1[x] + t2[x]) * 0.125f;
+                }
+                else
+                {
+                    const float *t0 = buffer + i * w;
+                    const float *t1 = buffer + clampTo(i + 1, 0, last_y) * w;
+
+                    for (int x = 0; x != w; ++x)
+                        o[x] = (t0[x] + t1[x]) * 0.5f;
+                }
+            }
+        }
+    }
+
+    void pyramidUp(Mat const &src, Mat &dst, int w, int h)
+    {
+        Mat tmp;
+        pyramidUp(src, dst, tmp, w, h);
+    }
+
+    void Pyramid::build(Mat const &src, int levels, int min_size)
+    {
+        reshape(src.w, src.h, src.c, levels, min_size);
+        memcpy(m_levels[0].data, src.data, size_t(src.size()) * sizeof(float));
+        update(0);
+    }
+
+    void Pyramid::reshape(int w, int h, int c, int levels, int min_size)
+    {
+        assert(w > 0 && h > 0 && c > 0 && levels > 0);
+
+        int count = 1;
+        int total = w * h * c;
+        int lw = w;
+        int lh = h;
+        while (count < levels)
+        {
+            lw = (lw + 1) / 2;
+            lh = (lh + 1) / 2;
+            if (lw < min_size || lh < min_size)
+                break;
+
+            total += lw * lh * c;
+            count++;
+        }
+
+        m_storage.reshape(total, 1, 1);
+
+        // the largest horizontal pass is the first level down or the last level up
+        scratch(m_tmp, maximum(((w + 1) / 2) * h, w * ((h + 1) / 2)));
+        m_levels.resize(size_t(count));
+
+        int offset = 0;
+        lw = w;
+        lh = h;
+        for (int i = 0; i != count; ++i)
+        {
+            m_levels[size_t(i)] = m_storage.view(offset, lw, lh, c);
+            offset += lw * lh * c;
+            lw = (lw + 1) / 2;
+            lh = (lh + 1) / 2;
+        }
+
+        m_laplacian.clear();
+    }
+
+    void Pyramid::update(int from)
+    {
+        assert(from >= 0 && from < levels());
+
+        for (int i = from; i < levels() - 1; ++i)
+            pyramidDown(level(i), level(i + 1), m_tmp);
+    }
+
+    void Pyramid::buildLaplacian()
+    {
+        assert(levels() > 0);
+
+        m_laplacian_storage.reshape(m_storage.w, 1, 1);
+        m_laplacian.resize(m_levels.size());
+
+        int offset = 0;
+        for (size_t i = 0; i != m_levels.size(); ++i)
+        {
+            Mat const &g = m_levels[i];
+            m_laplacian[i] = m_laplacian_storage.view(offset, g.w, g.h, g.c);
+            offset += g.size();
+        }
+
+        const int last = levels() - 1;
+        for (int i = 0; i != last; ++i)
+        {
+            Mat const &g = level(i);
+            Mat &l = laplacian(i);
+
+            pyramidUp(level(i + 1), l, m_tmp, g.w, g.h);
+            for (int j = 0; j != g.size(); ++j)
+                l.data[j] = g.data[j] - l.data[j];
+        }
+
+        memcpy(laplacian(last).data, level(last).data, size_t(level(last).size()) * sizeof(float));
+    }
+
+    void Pyramid::collapse(Mat &dst)
+    {
+        assert(!m_laplacian.empty());
+
+        const int last = levels() - 1;
+        Mat current = laplacian(last).clone();
+        Mat up;
+
+        for (int i = last - 1; i >= 0; --i)
+        {
+            Mat const &l = laplacian(i);
+            pyramidUp(current, up, m_tmp, l.w, l.h);
+            for (int j = 0; j != l.size(); ++j)
+                up.data[j] += l.data[j];
+            std::swap(current, up);
+        }
+
+        dst = current;
+    }
+
+    int Pyramid::levels() const { return int(m_levels.size()); }
+
+    Mat &Pyramid::level(int i)
+    {
+        assert(i >= 0 && i < levels());
+        return m_levels[size_t(i)];
+    }
+
+    Mat const &Pyramid::level(int i) const
+    {
+        assert(i >= 0 && i < levels());
+        return m_levels[size_t(i)];
+    }
+
+    Mat &Pyramid::laplacian(int i)
+    {
+        assert(i >= 0 && i < int(m_laplacian.size()));
+        return m_laplacian[size_t(i)];
+    }
+
+    Mat const &Pyramid::laplacian(int i) const
+    {
+        assert(i >= 0 && i < int(m_laplacian.size()));
+        return m_laplacian[size_t(i)];
+    }
+
+    void Pyramid::swap(Pyramid &other)
+    {
+        std::swap(m_storage, other.m_storage);
+        std::swap(m_laplacian_storage, other.m_laplacian_storage);
+        std::swap(m_levels, other.m_levels);
+        std::swap(m_laplacian, other.m_laplacian);
+        std::swap(m_tmp, other.m_tmp);
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Mat.hpp"
+
+#include <vector>
+
+namespace smk
+{
+    // Downsample an image by 2 with the 5 tap binomial filter [1 4 6 4 1] / 16.
+    // image src: image to downsample.
+    // dst - output: ((src.w + 1) / 2) x ((src.h + 1) / 2) image.
+    // tmp - scratch buffer for the horizontal pass, only reallocated when too small.
+    void pyramidDown(Mat const& src, Mat& dst, Mat& tmp);
+    void pyramidDown(Mat const& src, Mat& dst);
+
+    // Upsample an image by 2, the counterpart of pyramidDown.
+    // image src: image to upsample.
+    // int w, h: output size, 2 * src.w or 2 * src.w - 1 (same for h).
+    // dst - output: upsampled image.
+    // tmp - scratch buffer for the horizontal pass, only reallocated when too small.
+    void pyramidUp(Mat const& src, Mat& dst, Mat& tmp, int w, int h);
+    void pyramidUp(Mat const& src, Mat& dst, int w, int h);
+
+    //
+    // Gaussian (and Laplacian) image pyramid.
+    // All the levels live in one allocation, and the filter scratch in another sized for the largest level,
+    // both kept while the pyramid is rebuilt with the same source size, so building one every frame doesn't allocate.
+    // Levels are views over that allocation, they stay valid until the next build with a different size.
+    //
+    class Pyramid
+    {
+    public:
+        // Builds the gaussian pyramid, level 0 is a copy of src.
+        // image src: the base image.
+        // int levels: maximum number of levels.
+        // int min_size: stop before a level would be smaller than this.
+        void build(Mat const& src, int levels, int min_size = 8);
+
+        // Allocates the levels for a w x h x c base without filling them.
+        // Write the base into level(0) and call update(), saves the copy in build.
+        void reshape(int w, int h, int c, int levels, int min_size = 8);
+
+        // Recomputes the gaussian levels after level from.
+        // Use it after changing a level in place.
+        void update(int from = 0);
+
+        // Builds the laplacian levels from the gaussian ones
+        // L(i) = G(i) - up(G(i + 1)), the last laplacian level is the last gaussian level.
+        void buildLaplacian();
+
+        // Rebuilds the base image from the laplacian levels.
+        void collapse(Mat& dst);
+
+        int levels() const;
+        Mat& level(int i);
+        Mat const& level(int i) const;
+        Mat& laplacian(int i);
+        Mat const& laplacian(int i) const;
+
+        // exchange levels with another pyramid, for previous / current frame double buffering
+        void swap(Pyramid& other);
+
+    private:
+        Mat m_storage;
+        Mat m_laplacian_storage;
+        std::vector<Mat> m_levels;
+        std::vector<Mat> m_laplacian;
+        Mat m_tmp;
+    };
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+namespace smk
+{
+    //
+    // Union find over pixel indexes, used by the labelling passes (connectedComponents, canny hysteresis).
+    // parent[i] == i marks a root, the root is the smallest index of its set,
+    // so every pixel points to an index before it and roots come in raster order.
+    //
+
+    // root of i, halving the path on the way
+    inline int unionFindRoot(int* parent, int i)
+    {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    // root of i without writing, safe while other threads read the same parents
+    inline int unionFindRootConst(int const* parent, int i)
+    {
+        while (parent[i] != i)
+            i = parent[i];
+        return i;
+    }
+
+    // joins the sets of a and b, merged(root, absorbed) runs when two different sets became one
+    template <typename Merged>
+    inline void unionFindJoin(int* parent, int a, int b, Merged merged)
+    {
+        a = unionFindRoot(parent, a);
+        b = unionFindRoot(parent, b);
+        if (a == b)
+            return;
+
+        if (b < a)
+        {
+            const int t = a;
+            a = b;
+            b = t;
+        }
+        parent[b] = a;
+        merged(a, b);
+    }
+
+    inline void unionFindJoin(int* parent, int a, int b)
+    {
+        unionFindJoin(parent, a, b, [](int, int) {});
+    }
+}
@@ -1,17 +1,37 @@
 #include <UnitTest.hpp>
 
 #include <vision/Mat.hpp>
+#include <vision/MatFile.hpp>
+#include <vision/Decomposition.hpp>
+#include <vision/FixedMat.hpp>
 #include <vision/Features.hpp>
 #include <vision/Optimization.hpp>
 #include <vision/Image.hpp>
+#include <vision/ImageIO.hpp>
 #include <vision/Opticalflow.hpp>
 #include <vision/Drawing.hpp>
 #include <vision/Filter.hpp>
+#include <vision/Pyramid.hpp>
+#include <vision/Integral.hpp>
+#include <vision/Components.hpp>
+#include <vision/Morphology.hpp>
+#include <vision/Histogram.hpp>
 
 #include <math/Mathematics.hpp>
 #include <File.hpp>
+#include <threading/Parallel.hpp>
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 #include <cassert>
 #include <cassert>
 
@@ -272,6 +292,24 @@ bool sameMat(const Mat &a, const Mat &b)
     return true;
 }
 
+// same size and every element within epsilon, for double precision results
+static bool near(Matd const &a, Matd const &b, double const epsilon)
+{
+    if (a.w != b.w || a.h != b.h || a.c != b.c)
+    {
+        printf("Expected %d x %d x %d matrix, got %d x %d x %d\n", b.w, b.h, b.c, a.w, a.h, a.c);
+        return false;
+    }
+
+    for (int i = 0; i != a.size(); ++i)
+        if (!equivalent(a.data[i], b.data[i], epsilon))
+        {
+            printf("Mismatch (%d) %g %g\n", i, a.data[i], b.data[i]);
+            return false;
+        }
+
+    return true;
+}
 
 static bool sameChannel(Mat const &a, Mat const &b, int const ac, int const bc)
 {
@@ -503,6 +541,140 @@ TEST_BEGIN(TestMatInvert)
 }
 TEST_END(TestMatInvert)
 
+TEST_BEGIN(TestDecomposition)
+{
+    const int n = 12;
+    const int rhs = 5;
+
+    Matd A(n, n);
+    Matd B(rhs, n);
+    for (int i = 0; i != A.size(); ++i)
+        A.data[i] = double(rand() % 200 - 100) / 10.0;
+    for (int i = 0; i != B.size(); ++i)
+        B.data[i] = double(rand() % 200 - 100) / 10.0;
+
+    // lu, factor once and solve several right hand sides, in place
+    LUDecompositiond lu(A);
+    TEST_ASSERT(lu.valid());
+    Matd X = B.clone();
+    lu.solve(X, X);
+    TEST_ASSERT(near(Matd::mmult(A, X), B, 1e-9));
+    TEST_ASSERT(near(Matd::mmult(A, lu.inverse()), Matd::makeIdentity(n, n), 1e-9));
+
+    Matd two = Matd::makeIdentity(3, 3);
+    two(1, 1) = 2.0;
+    two(2, 2) = -4.0;
+    TEST_ASSERT(equivalent(LUDecompositiond(two).determinant(), -8.0, 1e-12));
+
+    Matd singular = A.clone();
+    for (int j = 0; j != n; ++j)
+        singular(3, j) = 2.0 * singular(1, j);
+    TEST_ASSERT(!LUDecompositiond(singular).valid());
+    TEST_ASSERT(singular.invert().size() == 0);
+
+    // cholesky of A^T A + I
+    Matd S = Matd::mmult(A.transpose(), A);
+    for (int i = 0; i != n; ++i)
+        S(i, i) += 1.0;
+
+    Matd factored = S.clone();
+    CholeskyDecompositiond cholesky;
+    TEST_ASSERT(cholesky.computeInPlace(factored));
+    TEST_ASSERT(cholesky.factors().data == factored.data);
+    TEST_ASSERT(near(Matd::mmult(S, cholesky.solve(B)), B, 1e-9));
+
+    Matd indefinite = Matd::makeIdentity(2, 2);
+    indefinite(1, 1) = -1.0;
+    TEST_ASSERT(!CholeskyDecompositiond(indefinite).valid());
+
+    // qr least squares, the residual is orthogonal to the columns of M
+    const int rows = 300;
+    Matd M(4, rows);
+    Matd b(1, rows);
+    for (int i = 0; i != rows; ++i) {
+        const double x = double(i) / 10.0;
+        M(i, 0) = 1.0;
+        M(i, 1) = x;
+        M(i, 2) = x * x;
+        M(i, 3) = x * x * x;
+        b(i, 0) = 2.0 - x + 0.5 * x * x + 0.01 * double(rand() % 100 - 50);
+    }
+
+    QRDecompositiond qr(M);
+    TEST_ASSERT(qr.valid());
+    Matd a = qr.solve(b);
+    TEST_ASSERT(a.w == 1 && a.h == 4);
+    TEST_ASSERT(near(a, Matd::llsSolve(M, b), 1e-12));
+
+    Matd residual = Matd::sub(Matd::mmult(M, a), b);
+    Matd normal = Matd::mmult(M.transpose(), residual);
+    for (int i = 0; i != normal.size(); ++i)
+        TEST_ASSERT(absolute(normal.data[i]) < 1e-6);
+    TEST_ASSERT(equivalent(a(2, 0), 0.5, 0.01));
+
+    for (int i = 0; i != rows; ++i)
+        M(i, 3) = M(i, 1);
+    TEST_ASSERT(!QRDecompositiond(M).valid());
+    TEST_ASSERT(Matd::llsSolve(M, b).size() == 0);
+}
+TEST_END(TestDecomposition)
+
+TEST_BEGIN(TestFixedMat)
+{
+    for (int i = 0; i != 20; ++i) {
+        Mat2d m2;
+        Mat3d m3;
+        Mat4d m4;
+        for (int j = 0; j != 4; ++j) m2[j] = double(rand() % 200 - 100) / 10.0;
+        for (int j = 0; j != 9; ++j) m3[j] = double(rand() % 200 - 100) / 10.0;
+        for (int j = 0; j != 16; ++j) m4[j] = double(rand() % 200 - 100) / 10.0;
+
+        // closed forms agree with the LU decomposition
+        Mat2d i2;
+        Mat3d i3;
+        Mat4d i4;
+        TEST_ASSERT(inverse(m2, i2) && near(i2.mat(), m2.mat().invert(), 1e-9));
+        TEST_ASSERT(inverse(m3, i3) && near(i3.mat(), m3.mat().invert(), 1e-9));
+        TEST_ASSERT(inverse(m4, i4) && near(i4.mat(), m4.mat().invert(), 1e-9));
+
+        TEST_ASSERT(equivalent(determinant(m2), LUDecompositiond(m2.mat()).determinant(), 1e-9));
+        TEST_ASSERT(equivalent(determinant(m3), LUDecompositiond(m3.mat()).determinant(), 1e-9));
+        TEST_ASSERT(equivalent(determinant(m4), LUDecompositiond(m4.mat()).determinant(), 1e-6));
+
+        TEST_ASSERT(near((m4 * i4).mat(), Mat4d::identity().mat(), 1e-9));
+        TEST_ASSERT(near((m3 * transpose(m3)).mat(), Matd::mmult(m3.mat(), m3.mat().transpose()), 1e-12));
+
+        // symmetric eigenvalues: sum is the trace, product is the determinant
+        Mat3d s = m3 * transpose(m3);
+        double e0, e1, e2;
+        eigenValuesSymmetric(s, e0, e1, e2);
+        TEST_ASSERT(e0 <= e1 && e1 <= e2);
+        TEST_ASSERT(equivalent(e0 + e1 + e2, trace(s), 1e-6));
+        TEST_ASSERT(equivalent(e0 * e1 * e2, determinant(s), 1e-6 * absolute(determinant(s)) + 1e-6));
+
+        Mat2d s2 = m2 * transpose(m2);
+        double f0, f1;
+        eigenValues(s2, f0, f1);
+        TEST_ASSERT(equivalent(f0 + f1, trace(s2), 1e-9));
+        TEST_ASSERT(equivalent(f0 * f1, determinant(s2), 1e-6));
+    }
+
+    Mat2 singular;
+    singular[0] = 1.0f; singular[1] = 2.0f;
+    singular[2] = 2.0f; singular[3] = 4.0f;
+    Mat2 unused;
+    TEST_ASSERT(!inverse(singular, unused));
+    TEST_ASSERT(equivalent(minEigenValue(singular), 0.0f, 1e-6f));
+    TEST_ASSERT(equivalent(minEigenValue2x2(singular), 0.0f, 1e-6f));
+
+    FixedVec<float, 2> b, x;
+    Mat2 a = Mat2::identity() * 2.0f;
+    b[0] = 1.0f;
+    b[1] = -3.0f;
+    TEST_ASSERT(solve(a, b, x) && x[0] == 0.5f && x[1] == -1.5f);
+}
+TEST_END(TestFixedMat)
+
 TEST_BEGIN(TestMatProjMult)
 {
     for (int i = 0; i < 100; ++i)
@@ -525,6 +697,109 @@ TEST_BEGIN(TestMatProjMult)
 }
 TEST_END(TestMatProjMult)
 
+TEST_BEGIN(TestParallelPool)
+{
+    int const threads = parallelThreads();
+
+    for (int count : { 4, 2, 5 }) {
+        setParallelThreads(count);
+
+        // every index once, chunks numbered 0 .. parallelChunks - 1, nested calls inline
+        for (int run = 0; run != 50; ++run) {
+            int const chunks = parallelChunks(0, 1000);
+            std::vector<int> hits(1000, 0);
+            std::vector<int> chunk_hits(size_t(chunks), 0);
+            std::atomic<int> nested{0};
+
+            parallelForChunks(0, 1000, [&](int chunk, int begin, int end) {
+                chunk_hits[size_t(chunk)]++;
+                for (int i = begin; i != end; ++i)
+                    hits[size_t(i)]++;
+                nested += parallelChunks(0, 1000);
+            });
+
+            TEST_ASSERT(std::count(hits.begin(), hits.end(), 1) == 1000);
+            TEST_ASSERT(std::count(chunk_hits.begin(), chunk_hits.end(), 1) == chunks);
+            TEST_ASSERT(nested == chunks);
+        }
+    }
+
+    // exceptions reach the caller and leave the calling thread able to split again
+    bool thrown = false;
+    try {
+        parallelFor(0, 100, [](int begin, int) {
+            if (begin == 0)
+                throw std::runtime_error("chunk");
+        });
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    TEST_ASSERT(thrown);
+    TEST_ASSERT(parallelChunks(0, 100) == 5);
+
+    // submitted tasks run on the pool
+    std::mutex mutex;
+    std::condition_variable condition;
+    int done = 0;
+    for (int i = 0; i != 20; ++i)
+        parallelSubmit([&] {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (++done == 20)
+                condition.notify_all();
+        });
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&] { return done == 20; });
+    }
+
+    setParallelThreads(threads);
+}
+TEST_END(TestParallelPool)
+
+TEST_BEGIN(TestMatMultBlocked)
+{
+    // sizes that hit the small path, partial tiles, several kc blocks and several column panels
+    const int sizes[][3] = { { 3, 5, 7 }, { 61, 37, 45 }, { 130, 300, 9 }, { 67, 531, 601 } };
+
+    const int threads = parallelThreads();
+    for (auto const& size : sizes) {
+        Mat a;
+        matrix a1;
+        randomize(a, a1, size[0], size[1]);
+
+        Mat b;
+        matrix b1;
+        randomize(b, b1, size[1], size[2]);
+
+        matrix m = matrix_mult_matrix(a1, b1);
+
+        setParallelThreads(1);
+        Mat single = Mat::mmult(a, b);
+        setParallelThreads(4);
+        Mat multi = Mat::mmult(a, b);
+
+        TEST_ASSERT(same(single, m));
+        TEST_ASSERT(same(multi, m));
+
+        matrix t1 = transpose_matrix(b1);
+        TEST_ASSERT(same(b.transpose(), t1));
+
+        free_matrix(t1);
+        free_matrix(m);
+        free_matrix(a1);
+        free_matrix(b1);
+    }
+    setParallelThreads(threads);
+
+    // the output buffer is reused
+    Matd a = Matd::makeIdentity(70, 70);
+    Matd p(70, 70);
+    p.fill(5.0);
+    Matd::mmult(a, a, p);
+    TEST_ASSERT(p(0, 0) == 1.0 && p(3, 4) == 0.0 && p(69, 69) == 1.0);
+}
+TEST_END(TestMatMultBlocked)
+
 TEST_BEGIN(TestMatProjHomography)
 {
     {
@@ -725,6 +1000,88 @@ TEST_BEGIN(TestMaxCostAssignment)
 }
 TEST_END(TestMaxCostAssignment)
 
+TEST_BEGIN(TestRectangularAssignment)
+{
+    // brute force over all injective maps of the smaller side
+    auto best = [](CostMatrix const& cost, bool maximize) {
+        const bool wide = cost.w >= cost.h;
+        const int n = wide ? cost.h : cost.w;
+        const int m = wide ? cost.w : cost.h;
+
+        std::vector<int> columns(static_cast<size_t>(m));
+        for (int j = 0; j != m; ++j)
+            columns[size_t(j)] = j;
+
+        CostT result = maximize ? std::numeric_limits<CostT>::min() : std::numeric_limits<CostT>::max();
+        do {
+            CostT sum = 0;
+            for (int i = 0; i != n; ++i)
+                sum += wide ? cost(i, columns[size_t(i)]) : cost(columns[size_t(i)], i);
+            result = maximize ? maximum(result, sum) : minimum(result, sum);
+        } while (std::next_permutation(columns.begin(), columns.end()));
+        return result;
+    };
+
+    AssignmentSolver solver;
+    for (int trial = 0; trial != 60; ++trial) {
+        const int rows = 1 + rand() % 6;
+        const int cols = 1 + rand() % 6;
+        CostMatrix cost(cols, rows);
+        for (int i = 0; i != cost.size(); ++i)
+            cost.data[i] = rand() % 50 - 10;
+
+        for (bool maximize : { true, false }) {
+            Assignment const& assignment = maximize ? solver.maxCost(cost) : solver.minCost(cost);
+            TEST_ASSERT(int(assignment.size()) == rows);
+
+            // every column at most once, min(rows, cols) rows assigned
+            std::vector<int> seen(static_cast<size_t>(cols), 0);
+            int assigned = 0;
+            for (CostT column : assignment)
+                if (column >= 0) {
+                    seen[size_t(column)]++;
+                    assigned++;
+                }
+            TEST_ASSERT(assigned == minimum(rows, cols));
+            TEST_ASSERT(*std::max_element(seen.begin(), seen.end()) <= 1);
+
+            TEST_ASSERT(assignmentCost(cost, assignment) == best(cost, maximize));
+        }
+    }
+
+    // larger problems with many ties, the square solver agrees with the unbalanced one
+    // run on the same costs plus columns too expensive to ever be picked
+    for (int trial = 0; trial != 10; ++trial) {
+        const int n = 20 + rand() % 30;
+        CostMatrix square(n, n);
+        CostMatrix wide(2 * n + 1, n);
+        wide.fill(0, 1000000);
+        for (int y = 0; y != n; ++y)
+            for (int x = 0; x != n; ++x)
+                square(y, x) = wide(y, x) = rand() % (trial < 5 ? 4 : 1000);
+
+        const CostT expected = assignmentCost(wide, AssignmentSolver().minCost(wide));
+        TEST_ASSERT(assignmentCost(square, solver.minCost(square)) == expected);
+
+        // and on the transposed (tall) side, padded with rows
+        CostMatrix tall(n, n + 3);
+        tall.fill(0, 1000000);
+        for (int y = 0; y != n; ++y)
+            for (int x = 0; x != n; ++x)
+                tall(y, x) = square(y, x);
+        TEST_ASSERT(assignmentCost(tall, solver.minCost(tall)) == expected);
+    }
+
+    // square problems match the previous solver results
+    CostMatrix cost(3, 3);
+    cost(0, 0) = 1; cost(0, 1) = 2; cost(0, 2) = 6;
+    cost(1, 0) = 5; cost(1, 1) = 3; cost(1, 2) = 6;
+    cost(2, 0) = 4; cost(2, 1) = 5; cost(2, 2) = 0;
+    TEST_ASSERT(assignmentCost(cost, solver.maxCost(cost)) == 16);
+    TEST_ASSERT(assignmentCost(cost, solver.minCost(cost)) == 4);
+}
+TEST_END(TestRectangularAssignment)
+
 
 TEST_BEGIN(TestGetPixel)
 {
@@ -742,6 +1099,205 @@ TEST_BEGIN(TestGetPixel)
 }
 TEST_END(TestGetPixel)
 
+TEST_BEGIN(TestMatFile)
+{
+    Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg"));
+    str32 path = mergePaths(str8To32(std::filesystem::temp_directory_path().string()), U"dog_tmp.smat");
+
+    // float32 maps in place, bit exact and aligned
+    TEST_ASSERT(saveMat(path, im));
+    MatFileInfo info;
+    TEST_ASSERT(readMatInfo(path, info));
+    TEST_ASSERT(info.type == MatFileType::Float32 && info.w == im.w && info.h == im.h && info.c == im.c);
+
+    {
+        Mat mapped = mapMat(path);
+        TEST_ASSERT(mapped.w == im.w && mapped.h == im.h && mapped.c == im.c);
+        TEST_ASSERT(reinterpret_cast<uintptr_t>(mapped.data) % 64 == 0);
+        TEST_ASSERT(memcmp(mapped.data, im.data, size_t(im.size()) * sizeof(float)) == 0);
+
+        // copy on write, the file keeps its values and the mapping outlives its first owner
+        Mat view = mapped.channelView(1);
+        mapped = Mat();
+        view.data[0] = 5.0f;
+        TEST_ASSERT(loadMat(path).get(0, 0, 1) == im.get(0, 0, 1));
+    }
+
+    TEST_ASSERT(sameMat(loadImage(path), im));
+
+    // channels keeps the first planes, more than stored fails
+    Mat first = loadImage(path, 1);
+    TEST_ASSERT(first.c == 1 && first.w == im.w && first.h == im.h);
+    TEST_ASSERT(memcmp(first.data, im.data, size_t(im.w * im.h) * sizeof(float)) == 0);
+    TEST_ASSERT(loadImage(path, im.c + 1).size() == 0);
+
+    // extensions ignore case on save too
+    str32 upper = mergePaths(str8To32(std::filesystem::temp_directory_path().string()), U"dog_tmp_upper.SMAT");
+    TEST_ASSERT(saveImage(upper, im));
+    TEST_ASSERT(readMatInfo(upper, info) && info.type == MatFileType::Float32);
+    TEST_ASSERT(deleteFile(upper));
+
+    // half and 8 bit storage convert on load, they can't be mapped as float
+    TEST_ASSERT(saveMat(path, im, MatFileType::Float16));
+    Mat half = loadMat(path);
+    bool close = half.size() == im.size();
+    for (int i = 0; close && i != im.size(); ++i)
+        close = absolute(half.data[i] - im.data[i]) <= 0.0005f;
+    TEST_ASSERT(close);
+    TEST_ASSERT(mapMat(path).size() == 0);
+
+    TEST_ASSERT(saveMat(path, im, MatFileType::UInt8));
+    TEST_ASSERT(memcmp(loadMat(path).data, im.data, size_t(im.size()) * sizeof(float)) == 0);
+
+    Matb bytes = im.convert<unsigned char>();
+    TEST_ASSERT(saveMat(path, bytes));
+    Matb mapped_bytes = mapMat<unsigned char>(path);
+    TEST_ASSERT(mapped_bytes.size() == bytes.size());
+    TEST_ASSERT(memcmp(mapped_bytes.data, bytes.data, size_t(bytes.size())) == 0);
+
+    // a corrupted header whose size check wraps around: 2^30 x 2^30 x 16 floats is 2^66 bytes, 0 in 64 bits
+    TEST_ASSERT(saveMat(path, im));
+    {
+        std::fstream file(std::filesystem::path(path), std::ios::in | std::ios::out | std::ios::binary);
+        const uint32_t dimensions[3] = { 1u << 30, 1u << 30, 16u };
+        const uint64_t wrapped = 0;
+        file.seekp(12);
+        file.write(reinterpret_cast<char const*>(dimensions), sizeof(dimensions));
+        file.seekp(32);
+        file.write(reinterpret_cast<char const*>(&wrapped), sizeof(wrapped));
+        TEST_ASSERT(bool(file));
+    }
+    TEST_ASSERT(!readMatInfo(path, info));
+    TEST_ASSERT(loadMat(path).size() == 0);
+    TEST_ASSERT(mapMat(path).size() == 0);
+
+    TEST_ASSERT(deleteFile(path));
+    TEST_ASSERT(mapMat(path).size() == 0);
+}
+TEST_END(TestMatFile)
+
+TEST_BEGIN(TestImageIO)
+{
+    Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg"));
+    auto tmp = [](str32 const& name) { return mergePaths(str8To32(std::filesystem::temp_directory_path().string()), name); };
+    auto bytes = [](str32 const& path) { return std::filesystem::file_size(str32To8(path)); };
+
+    std::vector<str32> paths = { tmp(U"dog_io0_tmp.png"), tmp(U"dog_io1_tmp.png"), tmp(U"dog_io2_tmp.jpg"), tmp(U"dog_io3_tmp.jpg") };
+
+    // a single slot in flight, every submit waits for the previous request
+    {
+        ImageIO io(1);
+        TEST_ASSERT(io.maxInFlight() == 1);
+
+        ImageSaveOptions fast;
+        fast.png_compression = 0;
+        fast.jpg_quality = 30;
+        ImageSaveOptions small;
+        small.png_compression = 9;
+        small.jpg_quality = 95;
+
+        std::vector<std::future<bool>> saved;
+        saved.push_back(io.save(paths[0], im, fast));
+        saved.push_back(io.save(paths[1], im, small));
+        saved.push_back(io.save(paths[2], im, fast));
+        saved.push_back(io.save(paths[3], im, small));
+        for (auto& result : saved)
+            TEST_ASSERT(result.get());
+    }
+
+    // png level only changes the size, jpg quality changes the pixels
+    TEST_ASSERT(bytes(paths[0]) > bytes(paths[1]));
+    TEST_ASSERT(bytes(paths[3]) > bytes(paths[2]));
+
+    ImageIO io;
+    std::vector<std::future<Mat>> loaded = io.load(paths);
+    paths.push_back(tmp(U"missing_tmp.png"));
+    loaded.push_back(io.load(paths.back()));
+    io.wait();
+
+    TEST_ASSERT(loaded.size() == paths.size());
+    Mat first;
+    for (size_t i = 0; i != loaded.size(); ++i)
+    {
+        Mat async = loaded[i].get();
+        Mat sync = loadImage(paths[i]);
+        TEST_ASSERT(sameMat(async, sync));
+        if (i == 0)
+            first = async;
+        else if (i == 1)
+            TEST_ASSERT(memcmp(async.data, first.data, size_t(first.size()) * sizeof(float)) == 0);
+        if (i + 1 < paths.size())
+            TEST_ASSERT(deleteFile(paths[i]));
+        else
+            TEST_ASSERT(async.size() == 0);
+    }
+}
+TEST_END(TestImageIO)
+
+TEST_BEGIN(TestImageIOInFlight)
+{
+    int threads = parallelThreads();
+    setParallelThreads(4);
+
+    // requests hold their slot until released, with more pool threads than slots
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool released = false;
+    int running = 0;
+    int most = 0;
+
+    auto request = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        running++;
+        most = maximum(most, running);
+        condition.notify_all();
+        condition.wait(lock, [&] { return released; });
+        running--;
+        return true;
+    };
+
+    {
+        ImageIO io(2);
+        std::vector<std::future<bool>> results;
+        results.push_back(io.run(request));
+        results.push_back(io.run(request));
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            TEST_ASSERT(condition.wait_for(lock, std::chrono::seconds(10), [&] { return running == 2; }));
+        }
+
+        // the slots are full, the next submit waits for one to finish
+        std::atomic<bool> submitted(false);
+        std::thread producer([&] {
+            for (int i = 0; i != 6; ++i)
+                results.push_back(io.run(request));
+            submitted = true;
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        TEST_ASSERT(!submitted);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            TEST_ASSERT(running == 2);
+            released = true;
+        }
+        condition.notify_all();
+
+        producer.join();
+        io.wait();
+        TEST_ASSERT(submitted);
+        TEST_ASSERT(results.size() == 8);
+        for (auto& result : results)
+            TEST_ASSERT(result.get());
+    }
+
+    TEST_ASSERT(most == 2);
+    TEST_ASSERT(running == 0);
+    setParallelThreads(threads);
+}
+TEST_END(TestImageIOInFlight)
+
 TEST_BEGIN(TestSetPixel)
 {
     Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dots.png"));
@@ -813,6 +1369,40 @@ TEST_BEGIN(TestPixelHsvToRgb)
 }
 TEST_END(TestPixelHsvToRgb)
 
+TEST_BEGIN(TestPixelYuv)
+{
+    Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg"));
+
+    Mat yuv = rgb2yuv(im);
+    Mat gray = rgb2gray(im);
+    for (int i = 0; i != gray.size(); ++i)
+        TEST_ASSERT(equivalent(yuv.data[i], gray.data[i], 1e-5f));
+
+    Mat back = yuv2rgb(yuv);
+    for (int i = 0; i != im.size(); ++i)
+        TEST_ASSERT(equivalent(back.data[i], im.data[i], 1e-5f));
+
+    // nv12 is 8 bit with a chroma sample per 2x2 block, blocks of one color survive within quantization
+    Mat blocks(im.w & ~1, im.h & ~1, 3);
+    for (int c = 0; c != 3; ++c)
+        for (int y = 0; y != blocks.h; ++y)
+            for (int x = 0; x != blocks.w; ++x)
+                blocks.set(x, y, c, im.get(x & ~1, y & ~1, c));
+
+    Matb nv12;
+    rgb2nv12(blocks, nv12);
+    TEST_ASSERT(nv12.w == blocks.w && nv12.h == blocks.h * 3 / 2);
+
+    Mat rgb;
+    nv122rgb(nv12, rgb);
+    TEST_ASSERT(rgb.w == blocks.w && rgb.h == blocks.h && rgb.c == 3);
+    float max_error = 0.0f;
+    for (int i = 0; i != rgb.size(); ++i)
+        max_error = maximum(max_error, absolute(rgb.data[i] - blocks.data[i]));
+    TEST_ASSERT(max_error < 4.0f / 255.0f);
+}
+TEST_END(TestPixelYuv)
+
 TEST_BEGIN(TestThreshold)
 {
     Mat loaded = loadImage(mergePaths(testRoot(), U"data/vision/gradient.png"));
@@ -864,6 +1454,72 @@ TEST_BEGIN(TestThresholdOtsu)
 }
 TEST_END(TestThresholdOtsu)
 
+TEST_BEGIN(TestHistogram)
+{
+    Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg"));
+
+    int threads = parallelThreads();
+    setParallelThreads(4);
+    Histogram histogram(64);
+    histogram.compute(im);
+    setParallelThreads(threads);
+
+    TEST_ASSERT(histogram.channels() == 3 && histogram.bins() == 64);
+    for (int c = 0; c != im.c; ++c) {
+        std::vector<long long> naive(64, 0);
+        for (int i = 0; i != im.channelSize(); ++i)
+            naive[size_t(clampTo(int(im.data[c * im.channelSize() + i] * 64.0f), 0, 63))]++;
+
+        bool same = true;
+        for (int b = 0; b != 64; ++b)
+            same = same && naive[size_t(b)] == histogram.count(b, c);
+        TEST_ASSERT(same);
+        TEST_ASSERT(histogram.total(c) == im.channelSize());
+        TEST_ASSERT(equivalent(histogram.cumulative(c).back(), 1.0));
+    }
+
+    // out of range, huge and NaN values land in the end bins
+    TEST_ASSERT(histogram.bin(-0.5f) == 0 && histogram.bin(1.0f) == 63 && histogram.bin(7.0f) == 63);
+    TEST_ASSERT(histogram.bin(-1e30f) == 0 && histogram.bin(1e30f) == 63);
+    TEST_ASSERT(histogram.bin(std::numeric_limits<float>::quiet_NaN()) == 0);
+    TEST_ASSERT(histogram.bin(std::numeric_limits<float>::infinity()) == 63);
+
+    // a low contrast image is spread over [0, 1]
+    Mat gray = rgb2gray(im);
+    Mat low = gray.clone();
+    for (int i = 0; i != low.size(); ++i)
+        low.data[i] = 0.4f + low.data[i] * 0.2f;
+
+    Mat equalized = equalizeHistogram(low);
+    float minv, maxv;
+    equalized.minNmax(0, minv, maxv);
+    TEST_ASSERT(equivalent(minv, 0.0f) && equivalent(maxv, 1.0f));
+    for (int i = 0; i != low.size(); ++i)
+        for (int j : { i + 1, i + low.w })
+            if (j < low.size() && low.data[i] < low.data[j])
+                TEST_ASSERT(equalized.data[i] <= equalized.data[j]);
+
+    // one tile without clipping is the cumulative distribution
+    Histogram lh(256);
+    lh.compute(low);
+    std::vector<double> cdf = lh.cumulative();
+    Mat single_tile = clahe(low, 1, 1, 256.0f);
+    bool same = true;
+    for (int i = 0; i != low.size(); ++i)
+        same = same && equivalent(single_tile.data[i], float(cdf[size_t(lh.bin(low.data[i]))]), 1e-5f);
+    TEST_ASSERT(same);
+
+    // the clip limit bounds the contrast stretch
+    float previous = 0.2f;
+    for (float clip : { 1.0f, 2.0f, 4.0f }) {
+        Mat adaptive = clahe(low, 8, 8, clip);
+        adaptive.minNmax(0, minv, maxv);
+        TEST_ASSERT(minv >= 0.0f && maxv <= 1.0f && maxv - minv > previous);
+        previous = maxv - minv;
+    }
+}
+TEST_END(TestHistogram)
+
 TEST_BEGIN(TestIntegralImages)
 {
     //https://en.wikipedia.org/wiki/Summed-area_table
@@ -961,10 +1617,92 @@ TEST_BEGIN(TestIntegralImages)
 }
 TEST_END(TestIntegralImages)
 
+TEST_BEGIN(TestIntegralImagesWide)
+{
+    // tilted table against the cone sum
+    {
+        Mat a(11, 7, 2);
+        for (int i = 0; i != a.size(); ++i)
+            a.data[i] = float(rand() % 100);
+
+        Matd tilted;
+        makeTiltedIntegralImage(a, tilted);
+        for (int k = 0; k != a.c; ++k)
+            for (int y = 0; y != a.h; ++y)
+                for (int x = 0; x != a.w; ++x) {
+                    double sum = 0.0;
+                    for (int j = 0; j <= y; ++j)
+                        for (int i = 0; i != a.w; ++i)
+                            if (std::abs(x - i) <= y - j)
+                                sum += a.get(i, j, k);
+                    TEST_ASSERT(tilted.get(x, y, k) == sum);
+                }
+    }
+
+    // big enough to be split in blocks, values exact in every accumulator
+    int threads = parallelThreads();
+    setParallelThreads(4);
+
+    Mat a(300, 257, 2);
+    Matl al(a.w, a.h, a.c);
+    for (int i = 0; i != a.size(); ++i) {
+        al.data[i] = rand() % 256;
+        a.data[i] = float(al.data[i]);
+    }
+
+    Matd sum, sqsum, squared;
+    makeIntegralImage(a, sum, sqsum);
+    makeSquaredIntegralImage(a, squared);
+
+    Matl suml;
+    makeIntegralImage(al, suml);
+
+    for (int k = 0; k != a.c; ++k)
+        for (int y = 0; y != a.h; ++y) {
+            double row = 0.0;
+            double sqrow = 0.0;
+            for (int x = 0; x != a.w; ++x) {
+                double v = a.get(x, y, k);
+                row += v;
+                sqrow += v * v;
+                double expected = row + (y > 0 ? sum.get(x, y - 1, k) : 0.0);
+                double sqexpected = sqrow + (y > 0 ? sqsum.get(x, y - 1, k) : 0.0);
+                TEST_ASSERT(sum.get(x, y, k) == expected);
+                TEST_ASSERT(sqsum.get(x, y, k) == sqexpected);
+                TEST_ASSERT(squared.get(x, y, k) == sqexpected);
+                TEST_ASSERT(double(suml.get(x, y, k)) == expected);
+            }
+        }
+
+    Matd serial;
+    setParallelThreads(1);
+    makeIntegralImage(a, serial);
+    setParallelThreads(threads);
+    for (int i = 0; i != sum.size(); ++i)
+        TEST_ASSERT(serial.data[i] == sum.data[i]);
+
+    // all accumulators give the same box filter
+    Mat box, boxl;
+    boxfilterIntegralImage(sum, 5, box);
+    boxfilterIntegralImage(suml, 5, boxl);
+    TEST_ASSERT(sameMat(box, boxl));
+
+    double region;
+    int count;
+    getIntegralImageRegion(sum, 1, -3, 10, 4, 12, region, count);
+    TEST_ASSERT(count == 5 * 3);
+    double expected = 0.0;
+    for (int y = 10; y <= 12; ++y)
+        for (int x = 0; x <= 4; ++x)
+            expected += a.get(x, y, 1);
+    TEST_ASSERT(region == expected);
+}
+TEST_END(TestIntegralImagesWide)
+
 TEST_BEGIN(TestBoxFilter)
 {
     Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg"));
-    Mat imi;
+    Matd imi;
     makeIntegralImage(im, imi);
 
     Mat blur;
@@ -977,6 +1715,33 @@ TEST_BEGIN(TestBoxFilter)
 }
 TEST_END(TestBoxFilter)
 
+TEST_BEGIN(TestSlidingBoxFilter)
+{
+    Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg"));
+    Matd imi;
+    makeIntegralImage(im, imi);
+
+    Mat tmp;
+    for (int size : { 1, 2, 7, 15, 2000 }) {
+        Mat expected;
+        boxfilterIntegralImage(imi, size, expected);
+
+        Mat blur;
+        boxfilter(im, blur, tmp, size);
+        TEST_ASSERT(sameMat(blur, expected));
+
+        Mat inplace = im.clone();
+        boxfilter(inplace, inplace, tmp, size);
+        TEST_ASSERT(sameMat(inplace, expected));
+    }
+
+    Mat gt = loadImage(mergePaths(testRoot(), U"data/vision/dog-box7_integral.png"));
+    Mat blur = boxfilter(im, 7);
+    blur.clamp();
+    TEST_ASSERT(sameMat(blur, gt));
+}
+TEST_END(TestSlidingBoxFilter)
+
 TEST_BEGIN(TestOpticalflow)
 {
     LucasKanade lk;
@@ -985,6 +1750,21 @@ TEST_BEGIN(TestOpticalflow)
     Mat b = loadImage(mergePaths(testRoot(), U"data/vision/dog_b.jpg"));
     Mat flow;
     lk.opticalflow(b, a, 15, 8, flow);
+
+    // streaming gives the same flow and leaves the frames alone
+    LucasKanade stream;
+    Mat a_gray = rgb2gray(a);
+    Mat a_copy = a_gray.clone();
+    Mat pushed;
+    TEST_ASSERT(!stream.push(a_gray, 15, 8, pushed));
+    TEST_ASSERT(pushed.size() == 0);
+    TEST_ASSERT(stream.push(b, 15, 8, pushed));
+    TEST_ASSERT(sameMat(pushed, flow));
+    TEST_ASSERT(sameMat(a_gray, a_copy));
+
+    stream.reset();
+    TEST_ASSERT(!stream.push(b, 15, 8, pushed));
+
     drawFlow(a, flow, 8);
 //    saveImage("dump.png", a);
 
@@ -992,7 +1772,152 @@ TEST_BEGIN(TestOpticalflow)
 //    TEST_ASSERT(sameMat(a, loaded));
 }
 TEST_END(TestOpticalflow)
+TEST_BEGIN(TestOpticalflowFused)
+{
+    LucasKanade lk;
 
+    Mat a = rgb2gray(loadImage(mergePaths(testRoot(), U"data/vision/dog_a.jpg")));
+    Mat b = rgb2gray(loadImage(mergePaths(testRoot(), U"data/vision/dog_b.jpg")));
+
+    for (int stride : { 1, 4, 8, 33 }) {
+        Mat S, expected;
+        lk.timeStructureMatrix(b, a, 15, S);
+        lk.velocityImage(S, stride, expected);
+
+        Mat fused;
+        lk.velocity(b, a, 15, stride, fused);
+        TEST_ASSERT(fused.w == expected.w && fused.h == expected.h && fused.c == expected.c);
+
+        // only samples right at the eigen value threshold may differ
+        int different = 0;
+        for (int i = 0; i != fused.size(); ++i)
+            if (!equivalent(fused.data[i], expected.data[i], 0.001f))
+                different++;
+        TEST_ASSERT(different * 1000 <= fused.size());
+    }
+}
+TEST_END(TestOpticalflowFused)
+
+TEST_BEGIN(TestSparseOpticalflow)
+{
+    Mat a = rgb2gray(loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg")));
+
+    // content moves by (9.5, -6.25), too far for a single scale window
+    float const sx = 9.5f;
+    float const sy = -6.25f;
+    Mat b(a.w, a.h, 1);
+    // interpolateBL samples pixel centers at +0.5
+    for (int y = 0; y != b.h; ++y)
+        for (int x = 0; x != b.w; ++x)
+            b.set(x, y, 0, interpolateBL(a, float(x) + 0.5f - sx, float(y) + 0.5f - sy, 0));
+
+    std::vector<Vector2F> points;
+    for (Descriptor const& current : fastCornerDetector(a, 0.1f, 5))
+        if (current.p.x() > 20 && current.p.y() > 20 && current.p.x() < a.w - 20 && current.p.y() < a.h - 20)
+            points.push_back(current.p);
+    points.push_back(Vector2F(-10.0f, 5.0f));
+    TEST_ASSERT(points.size() > 20);
+
+    SparseLucasKanade klt;
+    std::vector<Vector2F> tracked;
+    std::vector<unsigned char> status;
+    klt.track(a, b, points, tracked, status);
+    TEST_ASSERT(tracked.size() == points.size() && status.size() == points.size());
+    TEST_ASSERT(status.back() == 0);
+
+    int good = 0;
+    for (size_t i = 0; i + 1 < points.size(); ++i)
+        if (status[i] && distance(tracked[i], Vector2F(points[i].x() + sx, points[i].y() + sy)) < 0.1f)
+            good++;
+    TEST_ASSERT(good * 10 >= int(points.size() - 1) * 9);
+
+    // reusing pyramids gives the same result
+    Pyramid pa, pb;
+    klt.buildPyramid(a, pa);
+    klt.buildPyramid(b, pb);
+    std::vector<Vector2F> again;
+    std::vector<unsigned char> again_status;
+    klt.track(pa, pb, points, again, again_status);
+    TEST_ASSERT(again_status == status);
+    for (size_t i = 0; i != points.size(); ++i)
+        TEST_ASSERT(again[i] == tracked[i]);
+}
+TEST_END(TestSparseOpticalflow)
+
+TEST_BEGIN(TestDenseOpticalflow)
+{
+    Mat a = rgb2gray(loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg")));
+
+    // content moves by (6.5, -3.25), interpolateBL samples pixel centers at +0.5
+    float const sx = 6.5f;
+    float const sy = -3.25f;
+    Mat b(a.w, a.h, 1);
+    for (int y = 0; y != b.h; ++y)
+        for (int x = 0; x != b.w; ++x)
+            b.set(x, y, 0, interpolateBL(a, float(x) + 0.5f - sx, float(y) + 0.5f - sy, 0));
+
+    // the porch planks and wall siding only have texture in one direction,
+    // so check the median and a looser fraction of the pixels
+    auto check = [&](Mat const& flow, float median_error, int good_tenths) {
+        if (flow.w != a.w || flow.h != a.h || flow.c != 2)
+            return false;
+
+        std::vector<float> dx, dy;
+        int good = 0;
+        for (int y = 20; y < a.h - 20; ++y)
+            for (int x = 20; x < a.w - 20; ++x) {
+                dx.push_back(flow.get(x, y, 0));
+                dy.push_back(flow.get(x, y, 1));
+                if (std::abs(dx.back() - sx) < 0.5f && std::abs(dy.back() - sy) < 0.5f)
+                    good++;
+            }
+
+        std::nth_element(dx.begin(), dx.begin() + dx.size() / 2, dx.end());
+        std::nth_element(dy.begin(), dy.begin() + dy.size() / 2, dy.end());
+        return std::abs(dx[dx.size() / 2] - sx) < median_error &&
+               std::abs(dy[dy.size() / 2] - sy) < median_error &&
+               good * 10 >= int(dx.size()) * good_tenths;
+    };
+
+    FarnebackFlow farneback;
+    Mat flow;
+    farneback.opticalflow(b, a, flow);
+    TEST_ASSERT(check(flow, 0.1f, 7));
+
+    // a sequence reuses the previous frame
+    FarnebackFlow sequence;
+    Mat pushed;
+    TEST_ASSERT(!sequence.push(a, pushed));
+    TEST_ASSERT(sequence.push(b, pushed));
+    TEST_ASSERT(sameMat(pushed, flow));
+
+    // a static frame after the motion, starting from the previous flow
+    TEST_ASSERT(sequence.push(b, pushed));
+    float biggest = 0.0f;
+    for (int y = 20; y < a.h - 20; ++y)
+        for (int x = 20; x < a.w - 20; ++x)
+            biggest = maximum(biggest, std::abs(pushed.get(x, y, 0)) + std::abs(pushed.get(x, y, 1)));
+    TEST_ASSERT(biggest < 0.5f);
+
+    // dense inverse search stops at a quarter resolution, so it's a little less precise
+    InverseSearchFlow dis;
+    Mat fast;
+    dis.opticalflow(b, a, fast);
+    TEST_ASSERT(check(fast, 0.15f, 7));
+
+    InverseSearchFlow dis_sequence;
+    TEST_ASSERT(!dis_sequence.push(a, pushed));
+    TEST_ASSERT(dis_sequence.push(b, pushed));
+    TEST_ASSERT(sameMat(pushed, fast));
+
+    TEST_ASSERT(dis_sequence.push(b, pushed));
+    biggest = 0.0f;
+    for (int y = 20; y < a.h - 20; ++y)
+        for (int x = 20; x < a.w - 20; ++x)
+            biggest = maximum(biggest, std::abs(pushed.get(x, y, 0)) + std::abs(pushed.get(x, y, 1)));
+    TEST_ASSERT(biggest < 0.5f);
+}
+TEST_END(TestDenseOpticalflow)
 
 TEST_BEGIN(TestResizeNN)
 {
@@ -1044,6 +1969,79 @@ TEST_BEGIN(TestResizeMulti)
 }
 TEST_END(TestResizeMulti)
 
+TEST_BEGIN(TestResizeEngine)
+{
+    Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg"));
+
+    // the tap tables give the same samples as interpolateBL / interpolateNN
+    for (ResizeMode mode : { ResizeMode::NearestNeighbor, ResizeMode::Bilinear }) {
+        Mat resized = resize(im, 301, 517, mode);
+        const float x_ratio = float(im.w) / float(resized.w);
+        const float y_ratio = float(im.h) / float(resized.h);
+
+        bool same = true;
+        for (int c = 0; c != im.c; ++c)
+            for (int y = 0; y != resized.h; ++y)
+                for (int x = 0; x != resized.w; ++x) {
+                    const float px = (x + 0.5f) * x_ratio;
+                    const float py = (y + 0.5f) * y_ratio;
+                    const float v = (mode == ResizeMode::Bilinear) ? interpolateBL(im, px, py, c) : interpolateNN(im, px, py, c);
+                    same = same && resized.get(x, y, c) == v;
+                }
+        TEST_ASSERT(same);
+    }
+
+    // area with an integer factor is the mean of each block
+    const int factor = 4;
+    Mat area = resize(im, im.w / factor, im.h / factor, ResizeMode::Area);
+    bool mean = true;
+    for (int c = 0; c != im.c; ++c)
+        for (int y = 0; y != area.h; ++y)
+            for (int x = 0; x != area.w; ++x) {
+                float sum = 0.0f;
+                for (int j = 0; j != factor; ++j)
+                    for (int i = 0; i != factor; ++i)
+                        sum += im.get(x * factor + i, y * factor + j, c);
+                mean = mean && equivalent(area.get(x, y, c), sum / (factor * factor), 1e-5f);
+            }
+    TEST_ASSERT(mean);
+
+    // lanczos keeps flat images flat and stays close to bilinear on a smooth upscale
+    Mat flat(37, 23, 1);
+    flat.fill(0.25f);
+    for (auto size : { std::pair<int, int>(100, 61), { 9, 5 }, { 37, 23 } }) {
+        Mat resized = resize(flat, size.first, size.second, ResizeMode::Lanczos3);
+        for (int i = 0; i != resized.size(); ++i)
+            TEST_ASSERT(equivalent(resized.data[i], 0.25f, 1e-5f));
+    }
+
+    Mat identity = resize(im, im.w, im.h, ResizeMode::Lanczos3);
+    TEST_ASSERT(sameMat(identity, im));
+
+    Mat small = resize(im, im.w / 2, im.h / 2, ResizeMode::Area);
+    Mat lanczos = resize(small, im.w, im.h, ResizeMode::Lanczos3);
+    Mat bilinear = resize(small, im.w, im.h, ResizeMode::Bilinear);
+    double difference = 0.0;
+    for (int i = 0; i != im.size(); ++i)
+        difference += absolute(lanczos.data[i] - bilinear.data[i]);
+    TEST_ASSERT(difference / im.size() < 0.02);
+
+    // a Resizer reused across frames and modes gives the same pixels and keeps its output buffer
+    Resizer resizer;
+    Mat frame;
+    resizer.resize(im, frame, 301, 517, ResizeMode::Lanczos3);
+    float const* buffer = frame.data;
+    for (ResizeMode mode : { ResizeMode::Lanczos3, ResizeMode::Area, ResizeMode::Bilinear, ResizeMode::Lanczos3 }) {
+        resizer.resize(im, frame, 301, 517, mode);
+        TEST_ASSERT(frame.data == buffer);
+        Mat expected = resize(im, 301, 517, mode);
+        TEST_ASSERT(memcmp(frame.data, expected.data, sizeof(float) * size_t(expected.size())) == 0);
+    }
+    resizer.resize(small, frame, 50, 40, ResizeMode::Area);
+    TEST_ASSERT(sameMat(frame, resize(small, 50, 40, ResizeMode::Area)));
+}
+TEST_END(TestResizeEngine)
+
 
 TEST_BEGIN(TestHighPass)
 {
@@ -1161,6 +2159,54 @@ TEST_BEGIN(TestGaussianBlur)
 }
 TEST_END(TestGaussianBlur)
 
+TEST_BEGIN(TestRecursiveGaussian)
+{
+    Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg"));
+
+    auto difference = [](Mat const& a, Mat const& b, float& mean, float& max) {
+        double sum = 0.0;
+        max = 0.0f;
+        for (int i = 0; i != a.size(); ++i) {
+            float d = std::fabs(a.data[i] - b.data[i]);
+            sum += d;
+            max = std::max(max, d);
+        }
+        mean = float(sum / a.size());
+    };
+
+    for (float sigma : { 2.0f, 6.0f, 12.0f }) {
+        Mat f = makeGaussianFilter1D(sigma);
+        Mat tmp = convolve(im, f);
+        std::swap(f.w, f.h);
+        Mat expected = convolve(tmp, f);
+
+        float mean, max;
+        Mat iir = recursiveGaussian(im, sigma);
+        difference(iir, expected, mean, max);
+        TEST_ASSERT(mean < 0.004f && max < 0.05f);
+
+        Mat inplace = im.clone();
+        recursiveGaussian(inplace, inplace, sigma);
+        TEST_ASSERT(sameMat(inplace, iir));
+
+        // boxes average what is inside the image instead of replicating the border, only the mean is close
+        Mat box = boxGaussian(im, sigma);
+        difference(box, expected, mean, max);
+        TEST_ASSERT(mean < 0.005f);
+    }
+
+    // a flat image stays flat
+    Mat flat(64, 48, 1);
+    flat.fill(0.5f);
+    Mat blur = recursiveGaussian(flat, 8.0f);
+    for (int i = 0; i != blur.size(); ++i)
+        TEST_ASSERT(std::fabs(blur.data[i] - 0.5f) < 1e-5f);
+
+    // wide sigmas go through the recursive filter
+    TEST_ASSERT(sameMat(smoothImage(im, 10.0f), recursiveGaussian(im, 10.0f)));
+}
+TEST_END(TestRecursiveGaussian)
+
 TEST_BEGIN(TestHybridImage) 
 {
     Mat man = loadImage(mergePaths(testRoot(), U"data/vision/melisa.png"), 3);
@@ -1272,6 +2318,51 @@ TEST_BEGIN(TestSobelColor)
 }
 TEST_END(TestSobelColor)
 
+TEST_BEGIN(TestSobelFused)
+{
+    Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg"));
+    Mat gray = rgb2gray(im);
+
+    // single channel is bit exact with the separable passes
+    Mat gx, gy, mag, theta;
+    gradientSingleChannel(gray, gx, gy);
+    gradientMagnitudeAngle(gray, mag, theta);
+    for (int i = 0; i != gx.size(); ++i) {
+        TEST_ASSERT(mag.data[i] == std::hypotf(gx.data[i], gy.data[i]));
+        TEST_ASSERT(theta.data[i] == float(atan2(gy.data[i], gx.data[i])));
+    }
+
+    // color sums the channel gradients
+    gradient(im, gx, gy);
+    gradientMagnitudeAngle(im, mag, theta);
+    for (int i = 0; i != gx.size(); ++i)
+        TEST_ASSERT(equivalent(mag.data[i], std::hypotf(gx.data[i], gy.data[i]), 1e-4f));
+
+    Mat fast_mag, fast_theta;
+    gradientMagnitudeAngle(im, fast_mag, fast_theta, GradientAngle::Fast);
+    for (int i = 0; i != mag.size(); ++i) {
+        TEST_ASSERT(equivalent(fast_mag.data[i], mag.data[i], 1e-4f));
+        TEST_ASSERT(equivalent(fast_theta.data[i], theta.data[i], 1e-4f) || fabsf(fast_theta.data[i]) > 3.1415f);
+    }
+
+    // sectors follow the canny rule away from the sector borders
+    Mat sector_mag, sector;
+    gradientMagnitudeAngle(im, sector_mag, sector, GradientAngle::Sector);
+    const float pi = piAngle<float>();
+    for (int i = 0; i != mag.size(); ++i) {
+        const float dir = (fmodf(theta.data[i] + pi, pi) / pi) * 8;
+        if (fabsf(dir - roundf(dir)) < 1e-3f || fabsf(dir - 8.0f) < 1e-3f)
+            continue;
+
+        float expected = 0.0f;
+        if (dir > 1 && dir <= 3) expected = 1.0f;
+        else if (dir > 3 && dir <= 5) expected = 2.0f;
+        else if (dir > 5 && dir <= 7) expected = 3.0f;
+        TEST_ASSERT(sector.data[i] == expected);
+    }
+}
+TEST_END(TestSobelFused)
+
 TEST_BEGIN(TestCanny) 
 {
     Mat im = loadImage(mergePaths(testRoot(), U"data/vision/Lenna.png"));
@@ -1287,6 +2378,274 @@ TEST_BEGIN(TestCanny)
 }
 TEST_END(TestCanny)
 
+TEST_BEGIN(TestCannyHysteresis)
+{
+    // a vertical step centred on a pixel, fading from strong in the first rows to weak below
+    // the weak part is an edge only because it connects to the strong one, across every thread band
+    Mat im(100, 600, 1);
+    for (int y = 0; y != im.h; ++y) {
+        const float v = maximum(0.25f, 1.0f - 0.01f * float(y));
+        im.set(im.w / 2, y, 0, v * 0.5f);
+        for (int x = im.w / 2 + 1; x != im.w; ++x)
+            im.set(x, y, 0, v);
+    }
+
+    int threads = parallelThreads();
+
+    setParallelThreads(4);
+    Mat parallel;
+    smk::canny(im, parallel, 0.2f, 2.0f, 0.8f);
+
+    setParallelThreads(1);
+    Mat single;
+    smk::canny(im, single, 0.2f, 2.0f, 0.8f);
+
+    setParallelThreads(threads);
+
+    TEST_ASSERT(sameMat(parallel, single));
+    for (int y = 1; y != im.h - 1; ++y) {
+        float row = 0.0f;
+        for (int x = 0; x != im.w; ++x)
+            row += single.get(x, y, 0);
+        TEST_ASSERT(row >= 1.0f);
+    }
+
+    // without a strong pixel there are no edges
+    smk::canny(im, single, 0.2f, 100.0f, 0.8f);
+    for (int i = 0; i != single.size(); ++i)
+        TEST_ASSERT(single.data[i] == 0.0f);
+}
+TEST_END(TestCannyHysteresis)
+
+TEST_BEGIN(TestConnectedComponents)
+{
+    Mat mask(40, 300, 1);
+
+    // a 5x4 box
+    for (int y = 2; y != 6; ++y)
+        for (int x = 3; x != 8; ++x)
+            mask.set(x, y, 0, 1.0f);
+
+    // two pixels touching only by a corner
+    mask.set(20, 2, 0, 1.0f);
+    mask.set(21, 3, 0, 1.0f);
+
+    // a tall U, its prongs cross several row bands and only meet at the bottom
+    for (int y = 10; y != 290; ++y) {
+        mask.set(10, y, 0, 1.0f);
+        mask.set(30, y, 0, 1.0f);
+    }
+    for (int x = 10; x != 31; ++x)
+        mask.set(x, 290, 0, 1.0f);
+
+    int threads = parallelThreads();
+    setParallelThreads(4);
+
+    Mati labels;
+    ComponentsStats stats;
+    int count = connectedComponents(mask, labels, stats, 8);
+    TEST_ASSERT(count == 3);
+    TEST_ASSERT(stats.size() == 3);
+
+    if (count == 3) {
+        // raster order of the first pixel
+        TEST_ASSERT(stats[0].area == 20);
+        TEST_ASSERT(stats[0].x == 3 && stats[0].y == 2 && stats[0].w == 5 && stats[0].h == 4);
+        TEST_ASSERT(equivalent(stats[0].centroid.x(), 5.0f) && equivalent(stats[0].centroid.y(), 3.5f));
+
+        TEST_ASSERT(stats[1].area == 2);
+        TEST_ASSERT(stats[1].x == 20 && stats[1].y == 2 && stats[1].w == 2 && stats[1].h == 2);
+
+        TEST_ASSERT(stats[2].area == 280 * 2 + 21);
+        TEST_ASSERT(stats[2].x == 10 && stats[2].y == 10 && stats[2].w == 21 && stats[2].h == 281);
+        TEST_ASSERT(equivalent(stats[2].centroid.x(), 20.0f, 1e-4f));
+
+        TEST_ASSERT(labels.get(0, 0, 0) == 0);
+        TEST_ASSERT(labels.get(5, 3, 0) == 1);
+        TEST_ASSERT(labels.get(21, 3, 0) == 2);
+        TEST_ASSERT(labels.get(10, 10, 0) == 3 && labels.get(30, 10, 0) == 3);
+    }
+
+    // 4 connectivity splits the corner pixels
+    Mati labels4;
+    TEST_ASSERT(connectedComponents(mask, labels4, 4) == 4);
+
+    // same labels on a single thread
+    setParallelThreads(1);
+    Mati single;
+    TEST_ASSERT(connectedComponents(mask, single, 8) == 3);
+    setParallelThreads(threads);
+
+    bool same = true;
+    for (int i = 0; i != labels.size(); ++i)
+        same = same && labels.data[i] == single.data[i];
+    TEST_ASSERT(same);
+}
+TEST_END(TestConnectedComponents)
+
+TEST_BEGIN(TestConnectedComponentsSpeckle)
+{
+    // a speckle mask, thousands of small components, with a frame around it that every band carries
+    const int w = 301;
+    const int h = 517;
+    Mat mask(w, h, 1);
+    mask.fill(0.0f);
+    for (int y = 2; y != h - 2; ++y)
+        for (int x = 2; x != w - 2; ++x)
+            if (((unsigned(x) * 73856093u) ^ (unsigned(y) * 19349663u)) % 100 < 35)
+                mask.set(x, y, 0, 1.0f);
+    for (int x = 0; x != w; ++x) {
+        mask.set(x, 0, 0, 1.0f);
+        mask.set(x, h - 1, 0, 1.0f);
+    }
+    for (int y = 0; y != h; ++y) {
+        mask.set(0, y, 0, 1.0f);
+        mask.set(w - 1, y, 0, 1.0f);
+    }
+
+    // flood fill in raster order gives the same numbering
+    Mati expected(w, h, 1);
+    expected.fill(0);
+    ComponentsStats expected_stats;
+    std::vector<int> stack;
+    for (int y = 0; y != h; ++y)
+        for (int x = 0; x != w; ++x) {
+            if (mask.get(x, y, 0) <= 0.0f || expected.get(x, y, 0) != 0)
+                continue;
+
+            const int label = int(expected_stats.size()) + 1;
+            int x0 = x, y0 = y, x1 = x, y1 = y, area = 0;
+            double sx = 0.0, sy = 0.0;
+
+            expected.set(x, y, 0, label);
+            stack.assign(1, y * w + x);
+            while (!stack.empty()) {
+                const int px = stack.back() % w;
+                const int py = stack.back() / w;
+                stack.pop_back();
+
+                area++;
+                sx += px;
+                sy += py;
+                x0 = minimum(x0, px);
+                y0 = minimum(y0, py);
+                x1 = maximum(x1, px);
+                y1 = maximum(y1, py);
+
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        const int nx = px + dx;
+                        const int ny = py + dy;
+                        if (nx < 0 || ny < 0 || nx >= w || ny >= h)
+                            continue;
+                        if (mask.get(nx, ny, 0) <= 0.0f || expected.get(nx, ny, 0) != 0)
+                            continue;
+                        expected.set(nx, ny, 0, label);
+                        stack.push_back(ny * w + nx);
+                    }
+            }
+
+            ComponentStats s;
+            s.area = area;
+            s.x = x0;
+            s.y = y0;
+            s.w = x1 - x0 + 1;
+            s.h = y1 - y0 + 1;
+            s.centroid = Vector2<float>(float(sx / area), float(sy / area));
+            expected_stats.push_back(s);
+        }
+    TEST_ASSERT(expected_stats.size() > 1000);
+
+    int threads = parallelThreads();
+    for (int t : {1, 3, 8}) {
+        setParallelThreads(t);
+
+        Mati labels;
+        ComponentsStats stats;
+        const int count = connectedComponents(mask, labels, stats, 8);
+        TEST_ASSERT(count == int(expected_stats.size()));
+        TEST_ASSERT(stats.size() == expected_stats.size());
+
+        bool same = labels.size() == expected.size();
+        for (int i = 0; same && i != labels.size(); ++i)
+            same = labels.data[i] == expected.data[i];
+        TEST_ASSERT(same);
+
+        bool same_stats = stats.size() == expected_stats.size();
+        for (size_t k = 0; same_stats && k != stats.size(); ++k) {
+            ComponentStats const& a = stats[k];
+            ComponentStats const& b = expected_stats[k];
+            same_stats = a.area == b.area && a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h &&
+                equivalent(a.centroid.x(), b.centroid.x(), 1e-3f) && equivalent(a.centroid.y(), b.centroid.y(), 1e-3f);
+        }
+        TEST_ASSERT(same_stats);
+    }
+    setParallelThreads(threads);
+}
+TEST_END(TestConnectedComponentsSpeckle)
+
+template<typename T>
+static MatT<T> naiveMorphology(MatT<T> const& src, int kw, int kh, bool erosion) {
+    MatT<T> dst(src.w, src.h, src.c);
+    for (int c = 0; c != src.c; ++c)
+        for (int y = 0; y != src.h; ++y)
+            for (int x = 0; x != src.w; ++x) {
+                T v = src.get(x, y, c);
+                for (int j = y - kh / 2; j != y - kh / 2 + kh; ++j)
+                    for (int i = x - kw / 2; i != x - kw / 2 + kw; ++i)
+                        if (i >= 0 && i < src.w && j >= 0 && j < src.h)
+                            v = erosion ? minimum(v, src.get(i, j, c)) : maximum(v, src.get(i, j, c));
+                dst.set(x, y, c, v);
+            }
+    return dst;
+}
+
+TEST_BEGIN(TestMorphology)
+{
+    Mat im(61, 47, 2);
+    for (int i = 0; i != im.size(); ++i)
+        im.data[i] = uniformRandom();
+
+    Matb mask(61, 47, 1);
+    for (int i = 0; i != mask.size(); ++i)
+        mask.data[i] = uniformRandom() > 0.7f ? 255 : 0;
+
+    for (auto k : { std::pair<int, int>(1, 1), { 3, 3 }, { 4, 7 }, { 15, 1 }, { 1, 31 }, { 31, 15 }, { 80, 80 } }) {
+        Mat eroded, dilated;
+        erode(im, eroded, k.first, k.second);
+        dilate(im, dilated, k.first, k.second);
+        TEST_ASSERT(sameMat(eroded, naiveMorphology(im, k.first, k.second, true)));
+        TEST_ASSERT(sameMat(dilated, naiveMorphology(im, k.first, k.second, false)));
+
+        Mat inplace = im.clone();
+        erode(inplace, inplace, k.first, k.second);
+        TEST_ASSERT(sameMat(inplace, eroded));
+
+        Matb mask_eroded, mask_dilated;
+        erode(mask, mask_eroded, k.first, k.second);
+        dilate(mask, mask_dilated, k.first, k.second);
+        Matb expected_eroded = naiveMorphology(mask, k.first, k.second, true);
+        Matb expected_dilated = naiveMorphology(mask, k.first, k.second, false);
+
+        bool same = true;
+        for (int i = 0; i != mask.size(); ++i)
+            same = same && mask_eroded.data[i] == expected_eroded.data[i] && mask_dilated.data[i] == expected_dilated.data[i];
+        TEST_ASSERT(same);
+    }
+
+    // opening removes what is smaller than the window, closing fills holes
+    Mat square(40, 40, 1);
+    for (int y = 10; y != 30; ++y)
+        for (int x = 10; x != 30; ++x)
+            square.set(x, y, 0, 1.0f);
+    Mat noisy = square.clone();
+    noisy.set(2, 2, 0, 1.0f);
+    noisy.set(20, 20, 0, 0.0f);
+
+    TEST_ASSERT(sameMat(closing(opening(noisy, 3, 3), 3, 3), square));
+}
+TEST_END(TestMorphology)
+
 TEST_BEGIN(TestExtractImage4Points) 
 {
     Mat im = loadImage(mergePaths(testRoot(), U"data/vision/fireframe.png"));
@@ -1308,6 +2667,55 @@ TEST_BEGIN(TestExtractImage4Points)
 }
 TEST_END(TestExtractImage4Points)
 
+TEST_BEGIN(TestRemapWarp)
+{
+    Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg"));
+
+    // warpPerspective samples the same points as projectPoint + interpolateBL
+    Matd H(3, 3);
+    H(0, 0) = 0.9;  H(0, 1) = 0.1;   H(0, 2) = 12.0;
+    H(1, 0) = -0.05; H(1, 1) = 1.1;  H(1, 2) = -7.0;
+    H(2, 0) = 0.0002; H(2, 1) = 0.0003; H(2, 2) = 1.0;
+
+    Mat warped(im.w, im.h, im.c);
+    warpPerspective(im, warped, H);
+
+    bool same = true;
+    for (int y = 0; y != warped.h; ++y)
+        for (int x = 0; x != warped.w; ++x) {
+            Vector2F p = projectPoint(H, Vector2F(x, y));
+            bool inside = p.x() >= 0.0f && p.x() < im.w && p.y() >= 0.0f && p.y() < im.h;
+            for (int c = 0; c != im.c; ++c) {
+                float expected = inside ? interpolateBL(im, p.x(), p.y(), c) : 0.0f;
+                same = same && equivalent(warped.get(x, y, c), expected, 1e-5f);
+            }
+        }
+    TEST_ASSERT(same);
+
+    // a translation onto pixel centers is a shift, nearest and bilinear agree
+    Matd A(3, 2);
+    A(0, 0) = 1.0; A(0, 1) = 0.0; A(0, 2) = 5.5;
+    A(1, 0) = 0.0; A(1, 1) = 1.0; A(1, 2) = 3.5;
+
+    Mat nearest(im.w, im.h, im.c);
+    Mat bilinear(im.w, im.h, im.c);
+    warpAffine(im, nearest, A, NearestNeighbor);
+    warpAffine(im, bilinear, A, Bilinear);
+    TEST_ASSERT(sameMat(nearest, bilinear));
+    TEST_ASSERT(nearest.get(0, 0, 1) == im.get(5, 3, 1));
+    TEST_ASSERT(nearest.get(im.w - 6, im.h - 4, 2) == im.get(im.w - 1, im.h - 1, 2));
+    TEST_ASSERT(nearest.get(im.w - 5, im.h - 4, 2) == 0.0f);
+
+    // cylindrical maps are reused across frames
+    Mat mapx, mapy;
+    cylindricalMap(im.w, im.h, 300.0f, mapx, mapy);
+    Mat projected;
+    remap(im, projected, mapx, mapy, NearestNeighbor);
+    TEST_ASSERT(sameMat(projected, cylindricalProject(im, 300.0f)));
+    TEST_ASSERT(projected.get(im.w / 2, im.h / 2, 0) == im.get(im.w / 2, im.h / 2, 0));
+}
+TEST_END(TestRemapWarp)
+
 TEST_BEGIN(TestFilter) 
 {
     Mat im = loadImage(mergePaths(testRoot(), U"data/vision/Rainier1.png"), 3);
@@ -1377,6 +2785,122 @@ TEST_BEGIN(TestDrawHarris)
 }
 TEST_END(TestDrawHarris)
 
+TEST_BEGIN(TestFastCorners)
+{
+    // white square on black, corners at 16 and 47
+    Mat im(64, 64, 1);
+    for (int y = 16; y < 48; ++y)
+        for (int x = 16; x < 48; ++x)
+            im.set(x, y, 0, 1.0f);
+
+    std::array<Vector2F, 4> expected = { Vector2F(16, 16), Vector2F(47, 16), Vector2F(16, 47), Vector2F(47, 47) };
+
+    Descriptors d = fastCornerDetector(im, 0.1f, 3);
+    TEST_ASSERT(d.size() == expected.size());
+
+    for (Descriptor const& current : d) {
+        float best = std::numeric_limits<float>::max();
+        for (Vector2F const& corner : expected)
+            best = minimum(best, distance(current.p, corner));
+        TEST_ASSERT(best <= 2.0f);
+    }
+
+    // a right angle only darkens 11 pixels of the circle
+    TEST_ASSERT(fastCornerDetector(im, 0.1f, 3, 12).empty());
+
+    Mat rainier = loadImage(mergePaths(testRoot(), U"data/vision/Rainier1.png"), 3);
+    Descriptors d9 = fastCornerDetector(rainier, 0.1f, 3, 9);
+    Descriptors d12 = fastCornerDetector(rainier, 0.1f, 3, 12);
+    TEST_ASSERT(!d9.empty() && !d12.empty());
+    for (Descriptor const& current : d9)
+        TEST_ASSERT(current.p.x() >= 4 && current.p.y() >= 4 && current.p.x() < rainier.w - 4 && current.p.y() < rainier.h - 4);
+
+    // nms 0 keeps every candidate, nms 3 keeps the ones with no better candidate in the window
+    Mat gray = rgb2gray(rainier);
+    Descriptors all = fastCornerDetector(rainier, 0.1f, 0, 9);
+    std::vector<float> scores;
+    for (Descriptor const& current : all)
+        scores.push_back(harrisScore(gray, int(current.p.x()), int(current.p.y()), 3));
+
+    size_t kept = 0;
+    for (size_t i = 0; i != all.size(); ++i) {
+        bool local_max = true;
+        for (size_t j = 0; j != all.size() && local_max; ++j)
+            if (absolute(all[j].p.x() - all[i].p.x()) <= 3 && absolute(all[j].p.y() - all[i].p.y()) <= 3 && scores[j] > scores[i])
+                local_max = false;
+        if (local_max) {
+            TEST_ASSERT(kept < d9.size() && d9[kept].p == all[i].p);
+            kept++;
+        }
+    }
+    TEST_ASSERT(kept == d9.size());
+}
+TEST_END(TestFastCorners)
+
+TEST_BEGIN(TestPyramid)
+{
+    Mat im = loadImage(mergePaths(testRoot(), U"data/vision/dog.jpg"));
+
+    Pyramid pyramid;
+    pyramid.build(im, 4);
+    TEST_ASSERT(pyramid.levels() == 4);
+    TEST_ASSERT(sameMat(pyramid.level(0), im));
+    for (int i = 1; i != pyramid.levels(); ++i) {
+        TEST_ASSERT(pyramid.level(i).w == (pyramid.level(i - 1).w + 1) / 2);
+        TEST_ASSERT(pyramid.level(i).h == (pyramid.level(i - 1).h + 1) / 2);
+        TEST_ASSERT(pyramid.level(i).c == im.c);
+    }
+
+    // min size stops the pyramid early
+    Pyramid small;
+    small.build(im, 100, 16);
+    Mat const& top = small.level(small.levels() - 1);
+    TEST_ASSERT(top.w >= 16 && top.h >= 16);
+    TEST_ASSERT((top.w + 1) / 2 < 16 || (top.h + 1) / 2 < 16);
+
+    // laplacian collapses back to the base
+    pyramid.buildLaplacian();
+    Mat collapsed;
+    pyramid.collapse(collapsed);
+    TEST_ASSERT(sameMat(collapsed, im));
+
+    // writing the base in place and updating matches a full build
+    Mat shifted = im.clone();
+    for (int i = 0; i != shifted.size(); ++i)
+        shifted.data[i] = 1.0f - shifted.data[i];
+    Pyramid rebuilt;
+    rebuilt.build(shifted, 4);
+    float const* storage = pyramid.level(1).data;
+    memcpy(pyramid.level(0).data, shifted.data, sizeof(float) * size_t(shifted.size()));
+    pyramid.update();
+    TEST_ASSERT(pyramid.level(1).data == storage);
+    for (int i = 0; i != pyramid.levels(); ++i)
+        TEST_ASSERT(sameMat(pyramid.level(i), rebuilt.level(i)));
+
+    // the scratch buffer is sized once and reused for the smaller levels
+    Mat down, tmp;
+    pyramidDown(im, down, tmp);
+    float const* scratch = tmp.data;
+    pyramidDown(down, rebuilt.level(2), tmp);
+    pyramidUp(down, shifted, tmp, im.w, im.h);
+    TEST_ASSERT(tmp.data == scratch);
+
+    // constant images stay constant
+    Mat flat(37, 23, 1);
+    flat.fill(0, 0.5f);
+    Pyramid constant;
+    constant.build(flat, 3, 4);
+    constant.buildLaplacian();
+    for (int i = 0; i != constant.levels(); ++i) {
+        Mat expected(constant.level(i).w, constant.level(i).h, 1);
+        expected.fill(0, 0.5f);
+        TEST_ASSERT(sameMat(constant.level(i), expected));
+    }
+    Mat zero(flat.w, flat.h, 1);
+    TEST_ASSERT(sameMat(constant.laplacian(0), zero));
+}
+TEST_END(TestPyramid)
+
 TEST_BEGIN(TestDrawMatches) 
 {
     Mat a = loadImage(mergePaths(testRoot(), U"data/vision/Rainier1.png"), 3);
@@ -1458,6 +2982,81 @@ TEST_BEGIN(TestHomography)
         int inliers = modelInliers(H, matches, 2.0f);
         TEST_ASSERT(inliers == 4);
     }
+
+    // the value homography matches the mmult projection, single and batched
+    {
+        Matd H(3, 3);
+        H(0, 0) = 1.2;  H(0, 1) = -0.3;  H(0, 2) = 17.0;
+        H(1, 0) = 0.1;  H(1, 1) = 0.8;   H(1, 2) = -4.5;
+        H(2, 0) = 0.001; H(2, 1) = -0.002; H(2, 2) = 1.0;
+
+        std::vector<Vector2F> points;
+        for (int i = 0; i != 37; ++i)
+            points.push_back(Vector2F(float(i * 13 % 97) - 20.5f, float(i * 7 % 53) + 0.25f));
+
+        std::vector<Vector2F> projected(points.size());
+        projectPoints(Homography3x3(H), points.data(), projected.data(), int(points.size()));
+
+        for (size_t i = 0; i != points.size(); ++i) {
+            Matd p(1, 3);
+            p(0, 0) = points[i].x();
+            p(1, 0) = points[i].y();
+            p(2, 0) = 1.0;
+            Matd q = Matd::mmult(H, p);
+            Vector2F expected(float(q(0, 0) / q(2, 0)), float(q(1, 0) / q(2, 0)));
+
+            TEST_ASSERT(projectPoint(H, points[i]) == expected);
+            TEST_ASSERT(projected[i] == expected);
+        }
+    }
+
+    // the 4 point and the normalised DLT solvers recover a panorama sized homography
+    {
+        Homography3x3 H;
+        H(0, 0) = 0.95;  H(0, 1) = 0.07;   H(0, 2) = 1520.0;
+        H(1, 0) = -0.04; H(1, 1) = 1.02;   H(1, 2) = -35.0;
+        H(2, 0) = 2e-5;  H(2, 1) = -1e-5;  H(2, 2) = 1.0;
+
+        Matches matches;
+        for (int i = 0; i != 60; ++i) {
+            Match match;
+            match.p = Vector2F(float(i * 389 % 3001), float(i * i * 157 % 1201));
+            match.q = H.project(match.p);
+            matches.push_back(match);
+        }
+
+        Homography3x3 minimal;
+        TEST_ASSERT(computeHomography4(matches.data(), minimal));
+        Matd full = computeHomography(matches);
+        TEST_ASSERT(full.size() == 9);
+        const Homography3x3 dlt(full);
+
+        for (Match const& match : matches) {
+            TEST_ASSERT(distance(minimal.project(match.p), match.q) < 0.01f);
+            TEST_ASSERT(distance(dlt.project(match.p), match.q) < 0.01f);
+        }
+        TEST_ASSERT(modelInliers(full, matches, 0.5f) == int(matches.size()));
+
+        // three collinear points have no homography
+        matches[2].p = (matches[0].p + matches[1].p) * 0.5f;
+        TEST_ASSERT(!computeHomography4(matches.data(), minimal));
+        TEST_ASSERT(computeHomography(matches.data(), 4).size() == 0);
+
+        // p1, p2, p3 collinear, the square to quad map doesn't exist
+        const Vector2F p[4] = { Vector2F(0, 1), Vector2F(0, 0), Vector2F(1, 0), Vector2F(2, 0) };
+        const Vector2F q[4] = { Vector2F(10, 11), Vector2F(10, 10), Vector2F(11, 10), Vector2F(12, 13) };
+        for (int i = 0; i != 4; ++i) {
+            matches[i].p = p[i];
+            matches[i].q = q[i];
+        }
+        TEST_ASSERT(!computeHomography4(matches.data(), minimal));
+        TEST_ASSERT(computeHomography(matches.data(), 4).size() == 0);
+
+        // same points on the q side
+        for (int i = 0; i != 4; ++i)
+            std::swap(matches[i].p, matches[i].q);
+        TEST_ASSERT(!computeHomography4(matches.data(), minimal));
+    }
 }
 TEST_END(TestHomography)
 